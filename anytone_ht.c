@@ -290,14 +290,7 @@ typedef struct {
 
     // Bytes 0-3.
     uint8_t id[4];              // Up to 8 BCD digits
-#define GET_ID(x) (((x)[0] >> 4) * 10000000 +\
-                   ((x)[0] & 15) * 1000000 +\
-                   ((x)[1] >> 4) * 100000 +\
-                   ((x)[1] & 15) * 10000 +\
-                   ((x)[2] >> 4) * 1000 +\
-                   ((x)[2] & 15) * 100 +\
-                   ((x)[3] >> 4) * 10 +\
-                   ((x)[3] & 15))
+#define GET_ID(x) get_bcd(x)
     // Byte 4.
     uint8_t _unused4;           // 0
 
@@ -462,7 +455,7 @@ static int skip_region(unsigned addr, unsigned file_offset, uint8_t *mem, unsign
         if (index < NCHAN) {
             uint8_t *bitmap = &radio_mem[OFFSET_CHAN_MAP];
 
-            if ((bitmap[index / 8] >> (index & 7)) & 1) {
+            if (bitmap_test(bitmap, index)) {
                 // Channel is valid, don't skip.
                 return 0;
             }
@@ -481,7 +474,7 @@ static int skip_region(unsigned addr, unsigned file_offset, uint8_t *mem, unsign
         if (index < NCONTACTS) {
             uint8_t *cmap = GET_CONTACT_MAP();
 
-            if ((cmap[index / 8] >> (index & 7)) & 1) {
+            if (bitmap_test(cmap, index)) {
                 // Invalid contact: skip it, erase data.
                 if (mem) {
                     memset(mem, 0xff, nbytes);
@@ -500,7 +493,7 @@ static int skip_region(unsigned addr, unsigned file_offset, uint8_t *mem, unsign
         if (index < NZONES) {
             uint8_t *zmap = GET_ZONEMAP();
 
-            if ((zmap[index / 8] >> (index & 7)) & 1) {
+            if (bitmap_test(zmap, index)) {
                 // Zone is valid, don't skip.
                 return 0;
             }
@@ -519,7 +512,7 @@ static int skip_region(unsigned addr, unsigned file_offset, uint8_t *mem, unsign
         if (index < NSCANL) {
             uint8_t *slmap = GET_SCANL_MAP();
 
-            if ((slmap[index / 8] >> (index & 7)) & 1) {
+            if (bitmap_test(slmap, index)) {
                 // Scanlist is valid, don't skip.
                 return 0;
             }
@@ -534,17 +527,75 @@ static int skip_region(unsigned addr, unsigned file_offset, uint8_t *mem, unsign
     return 0;
 }
 
+//
+// Read bytes of the image at the given file offsets,
+// through the map of fragments.  Offsets are aligned to 64 bytes.
+//
+static void read_file_range(unsigned start, unsigned end)
+{
+    fragment_t *f;
+    unsigned file_offset = 0;
+
+    for (f=region_map; f->length && file_offset < end; f++) {
+        unsigned s = (start > file_offset) ? start : file_offset;
+        unsigned e = (end < file_offset + f->length) ? end : file_offset + f->length;
+
+        if (s < e)
+            serial_read_region(f->address + s - file_offset, &radio_mem[s], e - s);
+        file_offset += f->length;
+    }
+}
+
+//
+// Read the radio name and timestamp, radio ID, general settings
+// and the bitmaps of valid items, and check the cached image.
+//
+static int cache_valid()
+{
+    range_t tab[16];
+    fragment_t *f;
+    int ntab = 0, i;
+
+    // First radio ID identifies the cached image,
+    // name and timestamp are the probe block.
+    tab[ntab].start = OFFSET_RADIOID;
+    tab[ntab++].end = OFFSET_RADIOID + sizeof(radioid_t);
+    tab[ntab].start = 0;
+    tab[ntab++].end = 64;
+    tab[ntab].start = OFFSET_RADIOID;
+    tab[ntab++].end = OFFSET_RADIOID + 64;
+    tab[ntab].start = OFFSET_SETTINGS;
+    tab[ntab++].end = OFFSET_SETTINGS + 64;
+    tab[ntab].start = OFFSET_CONTACT_MAP;
+    tab[ntab++].end = OFFSET_CONTACT_MAP + ((NCONTACTS + 7) / 8 + 63) / 64 * 64;
+    for (f=region_map; f->length && ntab < 16; f++) {
+        if (f->offset != 0) {
+            tab[ntab].start = f->offset;
+            tab[ntab++].end = f->offset + f->length;
+        }
+    }
+    for (i=1; i<ntab; i++)
+        read_file_range(tab[i].start, tab[i].end);
+    return radio_cache_lookup(tab, ntab);
+}
+
 //
 // Read memory image from the device.
+// Skip the download when the cached image is still valid.
 //
 static void anytone_ht_download(radio_device_t *radio)
 {
     fragment_t *f;
 
+    if (cache_valid())
+        return;
+
     // Read bitmaps first.
+    // The upload needs them to skip unused items.
     for (f=region_map; f->length; f++) {
         if (f->offset != 0) {
             serial_read_region(f->address, &radio_mem[f->offset], f->length);
+            radio_mem_publish(f->offset, f->offset + f->length);
         }
     }
 
@@ -565,10 +616,15 @@ static void anytone_ht_download(radio_device_t *radio)
                 if (f->offset == 0)
                     serial_read_region(addr, &radio_mem[file_offset], n);
                 bytes_transferred += n;
+            } else {
+                // Erased, not read: upload it as a whole when it becomes valid.
+                radio_mem_unread(file_offset, n);
             }
             file_offset += n;
             addr += n;
             nbytes -= n;
+            radio_mem_ready(file_offset);
+            progress_update(file_offset, MEMSZ);
 
             if (bytes_transferred / (32*1024) != last_printed) {
                 fprintf(stderr, "#");
@@ -591,12 +647,26 @@ static contact_t *get_contact(int i)
 {
     uint8_t *cmap = GET_CONTACT_MAP();
 
-    if ((cmap[i / 8] >> (i & 7)) & 1)
+    if (bitmap_test(cmap, i))
         return 0;
 
     return GET_CONTACT(i);
 }
 
+//
+// Benchmark the link with reads of the largest region.
+//
+static void anytone_ht_linktest(radio_device_t *radio)
+{
+    fragment_t *f, *big = region_map;
+
+    for (f=region_map; f->length; f++) {
+        if (f->length > big->length)
+            big = f;
+    }
+    serial_linktest(big->address, big->length);
+}
+
 //
 // Write memory image to the device.
 //
@@ -614,13 +684,25 @@ static void anytone_ht_upload(radio_device_t *radio, int cont_flag)
         while (nbytes > 0) {
             unsigned n = (nbytes > 64) ? 64 : nbytes;
 
+            radio_mem_wait(file_offset + n);
             if (! skip_region(addr, file_offset, 0, 0)) {
-                serial_write_region(addr, &radio_mem[file_offset], n);
-                bytes_transferred += n;
+                // Write only the changed 16-byte packets.
+                range_t tab[4];
+                int ntab, i;
+
+                ntab = radio_dirty_ranges(file_offset, file_offset + n, 16, tab, 4);
+                for (i=0; i<ntab; i++) {
+                    unsigned len = tab[i].end - tab[i].start;
+
+                    serial_write_region(addr + tab[i].start - file_offset,
+                        &radio_mem[tab[i].start], len);
+                    bytes_transferred += len;
+                }
             }
             file_offset += n;
             addr += n;
             nbytes -= n;
+            progress_update(file_offset, MEMSZ);
 
             if (bytes_transferred / (32*1024) != last_printed) {
                 fprintf(stderr, "#");
@@ -700,58 +782,58 @@ static int anytone_ht_is_compatible(radio_device_t *radio)
     return 0;
 }
 
-static void print_id(FILE *out, int verbose)
+static void print_id(outbuf_t *out, int verbose)
 {
     radioid_t *ri = GET_RADIOID();
     unsigned id = GET_ID(ri->id);
 
     if (verbose)
-        fprintf(out, "\n# Unique DMR ID and name of this radio.");
-    fprintf(out, "\nID: %u\nName: ", id);
+        outbuf_printf(out, "\n# Unique DMR ID and name of this radio.");
+    outbuf_printf(out, "\nID: %u\nName: ", id);
     if (VALID_TEXT(ri->name)) {
-        print_ascii(out, ri->name, 16, 0);
+        outbuf_ascii(out, ri->name, 16, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
 }
 
-static void print_intro(FILE *out, int verbose)
+static void print_intro(outbuf_t *out, int verbose)
 {
     general_settings_t *gs = GET_SETTINGS();
 
     if (verbose)
-        fprintf(out, "\n# Text displayed when the radio powers up.\n");
-    fprintf(out, "Intro Line 1: ");
+        outbuf_printf(out, "\n# Text displayed when the radio powers up.\n");
+    outbuf_printf(out, "Intro Line 1: ");
     if (VALID_TEXT(gs->intro_line1)) {
-        print_ascii(out, gs->intro_line1, 14, 0);
+        outbuf_ascii(out, gs->intro_line1, 14, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\nIntro Line 2: ");
+    outbuf_printf(out, "\nIntro Line 2: ");
     if (VALID_TEXT(gs->intro_line2)) {
-        print_ascii(out, gs->intro_line2, 14, 0);
+        outbuf_ascii(out, gs->intro_line2, 14, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
 }
 
-static void print_working_mode(FILE *out, int verbose)
+static void print_working_mode(outbuf_t *out, int verbose)
 {
     general_settings_t *gs = GET_SETTINGS();
 
     if (verbose)
-        fprintf(out, "\n# Working Mode: Amateur or Professional\n");
-    fprintf(out, "Working Mode: ");
+        outbuf_printf(out, "\n# Working Mode: Amateur or Professional\n");
+    outbuf_printf(out, "Working Mode: ");
     if (gs->working_mode == WMODE_AMATEUR) {
-        fprintf(out, "Amateur");
+        outbuf_printf(out, "Amateur");
     } else if (gs->working_mode == WMODE_PRO) {
-            fprintf(out, "Professional");
+            outbuf_printf(out, "Professional");
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
 }
 
 //
@@ -770,7 +852,7 @@ static channel_t *get_channel(int i)
     channel_t *bank   = get_bank(i >> 7);
     uint8_t   *bitmap = &radio_mem[OFFSET_CHAN_MAP];
 
-    if ((bitmap[i / 8] >> (i & 7)) & 1)
+    if (bitmap_test(bitmap, i))
         return &bank[i % 128];
     else
         return 0;
@@ -783,11 +865,8 @@ static int have_channels(int mode)
 {
     int i;
 
-    for (i=0; i<NCHAN; i++) {
+    bitmap_foreach_set(i, &radio_mem[OFFSET_CHAN_MAP], NCHAN) {
         channel_t *ch = get_channel(i);
-
-        if (!ch)
-            continue;
         if (ch->channel_mode == mode)
             return 1;
 
@@ -807,35 +886,16 @@ static int have_channels(int mode)
 //
 static int have_contacts()
 {
-    uint8_t *cmap = GET_CONTACT_MAP();
-    int i;
-
-    for (i=0; i<(NCONTACTS+7)/8; i++) {
-        if (cmap[i] != 0xff)
-            return 1;
-    }
-    return 0;
+    // Bit is cleared for valid contacts.
+    return bitmap_next_clear(GET_CONTACT_MAP(), NCONTACTS, 0) >= 0;
 }
 
 //
 // Print frequency (BCD value).
 //
-static void print_rx_freq(FILE *out, unsigned data)
+static void print_rx_freq(outbuf_t *out, unsigned data)
 {
-    fprintf(out, "%d%d%d.%d%d%d", (data >> 4) & 15, data & 15,
-        (data >> 12) & 15, (data >> 8) & 15,
-        (data >> 20) & 15, (data >> 16) & 15);
-
-    if (((data >> 24) & 0xff) == 0) {
-        fputs("  ", out);
-    } else {
-        fprintf(out, "%d", (data >> 28) & 15);
-        if (((data >> 24) & 15) == 0) {
-            fputs(" ", out);
-        } else {
-            fprintf(out, "%d", (data >> 24) & 15);
-        }
-    }
+    outbuf_freq(out, __builtin_bswap32(data));
 }
 
 //
@@ -844,42 +904,33 @@ static void print_rx_freq(FILE *out, unsigned data)
 //
 static int bcd_to_hz(unsigned bcd)
 {
-    int a = (bcd >> 4)  & 15;
-    int b =  bcd        & 15;
-    int c = (bcd >> 12) & 15;
-    int d = (bcd >> 8)  & 15;
-    int e = (bcd >> 20) & 15;
-    int f = (bcd >> 16) & 15;
-    int g = (bcd >> 28) & 15;
-    int h = (bcd >> 24) & 15;
-
-    return (((((((a*10 + b) * 10 + c) * 10 + d) * 10 + e) * 10 + f) * 10 + g) * 10 + h) * 10;
+    return bcd_decode(__builtin_bswap32(bcd)) * 10;
 }
 
 //
 // Print the transmit offset or frequency.
 // TX value is a delta.
 //
-static void print_tx_offset(FILE *out, unsigned tx_offset_bcd, unsigned mode)
+static void print_tx_offset(outbuf_t *out, unsigned tx_offset_bcd, unsigned mode)
 {
     int offset;
 
     switch (mode) {
     default:
     case RM_SIMPLEX:            // TX frequency = RX frequency
-        fprintf(out, "+0       ");
+        outbuf_printf(out, "+0       ");
         break;
 
     case RM_TXPOS:              // Positive TX offset
         offset = bcd_to_hz(tx_offset_bcd);
-        fprintf(out, "+");
-        print_mhz(out, offset);
+        outbuf_printf(out, "+");
+        outbuf_mhz(out, offset);
         break;
 
     case RM_TXNEG:              // Negative TX offset
         offset = bcd_to_hz(tx_offset_bcd);
-        fprintf(out, "-");
-        print_mhz(out, offset);
+        outbuf_printf(out, "-");
+        outbuf_mhz(out, offset);
         break;
     }
 }
@@ -908,58 +959,55 @@ static int get_scanlist_index(radio_device_t *radio, channel_t *ch)
 //      TOT
 //      RX Only
 //
-static void print_chan_base(FILE *out, radio_device_t *radio, channel_t *ch, int cnum)
+static void print_chan_base(outbuf_t *out, radio_device_t *radio, channel_t *ch, int cnum)
 {
-    fprintf(out, "%5d   ", cnum);
-    print_ascii(out, ch->name, 16, 1);
-    fprintf(out, " ");
+    outbuf_printf(out, "%5d   ", cnum);
+    outbuf_ascii(out, ch->name, 16, 1);
+    outbuf_printf(out, " ");
     print_rx_freq(out, ch->rx_frequency);
-    fprintf(out, " ");
+    outbuf_printf(out, " ");
     print_tx_offset(out, ch->tx_offset, ch->repeater_mode);
 
-    fprintf(out, "%-5s ", POWER_NAME[ch->power]);
+    outbuf_printf(out, "%-5s ", POWER_NAME[ch->power]);
 
     int scanlist_index = get_scanlist_index(radio, ch);
     if (scanlist_index == 0xff)
-        fprintf(out, "-    ");
+        outbuf_printf(out, "-    ");
     else
-        fprintf(out, "%-4d ", scanlist_index + 1);
+        outbuf_printf(out, "%-4d ", scanlist_index + 1);
 
     // Transmit timeout timer on D868UV/D878UV/D878UV2 is configured globally,
     // not per channel. So we don't print it here.
-    fprintf(out, "-   ");
+    outbuf_printf(out, "-   ");
 
-    fprintf(out, "%c  ", "-+"[ch->rx_only]);
+    outbuf_printf(out, "%c  ", "-+"[ch->rx_only]);
 }
 
-static void print_digital_channels(FILE *out, radio_device_t *radio, int verbose)
+static void print_digital_channels(outbuf_t *out, radio_device_t *radio, int verbose)
 {
     int i;
 
     if (verbose) {
-        fprintf(out, "# Table of digital channels.\n");
-        fprintf(out, "# 1) Channel number: 1-%d\n", NCHAN);
-        fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-        fprintf(out, "# 3) Receive frequency in MHz\n");
-        fprintf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
-        fprintf(out, "# 5) Transmit power: High, Mid, Low, Turbo\n");
-        fprintf(out, "# 6) Scan list: - or index in Scanlist table\n");
-        fprintf(out, "# 7) Transmit timeout timer: (unused)\n");
-        fprintf(out, "# 8) Receive only: -, +\n");
-        fprintf(out, "# 9) Admit criteria: -, Free, Color, NColor\n");
-        fprintf(out, "# 10) Color code: 0, 1, 2, 3... 15\n");
-        fprintf(out, "# 11) Time slot: 1 or 2\n");
-        fprintf(out, "# 12) Receive group list: - or index in Grouplist table\n");
-        fprintf(out, "# 13) Contact for transmit: - or index in Contacts table\n");
-        fprintf(out, "#\n");
-    }
-    fprintf(out, "Digital Name             Receive   Transmit Power Scan TOT RO Admit  Color Slot RxGL TxContact");
-    fprintf(out, "\n");
-    for (i=0; i<NCHAN; i++) {
+        outbuf_printf(out, "# Table of digital channels.\n");
+        outbuf_printf(out, "# 1) Channel number: 1-%d\n", NCHAN);
+        outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+        outbuf_printf(out, "# 3) Receive frequency in MHz\n");
+        outbuf_printf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
+        outbuf_printf(out, "# 5) Transmit power: High, Mid, Low, Turbo\n");
+        outbuf_printf(out, "# 6) Scan list: - or index in Scanlist table\n");
+        outbuf_printf(out, "# 7) Transmit timeout timer: (unused)\n");
+        outbuf_printf(out, "# 8) Receive only: -, +\n");
+        outbuf_printf(out, "# 9) Admit criteria: -, Free, Color, NColor\n");
+        outbuf_printf(out, "# 10) Color code: 0, 1, 2, 3... 15\n");
+        outbuf_printf(out, "# 11) Time slot: 1 or 2\n");
+        outbuf_printf(out, "# 12) Receive group list: - or index in Grouplist table\n");
+        outbuf_printf(out, "# 13) Contact for transmit: - or index in Contacts table\n");
+        outbuf_printf(out, "#\n");
+    }
+    outbuf_printf(out, "Digital Name             Receive   Transmit Power Scan TOT RO Admit  Color Slot RxGL TxContact");
+    outbuf_printf(out, "\n");
+    bitmap_foreach_set(i, &radio_mem[OFFSET_CHAN_MAP], NCHAN) {
         channel_t *ch = get_channel(i);
-
-        if (!ch)
-            continue;
         if (ch->channel_mode != MODE_DIGITAL && ch->channel_mode != MODE_D_A) {
             // Select digital channels
             continue;
@@ -972,36 +1020,39 @@ static void print_digital_channels(FILE *out, radio_device_t *radio, int verbose
         //      Repeater Slot
         //      Group List
         //      Contact Name
-        fprintf(out, "%-6s ", DIGITAL_ADMIT_NAME[ch->tx_permit]);
-        fprintf(out, "%-5d %-3d  ", ch->color_code, 1 + ch->slot2);
+        outbuf_printf(out, "%-6s ", DIGITAL_ADMIT_NAME[ch->tx_permit]);
+        outbuf_printf(out, "%-5d %-3d  ", ch->color_code, 1 + ch->slot2);
 
         if (ch->group_list_index == 0xff)
-            fprintf(out, "-    ");
+            outbuf_printf(out, "-    ");
         else
-            fprintf(out, "%-4d ", ch->group_list_index + 1);
+            outbuf_printf(out, "%-4d ", ch->group_list_index + 1);
 
         if (ch->contact_index == 0xffff)
-            fprintf(out, "-");
+            outbuf_printf(out, "-");
         else
-            fprintf(out, "%-4d", ch->contact_index + 1);
+            outbuf_printf(out, "%-4d", ch->contact_index + 1);
 
         // Print contact name as a comment.
         if (ch->contact_index != 0xffff) {
-            contact_t *ct = get_contact(ch->contact_index);
+            contact_t *ct;
+
+            radio_mem_wait(OFFSET_CONTACTS + (ch->contact_index + 1) * 100);
+            ct = get_contact(ch->contact_index);
 
             if (ct) {
-                fprintf(out, " # ");
-                print_ascii(out, ct->name, 16, 0);
+                outbuf_printf(out, " # ");
+                outbuf_ascii(out, ct->name, 16, 0);
             }
         }
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
     }
 }
 
 //
 // Print CTSS tone.
 //
-static void print_ctcss(FILE *out, unsigned index, unsigned custom)
+static void print_ctcss(outbuf_t *out, unsigned index, unsigned custom)
 {
     int      dhz = (index < NCTCSS) ? CTCSS_TONES[index] : custom;
     unsigned a   = dhz / 1000;
@@ -1010,52 +1061,49 @@ static void print_ctcss(FILE *out, unsigned index, unsigned custom)
     unsigned d   = dhz % 10;
 
     if (a == 0)
-        fprintf(out, "%d%d.%d ", b, c, d);
+        outbuf_printf(out, "%d%d.%d ", b, c, d);
     else
-        fprintf(out, "%d%d%d.%d", a, b, c, d);
+        outbuf_printf(out, "%d%d%d.%d", a, b, c, d);
 }
 
 //
 // Print DCS tone.
 //
-static void print_dcs(FILE *out, unsigned dcs)
+static void print_dcs(outbuf_t *out, unsigned dcs)
 {
     unsigned i = (dcs >> 9) & 1;
     unsigned a = (dcs >> 6) & 7;
     unsigned b = (dcs >> 3) & 7;
     unsigned c = dcs & 7;
 
-    fprintf(out, "D%d%d%d%c", a, b, c, i ? 'I' : 'N');
+    outbuf_printf(out, "D%d%d%d%c", a, b, c, i ? 'I' : 'N');
 }
 
-static void print_analog_channels(FILE *out, radio_device_t *radio, int verbose)
+static void print_analog_channels(outbuf_t *out, radio_device_t *radio, int verbose)
 {
     int i;
 
     if (verbose) {
-        fprintf(out, "# Table of analog channels.\n");
-        fprintf(out, "# 1) Channel number: 1-%d\n", NCHAN);
-        fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-        fprintf(out, "# 3) Receive frequency in MHz\n");
-        fprintf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
-        fprintf(out, "# 5) Transmit power: High, Mid, Low, Turbo\n");
-        fprintf(out, "# 6) Scan list: - or index\n");
-        fprintf(out, "# 7) Transmit timeout timer: (unused)\n");
-        fprintf(out, "# 8) Receive only: -, +\n");
-        fprintf(out, "# 9) Admit criteria: -, Free, Tone\n");
-        fprintf(out, "# 10) Squelch level: Normal (unused)\n");
-        fprintf(out, "# 11) Guard tone for receive, or '-' to disable\n");
-        fprintf(out, "# 12) Guard tone for transmit, or '-' to disable\n");
-        fprintf(out, "# 13) Bandwidth in kHz: 12.5, 25\n");
-        fprintf(out, "#\n");
-    }
-    fprintf(out, "Analog  Name             Receive   Transmit Power Scan TOT RO Admit  Squelch RxTone TxTone Width");
-    fprintf(out, "\n");
-    for (i=0; i<NCHAN; i++) {
+        outbuf_printf(out, "# Table of analog channels.\n");
+        outbuf_printf(out, "# 1) Channel number: 1-%d\n", NCHAN);
+        outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+        outbuf_printf(out, "# 3) Receive frequency in MHz\n");
+        outbuf_printf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
+        outbuf_printf(out, "# 5) Transmit power: High, Mid, Low, Turbo\n");
+        outbuf_printf(out, "# 6) Scan list: - or index\n");
+        outbuf_printf(out, "# 7) Transmit timeout timer: (unused)\n");
+        outbuf_printf(out, "# 8) Receive only: -, +\n");
+        outbuf_printf(out, "# 9) Admit criteria: -, Free, Tone\n");
+        outbuf_printf(out, "# 10) Squelch level: Normal (unused)\n");
+        outbuf_printf(out, "# 11) Guard tone for receive, or '-' to disable\n");
+        outbuf_printf(out, "# 12) Guard tone for transmit, or '-' to disable\n");
+        outbuf_printf(out, "# 13) Bandwidth in kHz: 12.5, 25\n");
+        outbuf_printf(out, "#\n");
+    }
+    outbuf_printf(out, "Analog  Name             Receive   Transmit Power Scan TOT RO Admit  Squelch RxTone TxTone Width");
+    outbuf_printf(out, "\n");
+    bitmap_foreach_set(i, &radio_mem[OFFSET_CHAN_MAP], NCHAN) {
         channel_t *ch = get_channel(i);
-
-        if (!ch)
-            continue;
         if (ch->channel_mode != MODE_ANALOG && ch->channel_mode != MODE_A_D) {
             // Select analog channels
             continue;
@@ -1068,26 +1116,26 @@ static void print_analog_channels(FILE *out, radio_device_t *radio, int verbose)
         //      CTCSS/DCS Dec
         //      CTCSS/DCS Enc
         //      Bandwidth
-        fprintf(out, "%-6s ", ANALOG_ADMIT_NAME[ch->tx_permit]);
-        fprintf(out, "%-7s ", "Normal");
+        outbuf_printf(out, "%-6s ", ANALOG_ADMIT_NAME[ch->tx_permit]);
+        outbuf_printf(out, "%-7s ", "Normal");
 
         if (ch->rx_ctcss)
             print_ctcss(out, ch->ctcss_receive, ch->custom_ctcss);
         else if (ch->rx_dcs)
             print_dcs(out, ch->dcs_receive);
         else
-            fprintf(out, "-    ");
+            outbuf_printf(out, "-    ");
 
-        fprintf(out, "  ");
+        outbuf_printf(out, "  ");
         if (ch->tx_ctcss)
             print_ctcss(out, ch->ctcss_transmit, ch->custom_ctcss);
         else if (ch->tx_dcs)
             print_dcs(out, ch->dcs_transmit);
         else
-            fprintf(out, "-    ");
+            outbuf_printf(out, "-    ");
 
-        fprintf(out, "  %s", BANDWIDTH[ch->bandwidth]);
-        fprintf(out, "\n");
+        outbuf_printf(out, "  %s", BANDWIDTH[ch->bandwidth]);
+        outbuf_printf(out, "\n");
     }
 }
 
@@ -1096,14 +1144,7 @@ static void print_analog_channels(FILE *out, radio_device_t *radio, int verbose)
 //
 static int have_zones()
 {
-    uint8_t *zmap = GET_ZONEMAP();
-    int i;
-
-    for (i=0; i<(NZONES+7)/8; i++) {
-        if (zmap[i] != 0)
-            return 1;
-    }
-    return 0;
+    return bitmap_next_set(GET_ZONEMAP(), NZONES, 0) >= 0;
 }
 
 //
@@ -1111,14 +1152,7 @@ static int have_zones()
 //
 static int have_scanlists()
 {
-    uint8_t *slmap = GET_SCANL_MAP();
-    int i;
-
-    for (i=0; i<(NSCANL+7)/8; i++) {
-        if (slmap[i] != 0)
-            return 1;
-    }
-    return 0;
+    return bitmap_next_set(GET_SCANL_MAP(), NSCANL, 0) >= 0;
 }
 
 //
@@ -1130,7 +1164,7 @@ static int get_zone(int i, uint8_t **zname, uint16_t **zlist)
 {
     uint8_t *zmap = GET_ZONEMAP();
 
-    if ((zmap[i / 8] >> (i & 7)) & 1) {
+    if (bitmap_test(zmap, i)) {
         // Zone is valid.
         *zname = GET_ZONENAME(i);
         *zlist = GET_ZONELIST(i);
@@ -1147,13 +1181,13 @@ static scanlist_t *get_scanlist(int i)
 {
     uint8_t *slmap = GET_SCANL_MAP();
 
-    if ((slmap[i / 8] >> (i & 7)) & 1)
+    if (bitmap_test(slmap, i))
         return GET_SCANLIST(i);
 
     return 0;
 }
 
-static void print_chanlist16(FILE *out, uint16_t *unsorted, int nchan)
+static void print_chanlist16(outbuf_t *out, uint16_t *unsorted, int nchan)
 {
     int last  = -1;
     int range = 0;
@@ -1174,20 +1208,20 @@ static void print_chanlist16(FILE *out, uint16_t *unsorted, int nchan)
             range = 1;
         } else {
             if (range) {
-                fprintf(out, "-%d", last);
+                outbuf_printf(out, "-%d", last);
                 range = 0;
             }
             if (n > 0)
-                fprintf(out, ",");
-            fprintf(out, "%d", cnum);
+                outbuf_printf(out, ",");
+            outbuf_printf(out, "%d", cnum);
         }
         last = cnum;
     }
     if (range)
-        fprintf(out, "-%d", last);
+        outbuf_printf(out, "-%d", last);
 }
 
-static void print_chanlist32(FILE *out, uint32_t *unsorted, int nchan)
+static void print_chanlist32(outbuf_t *out, uint32_t *unsorted, int nchan)
 {
     int last  = -1;
     int range = 0;
@@ -1207,17 +1241,17 @@ static void print_chanlist32(FILE *out, uint32_t *unsorted, int nchan)
             range = 1;
         } else {
             if (range) {
-                fprintf(out, "-%d", last);
+                outbuf_printf(out, "-%d", last);
                 range = 0;
             }
             if (n > 0)
-                fprintf(out, ",");
-            fprintf(out, "%d", cnum);
+                outbuf_printf(out, ",");
+            outbuf_printf(out, "%d", cnum);
         }
         last = cnum;
     }
     if (range)
-        fprintf(out, "-%d", last);
+        outbuf_printf(out, "-%d", last);
 }
 
 static int have_grouplists()
@@ -1249,148 +1283,144 @@ static int have_messages()
 //
 // Print full information about the device configuration.
 //
-static void anytone_ht_print_config(radio_device_t *radio, FILE *out, int verbose)
+static void anytone_ht_print_config(radio_device_t *radio, FILE *file, int verbose)
 {
+    outbuf_t ob, *out = &ob;
     int i;
 
-    fprintf(out, "Radio: %s\n", radio->name);
+    // Print every table as soon as it is downloaded.
+    radio_mem_wait(OFFSET_BANK1 + NCHAN*64);
+
+    fprintf(file, "Radio: %s\n", radio->name);
     if (verbose)
-        anytone_ht_print_version(radio, out);
+        anytone_ht_print_version(radio, file);
+    outbuf_init(&ob, file);
 
     //
     // Channels.
     //
     if (have_channels(MODE_DIGITAL)) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         print_digital_channels(out, radio, verbose);
     }
     if (have_channels(MODE_ANALOG)) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         print_analog_channels(out, radio, verbose);
     }
 
     //
     // Zones.
     //
+    radio_mem_wait(OFFSET_ZONENAMES + NZONES*32);
     if (have_zones()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of channel zones.\n");
-            fprintf(out, "# 1) Zone number: 1-%d\n", NZONES);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) List of channels: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of channel zones.\n");
+            outbuf_printf(out, "# 1) Zone number: 1-%d\n", NZONES);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) List of channels: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Zone    Name             Channels\n");
-        for (i=0; i<NZONES; i++) {
+        outbuf_printf(out, "Zone    Name             Channels\n");
+        bitmap_foreach_set(i, GET_ZONEMAP(), NZONES) {
             uint8_t *zname;
             uint16_t *zlist;
 
-            if (!get_zone(i, &zname, &zlist)) {
-                // Zone is disabled.
+            if (!get_zone(i, &zname, &zlist))
                 continue;
-            }
 
-            fprintf(out, "%5d   ", i + 1);
-            print_ascii(out, zname, 16, 1);
-            fprintf(out, " ");
+            outbuf_printf(out, "%5d   ", i + 1);
+            outbuf_ascii(out, zname, 16, 1);
+            outbuf_printf(out, " ");
             if (*zlist != 0xffff) {
                 print_chanlist16(out, zlist, 250);
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
     //
     // Scan lists.
     //
+    radio_mem_wait(OFFSET_SCANLISTS + NSCANL*192);
     if (have_scanlists()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of scan lists.\n");
-            fprintf(out, "# 1) Scan list number: 1-%d\n", NSCANL);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) Priority channel 1: -, Curr or index\n");
-            fprintf(out, "# 4) Priority channel 2: -, Curr or index\n");
-            fprintf(out, "# 5) Designated transmit channel: Sel or Last\n");
-            fprintf(out, "# 6) List of channels: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of scan lists.\n");
+            outbuf_printf(out, "# 1) Scan list number: 1-%d\n", NSCANL);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) Priority channel 1: -, Curr or index\n");
+            outbuf_printf(out, "# 4) Priority channel 2: -, Curr or index\n");
+            outbuf_printf(out, "# 5) Designated transmit channel: Sel or Last\n");
+            outbuf_printf(out, "# 6) List of channels: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Scanlist Name            PCh1 PCh2 TxCh Channels\n");
-        for (i=0; i<NSCANL; i++) {
+        outbuf_printf(out, "Scanlist Name            PCh1 PCh2 TxCh Channels\n");
+        bitmap_foreach_set(i, GET_SCANL_MAP(), NSCANL) {
             scanlist_t *sl = get_scanlist(i);
 
-            if (!sl) {
-                // Scan list is disabled.
-                continue;
-            }
-
-            fprintf(out, "%5d   ", i + 1);
-            print_ascii(out, sl->name, 16, 1);
+            outbuf_printf(out, "%5d   ", i + 1);
+            outbuf_ascii(out, sl->name, 16, 1);
 
             if ((sl->prio_ch_select == PRIO_CHAN_SEL1 ||
                  sl->prio_ch_select == PRIO_CHAN_SEL12) &&
                 sl->priority_ch1 != 0xffff) {
                 if (sl->priority_ch1 == 0) {
-                    fprintf(out, " Curr ");
+                    outbuf_printf(out, " Curr ");
                 } else {
-                    fprintf(out, " %-4d ", sl->priority_ch1);
+                    outbuf_printf(out, " %-4d ", sl->priority_ch1);
                 }
             } else {
-                fprintf(out, " -    ");
+                outbuf_printf(out, " -    ");
             }
 
             if ((sl->prio_ch_select == PRIO_CHAN_SEL2 ||
                  sl->prio_ch_select == PRIO_CHAN_SEL12) &&
                 sl->priority_ch2 != 0xffff) {
                 if (sl->priority_ch2 == 0) {
-                    fprintf(out, "Curr ");
+                    outbuf_printf(out, "Curr ");
                 } else {
-                    fprintf(out, "%-4d ", sl->priority_ch2);
+                    outbuf_printf(out, "%-4d ", sl->priority_ch2);
                 }
             } else {
-                fprintf(out, "-    ");
+                outbuf_printf(out, "-    ");
             }
 
             if (sl->revert_channel == REVCH_LAST_CALLED) {
-                fprintf(out, "Last ");
+                outbuf_printf(out, "Last ");
             } else {
-                fprintf(out, "Sel  ");
+                outbuf_printf(out, "Sel  ");
             }
 
             if (sl->member[0] != 0xffff) {
                 print_chanlist16(out, sl->member, 50);
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
     //
     // Contacts.
     //
+    radio_mem_wait(OFFSET_CONTACTS + NCONTACTS*100);
     if (have_contacts()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of contacts.\n");
-            fprintf(out, "# 1) Contact number: 1-%d\n", NCONTACTS);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) Call type: Group, Private, All\n");
-            fprintf(out, "# 4) Call ID: 1...16777215\n");
-            fprintf(out, "# 5) Incoming call alert: -, +, Online\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of contacts.\n");
+            outbuf_printf(out, "# 1) Contact number: 1-%d\n", NCONTACTS);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) Call type: Group, Private, All\n");
+            outbuf_printf(out, "# 4) Call ID: 1...16777215\n");
+            outbuf_printf(out, "# 5) Incoming call alert: -, +, Online\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Contact Name             Type    ID       RxTone\n");
-        for (i=0; i<NCONTACTS; i++) {
+        outbuf_printf(out, "Contact Name             Type    ID       RxTone\n");
+        bitmap_foreach_clear(i, GET_CONTACT_MAP(), NCONTACTS) {
             contact_t *ct = get_contact(i);
-
-            if (!ct) {
-                // Contact is disabled
-                continue;
-            }
             if ((ct->type & 3) > CALL_ALL) {
                 // Contact type unknown
                 continue;
@@ -1400,26 +1430,33 @@ static void anytone_ht_print_config(radio_device_t *radio, FILE *out, int verbos
                 continue;
             }
 
-            fprintf(out, "%5d   ", i+1);
-            print_ascii(out, ct->name, 16, 1);
-            fprintf(out, " %-7s %-8d %s\n", CONTACT_TYPE[ct->type & 3],
-                CONTACT_ID(ct), ALERT_TYPE[ct->call_alert & 3]);
+            outbuf_uint(out, i+1, 5);
+            outbuf_puts(out, "   ");
+            outbuf_ascii(out, ct->name, 16, 1);
+            outbuf_putc(out, ' ');
+            outbuf_str(out, CONTACT_TYPE[ct->type & 3], -7);
+            outbuf_putc(out, ' ');
+            outbuf_uint(out, CONTACT_ID(ct), -8);
+            outbuf_putc(out, ' ');
+            outbuf_puts(out, ALERT_TYPE[ct->call_alert & 3]);
+            outbuf_putc(out, '\n');
         }
     }
 
     //
-    // Group lists.
+    // Group lists: the last region to download.
     //
+    radio_mem_wait(MEMSZ);
     if (have_grouplists()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of group lists.\n");
-            fprintf(out, "# 1) Group list number: 1-%d\n", NGLISTS);
-            fprintf(out, "# 2) Name: up to 35 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) List of contacts: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of group lists.\n");
+            outbuf_printf(out, "# 1) Group list number: 1-%d\n", NGLISTS);
+            outbuf_printf(out, "# 2) Name: up to 35 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) List of contacts: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Grouplist Name                              Contacts\n");
+        outbuf_printf(out, "Grouplist Name                              Contacts\n");
         for (i=0; i<NGLISTS; i++) {
             grouplist_t *gl = GET_GROUPLIST(i);
 
@@ -1428,11 +1465,11 @@ static void anytone_ht_print_config(radio_device_t *radio, FILE *out, int verbos
                 continue;
             }
 
-            fprintf(out, "%5d   ", i + 1);
-            print_ascii(out, gl->name, 35, 1);
-            fprintf(out, " ");
+            outbuf_printf(out, "%5d   ", i + 1);
+            outbuf_ascii(out, gl->name, 35, 1);
+            outbuf_printf(out, " ");
             print_chanlist32(out, gl->member, 64);
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
@@ -1440,14 +1477,14 @@ static void anytone_ht_print_config(radio_device_t *radio, FILE *out, int verbos
     // Text messages.
     //
     if (have_messages()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of text messages.\n");
-            fprintf(out, "# 1) Message number: 1-%d\n", NMESSAGES);
-            fprintf(out, "# 2) Text: up to 200 characters\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of text messages.\n");
+            outbuf_printf(out, "# 1) Message number: 1-%d\n", NMESSAGES);
+            outbuf_printf(out, "# 2) Text: up to 200 characters\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Message Text\n");
+        outbuf_printf(out, "Message Text\n");
         for (i=0; i<NMESSAGES; i++) {
             uint8_t *msg = GET_MESSAGE(i);
 
@@ -1456,9 +1493,9 @@ static void anytone_ht_print_config(radio_device_t *radio, FILE *out, int verbos
                 continue;
             }
 
-            fprintf(out, "%5d   ", i+1);
-            print_ascii(out, msg, 200, 0);
-            fprintf(out, "\n");
+            outbuf_printf(out, "%5d   ", i+1);
+            outbuf_ascii(out, msg, 200, 0);
+            outbuf_printf(out, "\n");
         }
     }
 
@@ -1466,6 +1503,8 @@ static void anytone_ht_print_config(radio_device_t *radio, FILE *out, int verbos
     print_id(out, verbose);
     print_intro(out, verbose);
     print_working_mode(out, verbose);
+
+    outbuf_flush(&ob);
 }
 
 //
@@ -1522,10 +1561,7 @@ static void anytone_ht_parse_parameter(radio_device_t *radio, char *param, char
     }
     if (strcasecmp ("ID", param) == 0) {
         uint32_t id = strtoul(value, 0, 0);
-        ri->id[0] = ((id / 10000000) << 4) | ((id / 1000000) % 10);
-        ri->id[1] = ((id / 100000 % 10) << 4) | ((id / 10000) % 10);
-        ri->id[2] = ((id / 1000 % 10) << 4) | ((id / 100) % 10);
-        ri->id[3] = ((id / 10 % 10) << 4) | (id % 10);
+        put_bcd(ri->id, id);
         return;
     }
 
@@ -1584,25 +1620,25 @@ static int ctcss_index(unsigned value)
 // Set the parameters for a given memory channel.
 //
 static void setup_channel(radio_device_t *radio, int i, int mode, char *name,
-    double rx_mhz, double tx_mhz, int power, int scanlist, int rxonly,
+    int rx_hz, int tx_hz, int power, int scanlist, int rxonly,
     int admit, int colorcode, int timeslot, int grouplist, int contact,
     int rxtone, int txtone, int width)
 {
     channel_t *ch     = get_bank(i >> 7) + (i % 128);
     uint8_t   *bitmap = &radio_mem[OFFSET_CHAN_MAP];
 
-    bitmap[i / 8] |= 1 << (i & 7);
+    bitmap_set(bitmap, i);
 
     memset(ch, 0, sizeof(channel_t));
     ascii_decode(ch->name, name, 16, 0);
 
-    ch->rx_frequency = mhz_to_ghefcdab(rx_mhz);
-    if (tx_mhz > rx_mhz) {
+    ch->rx_frequency = hz_to_ghefcdab(rx_hz);
+    if (tx_hz > rx_hz) {
         ch->repeater_mode   = RM_TXPOS;
-        ch->tx_offset       = mhz_to_ghefcdab(tx_mhz - rx_mhz);
-    } else if (tx_mhz < rx_mhz) {
+        ch->tx_offset       = hz_to_ghefcdab(tx_hz - rx_hz);
+    } else if (tx_hz < rx_hz) {
         ch->repeater_mode   = RM_TXNEG;
-        ch->tx_offset       = mhz_to_ghefcdab(rx_mhz - tx_mhz);
+        ch->tx_offset       = hz_to_ghefcdab(rx_hz - tx_hz);
     } else {
         ch->repeater_mode   = RM_SIMPLEX;
         ch->tx_offset       = 0x00000100;
@@ -1664,7 +1700,7 @@ static void setup_channel(radio_device_t *radio, int i, int mode, char *name,
 static void erase_channels()
 {
     memset(&radio_mem[OFFSET_BANK1], 0xff, NCHAN * 64);
-    memset(&radio_mem[OFFSET_CHAN_MAP], 0, (NCHAN + 7) / 8);
+    bitmap_clear_range(&radio_mem[OFFSET_CHAN_MAP], 0, NCHAN);
 }
 
 //
@@ -1678,7 +1714,7 @@ static void erase_zones()
         memset(GET_ZONENAME(i), 0xff, 16);
         memset(GET_ZONELIST(i), 0xff, 2*250);
     }
-    memset(GET_ZONEMAP(), 0, (NZONES + 7) / 8);
+    bitmap_clear_range(GET_ZONEMAP(), 0, (NZONES + 7) / 8 * 8);
 }
 
 //
@@ -1691,7 +1727,7 @@ static void erase_scanlists()
     for (i=0; i<NSCANL; i++) {
         memset(GET_SCANLIST(i), 0xff, 192);
     }
-    memset(GET_SCANL_MAP(), 0, (NSCANL + 7) / 8);
+    bitmap_clear_range(GET_SCANL_MAP(), 0, (NSCANL + 7) / 8 * 8);
 }
 
 //
@@ -1707,7 +1743,7 @@ static int parse_digital_channel(radio_device_t *radio, int first_row, char *lin
     char slot_str[256], grouplist_str[256], contact_str[256];
     int num, power, scanlist, rxonly, admit;
     int colorcode, timeslot, grouplist, contact;
-    double rx_mhz, tx_mhz;
+    int rx_hz, tx_hz;
 
     if (sscanf(line, "%s %s %s %s %s %s %s %s %s %s %s %s %s",
         num_str, name_str, rxfreq_str, offset_str,
@@ -1722,18 +1758,18 @@ static int parse_digital_channel(radio_device_t *radio, int first_row, char *lin
         return 0;
     }
 
-    if (sscanf(rxfreq_str, "%lf", &rx_mhz) != 1 ||
-        !is_valid_frequency(rx_mhz)) {
+    if (!parse_mhz(rxfreq_str, &rx_hz) ||
+        !is_valid_frequency(rx_hz / 1000000)) {
         fprintf(stderr, "Bad receive frequency.\n");
         return 0;
     }
-    if (sscanf(offset_str, "%lf", &tx_mhz) != 1) {
+    if (!parse_mhz(offset_str, &tx_hz)) {
 badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         return 0;
     }
     if (offset_str[0] == '-' || offset_str[0] == '+')
-        tx_mhz += rx_mhz;
-    if (! is_valid_frequency(tx_mhz))
+        tx_hz += rx_hz;
+    if (! is_valid_frequency(tx_hz / 1000000))
         goto badtx;
 
     if (strcasecmp("High", power_str) == 0) {
@@ -1822,7 +1858,7 @@ badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         erase_scanlists();
     }
 
-    setup_channel(radio, num-1, MODE_DIGITAL, name_str, rx_mhz, tx_mhz,
+    setup_channel(radio, num-1, MODE_DIGITAL, name_str, rx_hz, tx_hz,
         power, scanlist, rxonly, admit, colorcode, timeslot,
         grouplist, contact, 0, 0, BW_12_5_KHZ);
 
@@ -1895,7 +1931,7 @@ static int parse_analog_channel(radio_device_t *radio, int first_row, char *line
     char rxtone_str[256], txtone_str[256], width_str[256];
     int num, power, scanlist, rxonly, admit;
     int rxtone, txtone, width;
-    double rx_mhz, tx_mhz;
+    int rx_hz, tx_hz;
 
     if (sscanf(line, "%s %s %s %s %s %s %s %s %s %s %s %s %s",
         num_str, name_str, rxfreq_str, offset_str,
@@ -1910,18 +1946,18 @@ static int parse_analog_channel(radio_device_t *radio, int first_row, char *line
         return 0;
     }
 
-    if (sscanf(rxfreq_str, "%lf", &rx_mhz) != 1 ||
-        !is_valid_frequency(rx_mhz)) {
+    if (!parse_mhz(rxfreq_str, &rx_hz) ||
+        !is_valid_frequency(rx_hz / 1000000)) {
         fprintf(stderr, "Bad receive frequency.\n");
         return 0;
     }
-    if (sscanf(offset_str, "%lf", &tx_mhz) != 1) {
+    if (!parse_mhz(offset_str, &tx_hz)) {
 badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         return 0;
     }
     if (offset_str[0] == '-' || offset_str[0] == '+')
-        tx_mhz += rx_mhz;
-    if (! is_valid_frequency(tx_mhz))
+        tx_hz += rx_hz;
+    if (! is_valid_frequency(tx_hz / 1000000))
         goto badtx;
 
     if (strcasecmp("High", power_str) == 0) {
@@ -1996,7 +2032,7 @@ badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         erase_channels();
     }
 
-    setup_channel(radio, num-1, MODE_ANALOG, name_str, rx_mhz, tx_mhz,
+    setup_channel(radio, num-1, MODE_ANALOG, name_str, rx_hz, tx_hz,
         power, scanlist, rxonly, admit, 0, 1,
         0, 0, rxtone, txtone, width);
 
@@ -2011,7 +2047,7 @@ static void setup_zone(int index, const char *name)
 {
     uint8_t *zmap = GET_ZONEMAP();
 
-    zmap[index / 8] |= 1 << (index & 7);
+    bitmap_set(zmap, index);
     ascii_decode(GET_ZONENAME(index), name, 16, 0);
 }
 
@@ -2131,7 +2167,7 @@ static void setup_scanlist(int index, const char *name,
     scanlist_t *sl = GET_SCANLIST(index);
     uint8_t *slmap = GET_SCANL_MAP();
 
-    slmap[index / 8] |= 1 << (index & 7);
+    bitmap_set(slmap, index);
     memset(sl, 0, 192);
     memset(sl->member, 0xff, 100);
     ascii_decode(sl->name, name, 16, 0);
@@ -2298,7 +2334,7 @@ static void erase_contacts()
 {
     memset(&radio_mem[OFFSET_CONTACTS], 0xff, NCONTACTS*100);
     memset(GET_CONTACT_LIST(), 0xff, NCONTACTS*4);
-    memset(GET_CONTACT_MAP(), 0xff, (NCONTACTS + 7) / 8);
+    bitmap_set_range(GET_CONTACT_MAP(), 0, NCONTACTS);
 }
 
 static void setup_contact(int index, const char *name, int type, int id, int rxalert)
@@ -2308,17 +2344,14 @@ static void setup_contact(int index, const char *name, int type, int id, int rxa
     memset(ct, 0, 100);
     ascii_decode(ct->name, name, 16, 0);
 
-    ct->id[0] = ((id / 10000000) << 4) | ((id / 1000000) % 10);
-    ct->id[1] = ((id / 100000 % 10) << 4) | ((id / 10000) % 10);
-    ct->id[2] = ((id / 1000 % 10) << 4) | ((id / 100) % 10);
-    ct->id[3] = ((id / 10 % 10) << 4) | (id % 10);
+    put_bcd(ct->id, id);
 
     ct->type       = type;
     ct->call_alert = rxalert;
 
     // Update contact map.
     uint8_t *cmap = GET_CONTACT_MAP();
-    cmap[index / 8] &= ~(1 << (index & 7));
+    bitmap_clear(cmap, index);
 
     // Append to the contact list.
     uint32_t *clist = GET_CONTACT_LIST();
@@ -2600,12 +2633,9 @@ static int anytone_ht_verify_config(radio_device_t *radio)
     int ncontacts = 0, nerrors = 0;
 
     // Channels: check references to scanlists, contacts and grouplists.
-    for (i=0; i<NCHAN; i++) {
+    bitmap_foreach_set(i, &radio_mem[OFFSET_CHAN_MAP], NCHAN) {
         channel_t *ch = get_channel(i);
 
-        if (!ch)
-            continue;
-
         nchannels++;
         int scanlist_index = get_scanlist_index(radio, ch);
         if (scanlist_index != 0xff) {
@@ -2641,7 +2671,7 @@ static int anytone_ht_verify_config(radio_device_t *radio)
     }
 
     // Zones: check references to channels.
-    for (i=0; i<NZONES; i++) {
+    bitmap_foreach_set(i, GET_ZONEMAP(), NZONES) {
         uint8_t *zname;
         uint16_t *zlist;
 
@@ -2667,12 +2697,9 @@ static int anytone_ht_verify_config(radio_device_t *radio)
     }
 
     // Scanlists: check references to channels.
-    for (i=0; i<NSCANL; i++) {
+    bitmap_foreach_set(i, GET_SCANL_MAP(), NSCANL) {
         scanlist_t *sl = get_scanlist(i);
 
-        if (!sl)
-            continue;
-
         nscanlists++;
         for (k=0; k<50; k++) {
             int cindex = sl->member[k];
@@ -2714,22 +2741,15 @@ static int anytone_ht_verify_config(radio_device_t *radio)
         }
     }
 
-    // Count contacts.
-    for (i=0; i<NCONTACTS; i++) {
-        contact_t *ct = get_contact(i);
-
-        if (ct)
-            ncontacts++;
-    }
+    // Count contacts: bit is cleared for valid contacts.
+    ncontacts = NCONTACTS - bitmap_count(GET_CONTACT_MAP(), NCONTACTS);
 
     // Contacts have to be continuous for UV380.
-    for (i=0; i<ncontacts; i++) {
-        if (!get_contact(i)) {
-            fprintf(stderr, "Contact %d is missing.\n", i+1);
-            fprintf(stderr, "Contacts must be continuous for %s.\n", radio->name);
-            nerrors++;
-            break;
-        }
+    i = bitmap_next_set(GET_CONTACT_MAP(), NCONTACTS, 0);
+    if (i >= 0 && i < ncontacts) {
+        fprintf(stderr, "Contact %d is missing.\n", i+1);
+        fprintf(stderr, "Contacts must be continuous for %s.\n", radio->name);
+        nerrors++;
     }
 
     if (nerrors > 0) {
@@ -2742,58 +2762,116 @@ static int anytone_ht_verify_config(radio_device_t *radio)
 }
 
 //
-// Read and dump the callsign database.
+// Read the callsign database from the radio, and save it as CSV file.
+// For the layout of the database, see anytone_ht_write_csv().
 //
-static void dump_csv(radio_device_t *radio)
+static void anytone_ht_read_csv(radio_device_t *radio, FILE *csv)
 {
-    callsign_sizes_t sz = {0};
+    callsign_sizes_t sz;
+    callsign_map_t *map;
+    uint8_t buf[64], *data;
+    unsigned addr, index, nbytes, offset;
+    outbuf_t ob;
 
     //
-    // Dump sizes.
+    // Read sizes.
     //
-    serial_read_region(ADDR_CALLDB_SIZE, (uint8_t*) &sz, 16);
-    printf("Sizes:\n");
-    print_hex_addr_data(ADDR_CALLDB_SIZE, (uint8_t*)&sz, sizeof(sz));
-    printf("\n");
+    serial_read_bulk(ADDR_CALLDB_SIZE, buf, sizeof(sz));
+    memcpy(&sz, buf, sizeof(sz));
+    if (sz.count == 0 || sz.count > NCALLSIGNS || sz.last < ADDR_CALLDB_DATA) {
+        fprintf(stderr, "No callsign database on the radio.\n");
+        return;
+    }
+    offset = sz.last - ADDR_CALLDB_DATA;
+    nbytes = (offset / (256*1024)) * 100000 + offset % (256*1024);
+    if (nbytes > CALLSIGN_SIZE) {
+        fprintf(stderr, "Bad size of callsign database: %u bytes.\n", nbytes);
+        return;
+    }
+    fprintf(stderr, "Total %u contacts, %u bytes.\n", sz.count, nbytes);
+
+    map = malloc(sz.count * sizeof(*map));
+    data = malloc(nbytes + 64);
+    if (!map || !data) {
+        fprintf(stderr, "Out of memory!\n");
+        exit(-1);
+    }
+    memset(data, 0, nbytes + 64);
 
     //
-    // Dump callsign map.
+    // Read callsign map: 16000 records per chunk.
     //
-    unsigned addr = ADDR_CALLDB_LIST;
-    unsigned index;
-
-    printf("Map:\n");
+    addr = ADDR_CALLDB_LIST;
     for (index = 0; index < sz.count; index += 16000) {
-        unsigned n = (sz.count - index) * 8;
-        if (n > 128000)
-            n = 128000;
+        unsigned n = sz.count - index;
+        if (n > 16000)
+            n = 16000;
 
-        uint8_t map[128000];
-        serial_read_region(addr, map, n);
-        print_hex_addr_data(addr, map, n);
+        serial_read_bulk(addr, (uint8_t*) &map[index], n * sizeof(*map));
+        progress_update((index + n) * sizeof(*map), sz.count * sizeof(*map) + nbytes);
         addr += 256*1024;
+        fprintf(stderr, "#");
+        fflush(stderr);
     }
-    printf("\n");
 
     //
-    // Dump data.
+    // Read data: 100000 bytes per chunk.
     //
-    printf("Data:\n");
     addr = ADDR_CALLDB_DATA;
-    for (index = 0; index < 10000000; index += 100000) {
-        int n = sz.last - addr;
-        if (n < 0)
-            break;
-        else if (n > 100000)
+    for (offset = 0; offset < nbytes; offset += 100000) {
+        unsigned n = nbytes - offset;
+        if (n > 100000)
             n = 100000;
-        else
-            n = (n + 15) & ~15; // align
 
-        uint8_t data[100000];
-        serial_read_region(addr, data, n);
-        print_hex_addr_data(addr, data, n);
+        serial_read_bulk(addr, data + offset, n);
+        progress_update(sz.count * sizeof(*map) + offset + n, sz.count * sizeof(*map) + nbytes);
         addr += 256*1024;
+        fprintf(stderr, "#");
+        fflush(stderr);
     }
+    fprintf(stderr, " done.\n");
+
+    //
+    // Decode records in order of the map.
+    // Record: 00, radio id (BCD), 00, then name, city, callsign,
+    // state, country and remarks as null-terminated strings.
+    //
+    outbuf_init(&ob, csv);
+    outbuf_puts(&ob, "Radio ID,Callsign,Name,City,State,Country,Remarks\n");
+    for (index = 0; index < sz.count; index++) {
+        const char *field[6], *p, *end;
+        int k;
+
+        offset = map[index].offset;
+        if (offset + 6 >= nbytes) {
+            fprintf(stderr, "Bad offset %#x of record %u.\n", offset, index);
+            continue;
+        }
+        p = (char*) &data[offset + 6];
+        end = (char*) &data[nbytes];
+        for (k = 0; k < 6; k++) {
+            field[k] = p;
+            p += strnlen(p, end - p) + 1;
+            if (p > end)
+                p = end;
+        }
+
+        outbuf_uint(&ob, get_bcd(&data[offset + 1]), 0);
+        outbuf_putc(&ob, ',');
+        outbuf_puts(&ob, field[2]);     // Callsign
+        outbuf_putc(&ob, ',');
+        outbuf_puts(&ob, field[0]);     // Name
+        outbuf_putc(&ob, ',');
+        outbuf_puts(&ob, field[1]);     // City
+        for (k = 3; k < 6; k++) {
+            outbuf_putc(&ob, ',');
+            outbuf_puts(&ob, field[k]); // State, country, remarks
+        }
+        outbuf_putc(&ob, '\n');
+    }
+    outbuf_flush(&ob);
+    free(map);
+    free(data);
 }
 
 //
@@ -2811,8 +2889,192 @@ static int compare_callsign_map(const void *ap, const void *bp)
     return 0;
 }
 
+//
+// Parallel encoding of callsign records.
+// Every chunk of records is encoded into a separate buffer,
+// with offsets relative to the buffer. Then buffers are placed
+// into the data blob, and offsets and IDs are fixed up.
+//
+typedef struct {
+    csv_record_t   *rec;
+    callsign_map_t *map;
+    unsigned       *ids;
+    char           *data;
+    int             count;
+    int             nchunks;
+    char           *buf[PARALLEL_MAXTHREADS];
+    unsigned        nbytes[PARALLEL_MAXTHREADS];
+    unsigned        base[PARALLEL_MAXTHREADS];
+} callsign_job_t;
+
+static void encode_callsign_chunk(void *arg, int chunk)
+{
+    callsign_job_t *job = arg;
+    int first = (int64_t)job->count * chunk / job->nchunks;
+    int last  = (int64_t)job->count * (chunk + 1) / job->nchunks;
+    int i;
+
+    // Radio ID takes 6 bytes, and every string up to 17 bytes.
+    char *p = malloc((last - first) * (6 + 6*17) + 1);
+    job->buf[chunk] = p;
+    job->nbytes[chunk] = 0;
+    if (!p) {
+        fprintf(stderr, "Out of memory!\n");
+        exit(-1);
+    }
+
+    for (i = first; i < last; i++) {
+        csv_record_t *r = &job->rec[i];
+
+        job->map[i].offset = p - job->buf[chunk];
+
+        // Radio ID.
+        *p++ = 0;
+        p += 4;
+        *p++ = 0;
+
+        // Name, city, callsign, state, country, remarks.
+        strcpy(p, trim_spaces(r->name,     16)); p += strlen(p) + 1;
+        strcpy(p, trim_spaces(r->city,     15)); p += strlen(p) + 1;
+        strcpy(p, trim_spaces(r->callsign, 16)); p += strlen(p) + 1;
+        strcpy(p, trim_spaces(r->state,    16)); p += strlen(p) + 1;
+        strcpy(p, trim_spaces(r->country,  16)); p += strlen(p) + 1;
+        strcpy(p, trim_spaces(r->remarks,  16)); p += strlen(p) + 1;
+    }
+    job->nbytes[chunk] = p - job->buf[chunk];
+}
+
+static void place_callsign_chunk(void *arg, int chunk)
+{
+    callsign_job_t *job = arg;
+    int first = (int64_t)job->count * chunk / job->nchunks;
+    int last  = (int64_t)job->count * (chunk + 1) / job->nchunks;
+    unsigned base = job->base[chunk];
+    int i;
+
+    memcpy(&job->data[base], job->buf[chunk], job->nbytes[chunk]);
+    free(job->buf[chunk]);
+
+    // Convert radio IDs to BCD.
+    // In the map, the ID is shifted left by one bit.
+    bcd_encode_array(&job->ids[first], &job->ids[first], last - first);
+    for (i = first; i < last; i++) {
+        callsign_map_t *m = &job->map[i];
+        uint8_t *p = (uint8_t*) &job->data[m->offset + base + 1];
+        unsigned bcd = job->ids[i];
+
+        m->id = bcd << 1;
+        m->offset += base;
+        p[0] = bcd >> 24;
+        p[1] = bcd >> 16;
+        p[2] = bcd >> 8;
+        p[3] = bcd;
+    }
+}
+
+//
+// Digest of the callsign database, as stored in the radio:
+// the map, the count and last address, and the data.
+//
+static unsigned long long callsign_digest(const callsign_map_t *map, unsigned count,
+    const callsign_sizes_t *sz, const void *data, unsigned nbytes)
+{
+    unsigned long long digest = CSV_DIGEST_INIT;
+
+    digest = csv_digest(digest, map, count * sizeof(callsign_map_t));
+    digest = csv_digest(digest, &sz->count, sizeof(sz->count));
+    digest = csv_digest(digest, &sz->last, sizeof(sz->last));
+    return csv_digest(digest, data, nbytes);
+}
+
+//
+// Read the callsign database back from the radio,
+// and check that it is the same as written last time.
+//
+static int callsign_intact(unsigned count, const csv_region_t *region)
+{
+    callsign_sizes_t sz;
+    callsign_map_t *map;
+    uint8_t buf[64], *data;
+    unsigned index, addr;
+    int ok;
+
+    if (region->nbytes == 0 || region->nbytes > CALLSIGN_SIZE)
+        return 0;
+
+    // Reads are done in units of 64 bytes.
+    serial_read_region(ADDR_CALLDB_SIZE, buf, sizeof(sz));
+    memcpy(&sz, buf, sizeof(sz));
+    if (sz.count != count)
+        return 0;
+
+    map = malloc(count * sizeof(callsign_map_t) + 64);
+    data = malloc(region->nbytes + 64);
+    if (!map || !data) {
+        free(map);
+        free(data);
+        return 0;
+    }
+    addr = ADDR_CALLDB_LIST;
+    for (index = 0; index < count; index += 16000) {
+        unsigned n = (count - index) * 8;
+        if (n > 128000)
+            n = 128000;
+        serial_read_region(addr, (uint8_t*) &map[index], n);
+        addr += 256*1024;
+    }
+    addr = ADDR_CALLDB_DATA;
+    for (index = 0; index < region->nbytes; index += 100000) {
+        unsigned n = region->nbytes - index;
+        if (n > 100000)
+            n = 100000;
+        serial_read_region(addr, &data[index], n);
+        addr += 256*1024;
+    }
+    ok = callsign_digest(map, count, &sz, data, region->nbytes) == region->digest;
+    free(map);
+    free(data);
+    return ok;
+}
+
+//
+// Compare the database with the snapshot, which was written
+// to this radio last time.  The database in the radio
+// must be intact.  Return 1 when nothing is changed.
+//
+static int callsign_unchanged(char *path, int size, const csv_key_t *keys, int nkeys)
+{
+    csv_key_t *prev;
+    csv_delta_t delta;
+    csv_region_t region;
+    int nprev;
+
+    if (! radio_csv_snapshot(path, size)) {
+        path[0] = 0;
+        return 0;
+    }
+    nprev = csv_keys_load(path, &prev, &region);
+    if (nprev < 0)
+        return 0;
+    csv_delta(prev, nprev, keys, nkeys, &delta, 0, 0);
+    free(prev);
+    fprintf(stderr, "Since last write: %d added, %d removed, %d modified, %d moved.\n",
+        delta.added, delta.removed, delta.modified, delta.moved);
+    if (delta.added + delta.removed + delta.modified + delta.moved != 0)
+        return 0;
+
+    if (! callsign_intact(nprev, &region)) {
+        fprintf(stderr, "Contacts database was changed by other means.\n");
+        return 0;
+    }
+    return 1;
+}
+
 //
 // Write CSV file to the callsign database.
+// Records are packed one after another, so any change
+// shifts the data: the database is either skipped, when it is
+// the same as written last time, or rewritten as a whole.
 //
 // The callsign database consists of three parts:
 // (1) Map of DMR IDs to data offsets: 8 bytes per record.
@@ -2844,8 +3106,13 @@ static int compare_callsign_map(const void *ap, const void *bp)
 //
 static void anytone_ht_write_csv(radio_device_t *radio, FILE *csv)
 {
+    static unsigned ids[NCALLSIGNS];
     callsign_map_t map[NCALLSIGNS];
     callsign_sizes_t sz = {0};
+    unsigned addr, index;
+    csv_key_t *keys;
+    char path[1024];
+    int nkeys;
 
     // Allocate data.
     char *data = malloc(CALLSIGN_SIZE);
@@ -2866,84 +3133,110 @@ static void anytone_ht_write_csv(radio_device_t *radio, FILE *csv)
     // Need to rearrange the fields like:
     // Radio ID, Name, City, Callsign, State, Country, Remarks
     //
-    unsigned nbytes = 0;
-    char *radioid, *callsign, *name, *city, *state, *country, *remarks;
+    csv_record_t *rec;
+    unsigned nbytes;
+    int nrec;
 
     if (csv_init(csv) < 0) {
         free(data);
         return;
     }
-    while (csv_read(csv, &radioid, &callsign, &name, &city, &state, &country, &remarks)) {
-        radioid  = trim_spaces(radioid,  16);
-        callsign = trim_spaces(callsign, 16);
-        name     = trim_spaces(name,     16);
-        city     = trim_spaces(city,     15);
-        state    = trim_spaces(state,    16);
-        country  = trim_spaces(country,  16);
-        remarks  = trim_spaces(remarks,  16);
-        //printf("%s,%s,%s,%s,%s,%s,%s\n", radioid, callsign, name, city, state, country, remarks);
-
-        unsigned id = strtoul(radioid, 0, 10);
+    nrec = csv_load(csv, &rec);
+    if (nrec < 0) {
+        free(data);
+        return;
+    }
+
+    // Check IDs, in order of the file.
+    for (index = 0; index < nrec; index++) {
+        csv_record_t *r = &rec[index];
+
+        r->radioid = trim_spaces(r->radioid, 16);
+        unsigned id = strtoul(r->radioid, 0, 10);
         if (id < 1 || id > 0xffffff) {
             fprintf(stderr, "Bad id: %d\n", id);
-            fprintf(stderr, "Line: '%s,%s,%s,%s,%s,%s,%s'\n",
-                radioid, callsign, name, city, state, country, remarks);
+            fprintf(stderr, "Line: '%s,%s,%s,%s,%s,%s,%s'\n", r->radioid,
+                trim_spaces(r->callsign, 16), trim_spaces(r->name, 16),
+                trim_spaces(r->city, 15), trim_spaces(r->state, 16),
+                trim_spaces(r->country, 16), trim_spaces(r->remarks, 16));
+            csv_free(rec);
+            free(data);
             return;
         }
 
         // Eastern egg: when file contains id 1 with callsign 'dump',
         // read the callsign database from the radio
-        // and save to a file.
-        if (id == 1 && strcmp(callsign, "dump") == 0) {
+        // and print it as CSV.
+        if (id == 1 && strcmp(trim_spaces(r->callsign, 16), "dump") == 0) {
+            csv_free(rec);
             free(data);
-            dump_csv(radio);
+            anytone_ht_read_csv(radio, stdout);
             return;
         }
 
-        // Add map record.
-        if (sz.count >= NCALLSIGNS) {
+        if (index >= NCALLSIGNS) {
             fprintf(stderr, "WARNING: Too many callsigns!\n");
             fprintf(stderr, "Skipping the rest.\n");
             break;
         }
-        callsign_map_t *m = &map[sz.count];
-        sz.count++;
-        m->id = ((id / 10     % 10) << 5)  |  (id            % 10) << 1 |
-                ((id / 1000   % 10) << 13) | ((id / 100)     % 10) << 9 |
-                ((id / 100000 % 10) << 21) | ((id / 10000)   % 10) << 17 |
-                ((id / 10000000)    << 29) | ((id / 1000000) % 10) << 25;
-        m->offset = nbytes;
-
-        // Fill data.
-        char *p = &data[nbytes];
-
-        // Radio ID.
-        *p++ = 0;
-        *p++ = ((id / 10000000) << 4) | ((id / 1000000) % 10);
-        *p++ = ((id / 100000 % 10) << 4) | ((id / 10000) % 10);
-        *p++ = ((id / 1000 % 10) << 4) | ((id / 100) % 10);
-        *p++ = ((id / 10 % 10) << 4) | (id % 10);
-        *p++ = 0;
-
-        // Name, city, callsign, state, country, remarks.
-        strcpy(p, name);     p += strlen(p) + 1;
-        strcpy(p, city);     p += strlen(p) + 1;
-        strcpy(p, callsign); p += strlen(p) + 1;
-        strcpy(p, state);    p += strlen(p) + 1;
-        strcpy(p, country);  p += strlen(p) + 1;
-        strcpy(p, remarks);  p += strlen(p) + 1;
+        ids[index] = id;
+    }
+    sz.count = index;
+
+    // Encode records in parallel, and place them in order.
+    callsign_job_t job;
+    job.rec = rec;
+    job.map = map;
+    job.ids = ids;
+    job.data = data;
+    job.count = sz.count;
+    job.nchunks = parallel_nchunks(sz.count, 1000);
+
+    parallel_for(job.nchunks, encode_callsign_chunk, &job);
+
+    // Exclusive prefix sum of chunk sizes gives the chunk offsets.
+    nbytes = 0;
+    for (index = 0; index < job.nchunks; index++) {
+        job.base[index] = nbytes;
+        nbytes += job.nbytes[index];
+    }
+    if (nbytes + 64 > CALLSIGN_SIZE) {
+        fprintf(stderr, "Too much callsign data: %d bytes!\n", nbytes);
+        for (index = 0; index < job.nchunks; index++)
+            free(job.buf[index]);
+        csv_free(rec);
+        free(data);
+        return;
+    }
+    parallel_for(job.nchunks, place_callsign_chunk, &job);
 
-        nbytes = p - data;
+    // Snapshot of the encoded records, with the fields cut to size.
+    nkeys = csv_keys(rec, sz.count, &keys);
+    csv_free(rec);
+    if (nkeys < 0) {
+        free(data);
+        return;
     }
     fprintf(stderr, "Total %d contacts, %d bytes.\n", sz.count, nbytes);
 
+    if (callsign_unchanged(path, sizeof(path), keys, nkeys)) {
+        fprintf(stderr, "Contacts database is up to date.\n");
+        free(keys);
+        free(data);
+        return;
+    }
+
+    // Forget the snapshot until the write is complete.
+    if (path[0])
+        unlink(path);
+
     sz.last = ADDR_CALLDB_DATA + (nbytes / 100000) * 256*1024 + (nbytes % 100000);
 
     // Append extra zeroes and align.
     nbytes = (nbytes + 63) & ~15;
 
     // Sort the map by DMR ID.
-    qsort(map, sz.count, sizeof(map[0]), compare_callsign_map);
+    parallel_sort(map, sz.count, sizeof(map[0]), compare_callsign_map);
 
     if (! trace_flag) {
         fprintf(stderr, "Write: ");
@@ -2953,8 +3246,7 @@ static void anytone_ht_write_csv(radio_device_t *radio, FILE *csv)
     //
     // Write callsign map.
     //
-    unsigned addr = ADDR_CALLDB_LIST;
-    unsigned index;
+    addr = ADDR_CALLDB_LIST;
 
 //#define DUMP_NO_WRITE
 #ifdef DUMP_NO_WRITE
@@ -2971,6 +3263,7 @@ static void anytone_ht_write_csv(radio_device_t *radio, FILE *csv)
 #else
         serial_write_region(addr, (uint8_t*) &map[index], n);
 #endif
+        progress_update(index * 8 + n, sz.count * 8 + nbytes);
         addr += 256*1024;
 
         fprintf(stderr, "#");
@@ -3004,6 +3297,7 @@ static void anytone_ht_write_csv(radio_device_t *radio, FILE *csv)
 #else
         serial_write_region(addr, (uint8_t*) &data[index], n);
 #endif
+        progress_update(sz.count * 8 + index + n, sz.count * 8 + nbytes);
         addr += 256*1024;
 
         fprintf(stderr, "#");
@@ -3012,6 +3306,16 @@ static void anytone_ht_write_csv(radio_device_t *radio, FILE *csv)
 
     if (! trace_flag)
         fprintf(stderr, "# done.\n");
+
+    // Remember what is written.
+    if (path[0]) {
+        csv_region_t region;
+
+        region.nbytes = nbytes;
+        region.digest = callsign_digest(map, sz.count, &sz, data, nbytes);
+        csv_keys_save(path, keys, nkeys, &region);
+    }
+    free(keys);
     free(data);
 }
 
@@ -3033,6 +3337,9 @@ radio_device_t radio_d868uv = {
     anytone_ht_parse_row,
     anytone_ht_update_timestamp,
     anytone_ht_write_csv,
+    .read_csv = anytone_ht_read_csv,
+    .stream_decode = 1,
+    .linktest = anytone_ht_linktest,
 };
 
 //
@@ -3053,6 +3360,9 @@ radio_device_t radio_d878uv = {
     anytone_ht_parse_row,
     anytone_ht_update_timestamp,
     anytone_ht_write_csv,
+    .read_csv = anytone_ht_read_csv,
+    .stream_decode = 1,
+    .linktest = anytone_ht_linktest,
 };
 
 //
@@ -3073,6 +3383,9 @@ radio_device_t radio_d878uv2 = {
     anytone_ht_parse_row,
     anytone_ht_update_timestamp,
     anytone_ht_write_csv,
+    .read_csv = anytone_ht_read_csv,
+    .stream_decode = 1,
+    .linktest = anytone_ht_linktest,
 };
 
 //
@@ -3093,4 +3406,7 @@ radio_device_t radio_dmr6x2 = {
     anytone_ht_parse_row,
     anytone_ht_update_timestamp,
     anytone_ht_write_csv,
+    .read_csv = anytone_ht_read_csv,
+    .stream_decode = 1,
+    .linktest = anytone_ht_linktest,
 };
@@ -0,0 +1,290 @@
+/*
+ * Binary coded decimal conversion, one value or array at a time.
+ *
+ * Copyright (C) 2018 Serge Vakulenko, KK6ABQ
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. The name of the author may not be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include "util.h"
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <immintrin.h>
+#   define HAVE_AVX2_KERNEL 1
+#endif
+
+//
+// Convert binary value 0...99999999 to 8-digit BCD.
+// All four-digit, two-digit and one-digit groups are processed
+// in parallel, as lanes of a 64-bit word.
+//
+unsigned bcd_encode(unsigned bin)
+{
+    uint64_t v, q, t;
+
+    // Split into two 4-digit halves: lanes of 32 bits.
+    v = (uint64_t)(bin / 10000 % 10000) << 32 | (bin % 10000);
+
+    // Divide each lane by 100: lanes of 16 bits.
+    q = ((v * 5243) >> 19) & 0x0000007f0000007fULL;
+    v = (q << 16) | (v - q*100);
+
+    // Divide each lane by 10: tens in high nibble, units in low nibble.
+    t = ((v * 103) >> 10) & 0x000f000f000f000fULL;
+    v = (t << 4) | (v - t*10);
+
+    // Pack bytes together.
+    v = (v | (v >> 8)) & 0x0000ffff0000ffffULL;
+    return (unsigned)(v | (v >> 16));
+}
+
+//
+// Convert 8-digit BCD to binary value.
+//
+unsigned bcd_decode(unsigned bcd)
+{
+    uint32_t v = bcd;
+
+    v = (v & 0x0f0f0f0f) + ((v >> 4) & 0x0f0f0f0f) * 10;
+    v = (v & 0x00ff00ff) + ((v >> 8) & 0x00ff00ff) * 100;
+    return (v & 0xffff) + (v >> 16) * 10000;
+}
+
+//
+// Check that all digits of BCD value are in range 0...9.
+//
+int bcd_valid(unsigned bcd)
+{
+    // Digit is invalid when bit 3 is set together with bit 2 or bit 1.
+    return ((bcd >> 3) & ((bcd >> 2) | (bcd >> 1)) & 0x11111111) == 0;
+}
+
+#if defined(__SSE2__)
+//
+// SSE2 kernels: four values at a time.
+//
+static __m128i encode_sse2(__m128i x)
+{
+    const __m128i magic = _mm_set1_epi32(0xd1b71759);
+    __m128i even, odd, hi, v, q, t;
+
+    // hi = x / 10000, via 64-bit multiply of even and odd lanes.
+    even = _mm_srli_epi64(_mm_mul_epu32(x, magic), 45);
+    odd  = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), magic), 45);
+    hi   = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+
+    // Lanes of 16 bits: lo | hi << 16.
+    v = _mm_sub_epi32(x, _mm_madd_epi16(hi, _mm_set1_epi32(10000)));
+    v = _mm_or_si128(v, _mm_slli_epi32(hi, 16));
+
+    // Divide each 16-bit lane by 100, then by 10.
+    q = _mm_srli_epi16(_mm_mulhi_epu16(v, _mm_set1_epi16(5243)), 3);
+    v = _mm_sub_epi16(v, _mm_mullo_epi16(q, _mm_set1_epi16(100)));
+    v = _mm_or_si128(_mm_slli_epi16(q, 8), v);
+    t = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi16(0xff)), _mm_set1_epi16(6554));
+    t = _mm_or_si128(t, _mm_slli_epi16(_mm_mulhi_epu16(_mm_srli_epi16(v, 8), _mm_set1_epi16(6554)), 8));
+    v = _mm_sub_epi8(v, _mm_add_epi8(_mm_slli_epi16(t, 3), _mm_slli_epi16(t, 1)));
+    return _mm_or_si128(_mm_slli_epi16(t, 4), v);
+}
+
+static __m128i decode_sse2(__m128i x)
+{
+    const __m128i nib = _mm_set1_epi8(0x0f);
+    __m128i lo, hi, v;
+
+    // Bytes: 0...99.
+    lo = _mm_and_si128(x, nib);
+    hi = _mm_and_si128(_mm_srli_epi16(x, 4), nib);
+    v  = _mm_add_epi8(lo, _mm_mullo_epi16(hi, _mm_set1_epi16(10)));
+
+    // Lanes of 16 bits: 0...9999.
+    lo = _mm_and_si128(v, _mm_set1_epi16(0xff));
+    v  = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_srli_epi16(v, 8), _mm_set1_epi16(100)));
+
+    // Lanes of 32 bits.
+    return _mm_madd_epi16(v, _mm_set1_epi32(10000 << 16 | 1));
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNEL
+//
+// AVX2 kernels: eight values at a time.
+// Same algorithm as SSE2 kernels.
+//
+__attribute__((target("avx2")))
+static void encode_avx2(unsigned *dst, const unsigned *src, int n)
+{
+    const __m256i magic = _mm256_set1_epi32(0xd1b71759);
+    int i;
+
+    for (i=0; i+8<=n; i+=8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i even, odd, hi, v, q, t;
+
+        // Values above 99999999 are left for the scalar version,
+        // which keeps the eight least significant digits.
+        if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(
+                _mm256_xor_si256(x, _mm256_set1_epi32(0x80000000)),
+                _mm256_set1_epi32(99999999 ^ 0x80000000)))) {
+            int k;
+            for (k=0; k<8; k++)
+                dst[i+k] = bcd_encode(src[i+k]);
+            continue;
+        }
+        even = _mm256_srli_epi64(_mm256_mul_epu32(x, magic), 45);
+        odd  = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), magic), 45);
+        hi   = _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+
+        v = _mm256_sub_epi32(x, _mm256_madd_epi16(hi, _mm256_set1_epi32(10000)));
+        v = _mm256_or_si256(v, _mm256_slli_epi32(hi, 16));
+
+        q = _mm256_srli_epi16(_mm256_mulhi_epu16(v, _mm256_set1_epi16(5243)), 3);
+        v = _mm256_sub_epi16(v, _mm256_mullo_epi16(q, _mm256_set1_epi16(100)));
+        v = _mm256_or_si256(_mm256_slli_epi16(q, 8), v);
+        t = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi16(0xff)), _mm256_set1_epi16(6554));
+        t = _mm256_or_si256(t, _mm256_slli_epi16(_mm256_mulhi_epu16(_mm256_srli_epi16(v, 8), _mm256_set1_epi16(6554)), 8));
+        v = _mm256_sub_epi8(v, _mm256_add_epi8(_mm256_slli_epi16(t, 3), _mm256_slli_epi16(t, 1)));
+        v = _mm256_or_si256(_mm256_slli_epi16(t, 4), v);
+
+        _mm256_storeu_si256((__m256i*) (dst + i), v);
+    }
+    for (; i<n; i++)
+        dst[i] = bcd_encode(src[i]);
+}
+
+__attribute__((target("avx2")))
+static void decode_avx2(unsigned *dst, const unsigned *src, int n)
+{
+    const __m256i nib = _mm256_set1_epi8(0x0f);
+    int i;
+
+    for (i=0; i+8<=n; i+=8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i lo, hi, v;
+
+        lo = _mm256_and_si256(x, nib);
+        hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nib);
+        v  = _mm256_add_epi8(lo, _mm256_mullo_epi16(hi, _mm256_set1_epi16(10)));
+
+        lo = _mm256_and_si256(v, _mm256_set1_epi16(0xff));
+        v  = _mm256_add_epi16(lo, _mm256_mullo_epi16(_mm256_srli_epi16(v, 8), _mm256_set1_epi16(100)));
+        v  = _mm256_madd_epi16(v, _mm256_set1_epi32(10000 << 16 | 1));
+
+        _mm256_storeu_si256((__m256i*) (dst + i), v);
+    }
+    for (; i<n; i++)
+        dst[i] = bcd_decode(src[i]);
+}
+
+//
+// Check once whether the processor supports AVX2.
+//
+static int avx2_flag = -1;
+
+static int have_avx2()
+{
+    if (avx2_flag < 0) {
+        __builtin_cpu_init();
+        avx2_flag = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return avx2_flag;
+}
+#endif
+
+//
+// Enable or disable the AVX2 kernels, to test the SSE2 ones.
+// Return 1 when the AVX2 kernels are in use.
+//
+int bcd_select_avx2(int enable)
+{
+#ifdef HAVE_AVX2_KERNEL
+    avx2_flag = -1;
+    if (enable)
+        return have_avx2();
+    avx2_flag = 0;
+#endif
+    return 0;
+}
+
+//
+// Convert array of binary values 0...99999999 to BCD.
+// Source and destination may be the same array.
+//
+void bcd_encode_array(unsigned *dst, const unsigned *src, int n)
+{
+    int i = 0;
+
+#ifdef HAVE_AVX2_KERNEL
+    if (have_avx2()) {
+        encode_avx2(dst, src, n);
+        return;
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i+4<=n; i+=4) {
+        __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+
+        // Values above 99999999 are left for the scalar version.
+        if (_mm_movemask_epi8(_mm_cmpgt_epi32(
+                _mm_xor_si128(x, _mm_set1_epi32(0x80000000)),
+                _mm_set1_epi32(99999999 ^ 0x80000000)))) {
+            int k;
+            for (k=0; k<4; k++)
+                dst[i+k] = bcd_encode(src[i+k]);
+            continue;
+        }
+        _mm_storeu_si128((__m128i*) (dst + i), encode_sse2(x));
+    }
+#endif
+    for (; i<n; i++)
+        dst[i] = bcd_encode(src[i]);
+}
+
+//
+// Convert array of BCD values to binary.
+// Source and destination may be the same array.
+//
+void bcd_decode_array(unsigned *dst, const unsigned *src, int n)
+{
+    int i = 0;
+
+#ifdef HAVE_AVX2_KERNEL
+    if (have_avx2()) {
+        decode_avx2(dst, src, n);
+        return;
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i+4<=n; i+=4) {
+        __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+
+        _mm_storeu_si128((__m128i*) (dst + i), decode_sse2(x));
+    }
+#endif
+    for (; i<n; i++)
+        dst[i] = bcd_decode(src[i]);
+}
@@ -69,17 +69,57 @@ typedef struct {
     unsigned    string_index : 8;
 } status_t;
 
+//
+// Limits for the device being busy, in milliseconds.
+//
+#define BUSY_TIMEOUT_MSEC       2000    // Command or write
+#define ERASE_TIMEOUT_MSEC      10000   // Erase of 64-kbyte block
+
+// Timeout of control transfers, adapted to round-trip time.
+// Flash operations can delay replies, so the lower bound is generous.
+static rtt_t rtt = RTT_INIT("DFU", 5000, 1000, ERASE_TIMEOUT_MSEC, 2);
+
 static libusb_context *ctx = NULL;
 static libusb_device_handle *dev;
 static status_t status;
+static unsigned transfer_size = 1024;   // wTransferSize of the device
+
+//
+// Control transfer with adaptive timeout.
+// Requests to host have no side effects, so they are repeated on timeout.
+// Requests to device are not: the device may have executed them.
+//
+static int control(int type, int request, int value, unsigned char *data, int nbytes)
+{
+    unsigned attempt = 0;
+
+    for (;;) {
+        unsigned long long start = now_usec();
+        int error = libusb_control_transfer(dev, type, request, value, 0,
+            data, nbytes, rtt_timeout(&rtt, attempt));
+
+        if (error != LIBUSB_ERROR_TIMEOUT) {
+            // Only unambiguous replies are measured (Karn's algorithm).
+            if (error >= 0 && attempt == 0)
+                rtt_sample(&rtt, start);
+            return error;
+        }
+        if (type != REQUEST_TYPE_TO_HOST) {
+            rtt.nfailures++;
+            return error;
+        }
+        if (! rtt_retry(&rtt, attempt++))
+            return error;
+    }
+}
 
 static int detach(int timeout)
 {
     if (trace_flag) {
         printf("--- Send DETACH\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_DEVICE,
-        REQUEST_DETACH, timeout, 0, NULL, 0, 0);
+    int error = control(REQUEST_TYPE_TO_DEVICE,
+        REQUEST_DETACH, timeout, NULL, 0);
     return error;
 }
 
@@ -88,8 +128,8 @@ static int get_status()
     if (trace_flag) {
         printf("--- Send GETSTATUS [6]\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_HOST,
-        REQUEST_GETSTATUS, 0, 0, (unsigned char*)&status, 6, 0);
+    int error = control(REQUEST_TYPE_TO_HOST,
+        REQUEST_GETSTATUS, 0, (unsigned char*)&status, 6);
     if (trace_flag && error >= 0) {
         printf("--- Recv ");
         print_hex((unsigned char*)&status, 6);
@@ -103,8 +143,8 @@ static int clear_status()
     if (trace_flag) {
         printf("--- Send CLRSTATUS\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_DEVICE,
-        REQUEST_CLRSTATUS, 0, 0, NULL, 0, 0);
+    int error = control(REQUEST_TYPE_TO_DEVICE,
+        REQUEST_CLRSTATUS, 0, NULL, 0);
     return error;
 }
 
@@ -115,8 +155,8 @@ static int get_state(int *pstate)
     if (trace_flag) {
         printf("--- Send GETSTATE [1]\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_HOST,
-        REQUEST_GETSTATE, 0, 0, &state, 1, 0);
+    int error = control(REQUEST_TYPE_TO_HOST,
+        REQUEST_GETSTATE, 0, &state, 1);
     *pstate = state;
     if (trace_flag && error >= 0) {
         printf("--- Recv ");
@@ -131,11 +171,46 @@ static int dfu_abort()
     if (trace_flag) {
         printf("--- Send ABORT\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_DEVICE,
-        REQUEST_ABORT, 0, 0, NULL, 0, 0);
+    int error = control(REQUEST_TYPE_TO_DEVICE,
+        REQUEST_ABORT, 0, NULL, 0);
     return error;
 }
 
+//
+// Get status, and wait for bwPollTimeout as requested by the device.
+// Repeat while the device is busy, but no longer than timeout_msec.
+// Return the resulting state.
+//
+static int poll_status(int timeout_msec)
+{
+    unsigned long long deadline = now_usec() / 1000 + timeout_msec;
+
+    for (;;) {
+        int error = get_status();
+        if (error < 0) {
+            fprintf(stderr, "%s: cannot get status: %d: %s\n",
+                __func__, error, libusb_strerror(error));
+            exit(-1);
+        }
+
+        if (status.poll_timeout > 0) {
+            if (trace_flag) {
+                printf("--- Wait %u msec\n", status.poll_timeout);
+            }
+            usleep(status.poll_timeout * 1000);
+        }
+
+        if (status.state != dfuDNBUSY && status.state != dfuMANIFEST)
+            return status.state;
+
+        if (now_usec() / 1000 > deadline) {
+            fprintf(stderr, "%s: device busy for more than %d msec\n",
+                __func__, timeout_msec);
+            exit(-1);
+        }
+    }
+}
+
 static void wait_dfu_idle()
 {
     int state, error;
@@ -160,8 +235,12 @@ static void wait_dfu_idle()
             error = clear_status();
             break;
 
-        case appDETACH:
         case dfuDNBUSY:
+            // Status request advances the state machine.
+            poll_status(BUSY_TIMEOUT_MSEC);
+            continue;
+
+        case appDETACH:
         case dfuMANIFEST_WAIT_RESET:
             usleep(100000);
             continue;
@@ -179,25 +258,41 @@ static void wait_dfu_idle()
     }
 }
 
+//
+// Wait until the device completes a download request,
+// and return it to dfuIDLE state.
+// When status already reports idle, no more requests are needed.
+//
+static void wait_dnload_done(int timeout_msec)
+{
+    if (plan_flag)
+        return;
+    if (poll_status(timeout_msec) != dfuIDLE)
+        wait_dfu_idle();
+}
+
 static void md380_command(uint8_t a, uint8_t b)
 {
     unsigned char cmd[2] = { a, b };
 
+    if (plan_flag) {
+        // DNLOAD and GETSTATUS.
+        plan_account("DFU command", 1, 2, 0);
+        return;
+    }
     if (trace_flag) {
         printf("--- Send DNLOAD [2] ");
         print_hex(cmd, 2);
         printf("\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_DEVICE,
-        REQUEST_DNLOAD, 0, 0, cmd, 2, 0);
+    int error = control(REQUEST_TYPE_TO_DEVICE,
+        REQUEST_DNLOAD, 0, cmd, 2);
     if (error < 0) {
         fprintf(stderr, "%s: cannot send command: %d: %s\n",
             __func__, error, libusb_strerror(error));
         exit(-1);
     }
-    get_status();
-    usleep(100000);
-    wait_dfu_idle();
+    wait_dnload_done(BUSY_TIMEOUT_MSEC);
 }
 
 static void set_address(uint32_t address)
@@ -209,20 +304,23 @@ static void set_address(uint32_t address)
         (uint8_t)(address >> 24),
     };
 
+    if (plan_flag) {
+        plan_account("DFU command", 1, 2, 0);
+        return;
+    }
     if (trace_flag) {
         printf("--- Send DNLOAD [5] ");
         print_hex(cmd, 5);
         printf("\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_DEVICE,
-        REQUEST_DNLOAD, 0, 0, cmd, 5, 0);
+    int error = control(REQUEST_TYPE_TO_DEVICE,
+        REQUEST_DNLOAD, 0, cmd, 5);
     if (error < 0) {
         fprintf(stderr, "%s: cannot send command: %d: %s\n",
             __func__, error, libusb_strerror(error));
         exit(-1);
     }
-    get_status();
-    wait_dfu_idle();
+    wait_dnload_done(BUSY_TIMEOUT_MSEC);
 }
 
 static void erase_block(uint32_t address, int progress_flag)
@@ -234,20 +332,23 @@ static void erase_block(uint32_t address, int progress_flag)
         (uint8_t)(address >> 24),
     };
 
+    if (plan_flag) {
+        plan_account("DFU erase", 1, 1, 0);
+        return;
+    }
     if (trace_flag) {
         printf("--- Send DNLOAD [5] ");
         print_hex(cmd, 5);
         printf("\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_DEVICE,
-        REQUEST_DNLOAD, 0, 0, cmd, 5, 0);
+    int error = control(REQUEST_TYPE_TO_DEVICE,
+        REQUEST_DNLOAD, 0, cmd, 5);
     if (error < 0) {
         fprintf(stderr, "%s: cannot send command: %d: %s\n",
             __func__, error, libusb_strerror(error));
         exit(-1);
     }
-    get_status();
-    wait_dfu_idle();
+    wait_dnload_done(ERASE_TIMEOUT_MSEC);
 
     if (progress_flag) {
         fprintf(stderr, "#");
@@ -255,6 +356,47 @@ static void erase_block(uint32_t address, int progress_flag)
     }
 }
 
+//
+// Find wTransferSize in the DFU functional descriptor.
+// Fall back to 1 kbyte, when not found or unusable.
+//
+static void get_transfer_size()
+{
+    struct libusb_config_descriptor *config;
+    const unsigned char *p, *end;
+    int i, k;
+
+    transfer_size = 1024;
+    if (libusb_get_active_config_descriptor(libusb_get_device(dev), &config) < 0)
+        return;
+
+    for (i=0; i<config->bNumInterfaces; i++) {
+        const struct libusb_interface *intf = &config->interface[i];
+
+        for (k=0; k<intf->num_altsetting; k++) {
+            p = intf->altsetting[k].extra;
+            end = p + intf->altsetting[k].extra_length;
+
+            // Descriptor type 0x21: bmAttributes, wDetachTimeOut, wTransferSize.
+            for (; p && p + 7 <= end && p[0] >= 2; p += p[0]) {
+                if (p[1] == 0x21 && p[0] >= 7) {
+                    unsigned size = p[5] | p[6] << 8;
+
+                    // Block boundaries must match the memory map.
+                    if (size >= 1024 && size <= 0x10000/2 && !(size & (size - 1)))
+                        transfer_size = size;
+                    goto done;
+                }
+            }
+        }
+    }
+done:
+    libusb_free_config_descriptor(config);
+    if (trace_flag) {
+        printf("--- Transfer size %u bytes\n", transfer_size);
+    }
+}
+
 static const char *identify()
 {
     static uint8_t data[64];
@@ -264,8 +406,8 @@ static const char *identify()
     if (trace_flag) {
         printf("--- Send UPLOAD [64]\n");
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_HOST,
-        REQUEST_UPLOAD, 0, 0, data, 64, 0);
+    int error = control(REQUEST_TYPE_TO_HOST,
+        REQUEST_UPLOAD, 0, data, 64);
     if (error < 0) {
         fprintf(stderr, "%s: cannot read data: %d: %s\n",
             __func__, error, libusb_strerror(error));
@@ -280,6 +422,112 @@ static const char *identify()
     return (const char*) data;
 }
 
+//
+// Get the serial number of the opened device, to identify the radio.
+//
+static void get_serial(libusb_device_handle *handle)
+{
+    struct libusb_device_descriptor desc;
+
+    usb_serial[0] = 0;
+    if (libusb_get_device_descriptor(libusb_get_device(handle), &desc) < 0 ||
+        desc.iSerialNumber == 0 ||
+        libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber,
+            (unsigned char*) usb_serial, sizeof(usb_serial)) < 0)
+        usb_serial[0] = 0;
+}
+
+//
+// Get the location of the device: bus and port numbers,
+// as named in sysfs, like "1-1.4".  Return 0 when not known.
+//
+static int get_location(libusb_device *device, char *name, int size)
+{
+    uint8_t ports[8];
+    int nports, len, k;
+
+    nports = libusb_get_port_numbers(device, ports, sizeof(ports));
+    if (nports <= 0)
+        return 0;
+    len = snprintf(name, size, "%d", libusb_get_bus_number(device));
+    for (k=0; k<nports && len < size; k++)
+        len += snprintf(name + len, size - len, "%c%d", k ? '.' : '-', ports[k]);
+    return 1;
+}
+
+//
+// Open the device with given VID:PID. When usb_location is set,
+// only the device at this location is taken.
+//
+static libusb_device_handle *open_device(int vid, int pid)
+{
+    libusb_device **list, *found = 0;
+    libusb_device_handle *handle = 0;
+    struct libusb_device_descriptor desc;
+    char name[32];
+    ssize_t n, i;
+
+    if (! usb_location)
+        return libusb_open_device_with_vid_pid(ctx, vid, pid);
+
+    n = libusb_get_device_list(ctx, &list);
+    if (n < 0)
+        return 0;
+    for (i=0; i<n; i++) {
+        if (libusb_get_device_descriptor(list[i], &desc) == 0 &&
+            desc.idVendor == vid && desc.idProduct == pid &&
+            get_location(list[i], name, sizeof(name)) &&
+            strcmp(name, usb_location) == 0) {
+            found = list[i];
+            break;
+        }
+    }
+    if (found && libusb_open(found, &handle) < 0)
+        handle = 0;
+    libusb_free_device_list(list, 1);
+    return handle;
+}
+
+static int compare_locations(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+//
+// Find locations of all attached devices with VID:PID from the list.
+// The list is terminated by zero; each entry is VID << 16 | PID.
+// Locations are sorted, so every process sees the same order.
+// Return the number of devices found.
+//
+int usb_find_locations(const unsigned *vidpid, char (*location)[32], int maxloc)
+{
+    libusb_context *c;
+    libusb_device **list;
+    struct libusb_device_descriptor desc;
+    ssize_t n, i;
+    int nloc = 0, k;
+
+    if (libusb_init(&c) < 0)
+        return 0;
+    n = libusb_get_device_list(c, &list);
+    for (i=0; i<n && nloc<maxloc; i++) {
+        if (libusb_get_device_descriptor(list[i], &desc) < 0)
+            continue;
+        for (k=0; vidpid[k]; k++) {
+            if (vidpid[k] == (unsigned) (desc.idVendor << 16 | desc.idProduct)) {
+                if (get_location(list[i], location[nloc], 32))
+                    nloc++;
+                break;
+            }
+        }
+    }
+    if (n >= 0)
+        libusb_free_device_list(list, 1);
+    libusb_exit(c);
+    qsort(location, nloc, 32, compare_locations);
+    return nloc;
+}
+
 const char *dfu_init(unsigned vid, unsigned pid)
 {
     int error = libusb_init(&ctx);
@@ -289,7 +537,7 @@ const char *dfu_init(unsigned vid, unsigned pid)
         exit(-1);
     }
 
-    dev = libusb_open_device_with_vid_pid(ctx, vid, pid);
+    dev = open_device(vid, pid);
     if (!dev) {
         if (trace_flag) {
             fprintf(stderr, "Cannot find USB device %04x:%04x\n",
@@ -299,10 +547,13 @@ const char *dfu_init(unsigned vid, unsigned pid)
         ctx = 0;
         return 0;
     }
+    get_serial(dev);
     if (libusb_kernel_driver_active(dev, 0)) {
         libusb_detach_kernel_driver(dev, 0);
     }
 
+    get_transfer_size();
+
     error = libusb_claim_interface(dev, 0);
     if (error < 0) {
         fprintf(stderr, "Failed to claim USB interface: %d: %s\n",
@@ -328,6 +579,10 @@ const char *dfu_init(unsigned vid, unsigned pid)
 
 void dfu_close()
 {
+    if (trace_flag)
+        rtt_print_stats(&rtt);
+    rtt_save(&rtt);
+
     if (ctx) {
         libusb_release_interface(dev, 0);
         libusb_close(dev);
@@ -339,10 +594,8 @@ void dfu_close()
 void dfu_erase(unsigned start, unsigned finish)
 {
     // Enter Programming Mode.
-    get_status();
-    wait_dfu_idle();
+    wait_dnload_done(BUSY_TIMEOUT_MSEC);
     md380_command(0x91, 0x01);
-    usleep(100000);
 
     if (start == 0) {
         // Erase 256kbytes of configuration memory.
@@ -380,50 +633,152 @@ void dfu_erase(unsigned start, unsigned finish)
     set_address(0x00000000);
 }
 
-void dfu_read_block(int bno, uint8_t *data, int nbytes)
+//
+// Get the size of data transfers.
+//
+unsigned dfu_transfer_size()
 {
-    if (bno >= 256 && bno < 2048)
-        bno += 832;
+    return transfer_size;
+}
 
-    if (trace_flag) {
-        printf("--- Send UPLOAD [%d]\n", nbytes);
+//
+// Convert offset in memory image to address in the device.
+// Image offsets 256k...2M are located at 0x110000 in the device.
+//
+static unsigned image_to_device(unsigned offset, unsigned *limit)
+{
+    if (offset < 256*1024) {
+        *limit = 256*1024;
+        return offset;
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_HOST,
-        REQUEST_UPLOAD, bno+2, 0, data, nbytes, 0);
-    if (error < 0) {
-        fprintf(stderr, "%s: cannot read block %d, nbytes = %d: %d: %s\n",
-            __func__, bno, nbytes, error, libusb_strerror(error));
-        exit(-1);
+    if (offset < 2048*1024) {
+        *limit = 2048*1024;
+        return offset + 832*1024;
     }
-    if (trace_flag > 1) {
-        printf("--- Recv ");
-        print_hex(data, nbytes);
-        printf("\n");
+    *limit = ~0;
+    return offset;
+}
+
+//
+// Split a request at block boundaries, and at gaps of memory map.
+// Return the device block number and the size of the first piece.
+//
+static unsigned next_block(unsigned offset, unsigned nbytes, int *bno)
+{
+    unsigned limit, addr = image_to_device(offset, &limit);
+    unsigned n = transfer_size - addr % transfer_size;
+
+    if (addr % transfer_size != 0) {
+        fprintf(stderr, "%s: address %#x is not aligned to block size %u\n",
+            __func__, addr, transfer_size);
+        exit(-1);
     }
-    get_status();
+    if (n > nbytes)
+        n = nbytes;
+    if (n > limit - offset)
+        n = limit - offset;
+
+    // Block numbers start from 2, with address pointer at zero.
+    *bno = addr / transfer_size + 2;
+    return n;
 }
 
-void dfu_write_block(int bno, uint8_t *data, int nbytes)
+//
+// Read data from memory image, using as few transfers as possible.
+//
+void dfu_read(unsigned offset, uint8_t *data, unsigned nbytes)
 {
-    if (bno >= 256 && bno < 2048)
-        bno += 832;
+    while (nbytes > 0) {
+        int bno;
+        unsigned n = next_block(offset, nbytes, &bno);
+
+        if (plan_flag) {
+            // UPLOAD and GETSTATUS; the data stay intact.
+            plan_account("DFU read", 1, 2, n);
+            offset += n;
+            data += n;
+            nbytes -= n;
+            continue;
+        }
+        if (trace_flag) {
+            printf("--- Send UPLOAD [%u]\n", n);
+        }
+        int error = control(REQUEST_TYPE_TO_HOST,
+            REQUEST_UPLOAD, bno, data, n);
+        if (error < 0) {
+            fprintf(stderr, "%s: cannot read block %d, nbytes = %u: %d: %s\n",
+                __func__, bno, n, error, libusb_strerror(error));
+            exit(-1);
+        }
+        if (trace_flag > 1) {
+            printf("--- Recv ");
+            print_hex(data, n);
+            printf("\n");
+        }
+        get_status();
 
-    if (trace_flag) {
-        printf("--- Send DNLOAD [%d] ", nbytes);
-        if (trace_flag > 1)
-            print_hex(data, nbytes);
-        printf("\n");
+        offset += n;
+        data += n;
+        nbytes -= n;
     }
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_DEVICE,
-        REQUEST_DNLOAD, bno+2, 0, data, nbytes, 0);
-    if (error < 0) {
-        fprintf(stderr, "%s: cannot write block %d, nbytes = %d: %d: %s\n",
-            __func__, bno, nbytes, error, libusb_strerror(error));
-        exit(-1);
+}
+
+//
+// Write data to memory image, using as few transfers as possible.
+//
+void dfu_write(unsigned offset, uint8_t *data, unsigned nbytes)
+{
+    while (nbytes > 0) {
+        int bno;
+        unsigned n = next_block(offset, nbytes, &bno);
+
+        if (plan_flag) {
+            // DNLOAD and GETSTATUS.
+            plan_account("DFU write", 1, 2, n);
+            offset += n;
+            data += n;
+            nbytes -= n;
+            continue;
+        }
+        if (trace_flag) {
+            printf("--- Send DNLOAD [%u] ", n);
+            if (trace_flag > 1)
+                print_hex(data, n);
+            printf("\n");
+        }
+        int error = control(REQUEST_TYPE_TO_DEVICE,
+            REQUEST_DNLOAD, bno, data, n);
+        if (error < 0) {
+            fprintf(stderr, "%s: cannot write block %d, nbytes = %u: %d: %s\n",
+                __func__, bno, n, error, libusb_strerror(error));
+            exit(-1);
+        }
+        wait_dnload_done(BUSY_TIMEOUT_MSEC);
+
+        offset += n;
+        data += n;
+        nbytes -= n;
     }
+}
 
-    get_status();
-    wait_dfu_idle();
+//
+// Read callback for the link test.
+//
+static int link_read(unsigned addr, unsigned char *data, const link_param_t *param)
+{
+    dfu_read(addr, data, param->size);
+    return 0;
+}
+
+//
+// Benchmark the link with reads of a span of memory.
+// Block size is defined by the device, one request in flight.
+//
+void dfu_linktest(unsigned offset, unsigned span)
+{
+    link_param_t tab[] = { { transfer_size, 1 } };
+
+    linktest_run("DFU", link_read, tab, 1, offset, span);
 }
 
 void dfu_reboot()
@@ -438,8 +793,8 @@ void dfu_reboot()
         printf("\n");
     }
     wait_dfu_idle();
-    int error = libusb_control_transfer(dev, REQUEST_TYPE_TO_DEVICE,
-        REQUEST_DNLOAD, 0, 0, cmd, 2, 0);
+    int error = control(REQUEST_TYPE_TO_DEVICE,
+        REQUEST_DNLOAD, 0, cmd, 2);
     if (error < 0) {
         fprintf(stderr, "%s: cannot send command: %d: %s\n",
             __func__, error, libusb_strerror(error));
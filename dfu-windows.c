@@ -253,6 +253,10 @@ static void md380_command(uint8_t a, uint8_t b)
 {
     unsigned char cmd[2] = { a, b };
 
+    if (plan_flag) {
+        plan_account("DFU command", 1, 2, 0);
+        return;
+    }
     if (trace_flag) {
         printf("--- Send DNLOAD [2] ");
         print_hex(cmd, 2);
@@ -277,6 +281,10 @@ static void set_address(uint32_t address)
         (uint8_t)(address >> 24),
     };
 
+    if (plan_flag) {
+        plan_account("DFU command", 1, 2, 0);
+        return;
+    }
     if (trace_flag) {
         printf("--- Send DNLOAD [5] ");
         print_hex(cmd, 5);
@@ -300,6 +308,10 @@ static void erase_block(uint32_t address, int progress_flag)
         (uint8_t)(address >> 24),
     };
 
+    if (plan_flag) {
+        plan_account("DFU erase", 1, 1, 0);
+        return;
+    }
     if (trace_flag) {
         printf("--- Send DNLOAD [5] ");
         print_hex(cmd, 5);
@@ -441,10 +453,13 @@ void dfu_close()
 void dfu_erase(unsigned start, unsigned finish)
 {
     // Enter Programming Mode.
-    get_status();
-    wait_dfu_idle();
+    if (! plan_flag) {
+        get_status();
+        wait_dfu_idle();
+    }
     md380_command(0x91, 0x01);
-    usleep(100000);
+    if (! plan_flag)
+        usleep(100000);
 
     if (start == 0) {
         // Erase 256kbytes of configuration memory.
@@ -482,11 +497,16 @@ void dfu_erase(unsigned start, unsigned finish)
     set_address(0x00000000);
 }
 
-void dfu_read_block(int bno, uint8_t *data, int nbytes)
+static void read_block(int bno, uint8_t *data, int nbytes)
 {
     if (bno >= 256 && bno < 2048)
         bno += 832;
 
+    if (plan_flag) {
+        // The data stay intact.
+        plan_account("DFU read", 1, 2, nbytes);
+        return;
+    }
     if (trace_flag) {
         printf("--- Send UPLOAD [%d]\n", nbytes);
     }
@@ -504,11 +524,15 @@ void dfu_read_block(int bno, uint8_t *data, int nbytes)
     get_status();
 }
 
-void dfu_write_block(int bno, uint8_t *data, int nbytes)
+static void write_block(int bno, uint8_t *data, int nbytes)
 {
     if (bno >= 256 && bno < 2048)
         bno += 832;
 
+    if (plan_flag) {
+        plan_account("DFU write", 1, 2, nbytes);
+        return;
+    }
     if (trace_flag) {
         printf("--- Send DNLOAD [%d] ", nbytes);
         if (trace_flag > 1)
@@ -526,6 +550,46 @@ void dfu_write_block(int bno, uint8_t *data, int nbytes)
     wait_dfu_idle();
 }
 
+//
+// The Windows driver always transfers 1 kbyte per block.
+//
+unsigned dfu_transfer_size()
+{
+    return 1024;
+}
+
+void dfu_read(unsigned offset, uint8_t *data, unsigned nbytes)
+{
+    for (; nbytes >= 1024; offset += 1024, data += 1024, nbytes -= 1024)
+        read_block(offset / 1024, data, 1024);
+}
+
+void dfu_write(unsigned offset, uint8_t *data, unsigned nbytes)
+{
+    for (; nbytes >= 1024; offset += 1024, data += 1024, nbytes -= 1024)
+        write_block(offset / 1024, data, 1024);
+}
+
+//
+// Read callback for the link test.
+//
+static int link_read(unsigned addr, unsigned char *data, const link_param_t *param)
+{
+    dfu_read(addr, data, param->size);
+    return 0;
+}
+
+//
+// Benchmark the link with reads of a span of memory.
+// Block size is defined by the device, one request in flight.
+//
+void dfu_linktest(unsigned offset, unsigned span)
+{
+    link_param_t tab[] = { { 1024, 1 } };
+
+    linktest_run("DFU", link_read, tab, 1, offset, span);
+}
+
 void dfu_reboot()
 {
     unsigned char cmd[2] = { 0x91, 0x05 };
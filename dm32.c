@@ -52,6 +52,8 @@
 
 // Simple helpers and minimal protocol implementation
 static unsigned dm32_written_max = 0;
+// Reply header timeout: 4 sec until measured, then adapted to round-trip time.
+static rtt_t dm32_rtt = RTT_INIT("DM32", 4000, 300, 4000, 3);
 
 typedef struct { uint32_t addr; uint16_t len; } dm32_block_t;
 // Common entry types used across collectors
@@ -193,7 +195,7 @@ static int dm32_read_header_sync(unsigned char hdr[6], int timeout_msec)
 }
 
 // DM-32/Anytone-like block read: 0x52 + 24-bit addr (big-endian) + 16-bit len (little-endian)
-static int dm32_read_block(uint32_t addr24, uint16_t len)
+static int dm32_read_block(uint32_t addr24, uint16_t len, unsigned attempt)
 {
     unsigned char cmd[6];
     unsigned char hdr[6];
@@ -214,12 +216,15 @@ static int dm32_read_block(uint32_t addr24, uint16_t len)
     if (trace_flag) {
         fprintf(stderr, "DM32: R %02X %02X %02X %02X %02X\n", cmd[1], cmd[2], cmd[3], cmd[4], cmd[5]);
     }
+    unsigned long long start = now_usec();
     if (serial_write(cmd, 6) < 0)
         return -1;
 
     // Read response header: 0x57 'W' + same addr (3) + len (2)
-    if (dm32_read_header_sync(hdr, 4000) != 0)
+    if (dm32_read_header_sync(hdr, rtt_timeout(&dm32_rtt, attempt)) != 0)
         return -1;
+    if (attempt == 0)
+        rtt_sample(&dm32_rtt, start);
     if (hdr[0] != 0x57 || hdr[1] != cmd[1] || hdr[2] != cmd[2] || hdr[3] != cmd[3] || hdr[4] != cmd[4] || hdr[5] != cmd[5]) {
         if (trace_flag) {
             fprintf(stderr, "DM32: Unexpected W header\n");
@@ -256,24 +261,33 @@ static int dm32_read_block(uint32_t addr24, uint16_t len)
 
 static int dm32_read_block_retry(uint32_t addr24, uint16_t len, int attempts)
 {
-    for (int i = 0; i < attempts; ++i) {
-        if (dm32_read_block(addr24, len) == 0)
+    unsigned i;
+
+    for (i = 0; ; ++i) {
+        if (dm32_read_block(addr24, len, i) == 0)
             return 0;
+        if ((int)i + 1 >= attempts) {
+            dm32_rtt.nfailures++;
+            return -1;
+        }
+        if (!rtt_retry(&dm32_rtt, i))
+            return -1;
         usleep(50000);
     }
-    return -1;
 }
 static void dm32_print_version(radio_device_t *radio, FILE *out)
 {
     fprintf(out, "Baofeng DM-32 (experimental)\n");
 }
 
-static void dm32_download(radio_device_t *radio)
+// Open the port and enter PROGRAM mode, replaying the CPS handshake.
+// Returns 0 on success, -1 when the port cannot be opened.
+static int dm32_enter_program(void)
 {
     // Ensure port is open at 115200 without triggering generic identify.
     if (serial_open_found(DM32_BAUD) < 0) {
         fprintf(stderr, "DM32: failed to open serial port at 115200\n");
-        return;
+        return -1;
     }
     // 0) Nudge the cable/radio lines
     (void)serial_pulse_rts_dtr();
@@ -315,17 +329,43 @@ static void dm32_download(radio_device_t *radio)
     dm32_dump_reads(80);
     (void)serial_write(b06, sizeof(b06));
     dm32_dump_reads(120);
+    return 0;
+}
+
+static void dm32_download(radio_device_t *radio)
+{
+    unsigned done = 0, total = 0, frame = 0;
+    link_param_t link;
+
+    if (dm32_enter_program() < 0)
+        return;
+
+    // Largest frame which the link carries well, found by the link test.
+    if (link_load("DM32", &link))
+        frame = link.size;
 
     // 5) Reads: small probe then mapped blocks
     (void) dm32_read_block_retry(0x008027, 4, 2);
     dm32_dump_reads(50);
 
+    for (unsigned i = 0; i < dm32_nblocks; ++i)
+        total += dm32_blocks[i].len;
     for (unsigned i = 0; i < dm32_nblocks; ++i) {
         if (trace_flag) fprintf(stderr, "DM32: read block %u/%u at %06X len %u\n", i+1, dm32_nblocks, dm32_blocks[i].addr, dm32_blocks[i].len);
-        if (dm32_read_block_retry(dm32_blocks[i].addr, dm32_blocks[i].len, 2) != 0) {
-            fprintf(stderr, "DM32: failed to read block at %06X len %u\n", dm32_blocks[i].addr, dm32_blocks[i].len);
+        for (unsigned off = 0, n; off < dm32_blocks[i].len; off += n) {
+            n = dm32_blocks[i].len - off;
+            if (frame && n > frame)
+                n = frame;
+            if (dm32_read_block_retry(dm32_blocks[i].addr + off, n, 2) != 0) {
+                fprintf(stderr, "DM32: failed to read block at %06X len %u\n", dm32_blocks[i].addr + off, n);
+                progress_error("DM32", "read failed");
+            }
         }
+        done += dm32_blocks[i].len;
+        progress_update(done, total);
     }
+    if (trace_flag)
+        rtt_print_stats(&dm32_rtt);
 
     // Emit slot-level debug CSV for reverse-engineering
     dm32_write_slots_debug_csv();
@@ -333,9 +373,198 @@ static void dm32_download(radio_device_t *radio)
     dm32_write_channels_fields_csv();
 }
 
-static void dm32_upload(radio_device_t *radio, int cont_flag)
+// -----------------------------------------------------------------------------
+// Address-space discovery
+// -----------------------------------------------------------------------------
+// The address space is probed with small reads at a few spots of every
+// region. Regions where all probes see uniform 0xFF or 0x00 fill are skipped;
+// the rest are bisected down to leaves of DM32_LEAF bytes, which are read in
+// full. Live leaves become entries of the generated map, in the format of
+// dm32-map.h, so the next build downloads only live memory.
+#define DM32_PROBE_LEN      16         // Bytes per probe read
+#define DM32_PROBE_SPOTS    8          // Probes per region
+#define DM32_REGION         0x10000    // Top-level region, 64 KiB
+#define DM32_LEAF           0x1000     // Smallest region, read in full
+#define DM32_MAX_RETRIES    3          // Retries tolerated before giving up
+
+typedef struct {
+    uint32_t addr;
+    unsigned nonff;                    // Bytes other than 0xFF
+    unsigned non00;                    // Bytes other than 0x00
+} dm32_leaf_t;
+
+static struct {
+    dm32_leaf_t leaf[DM32_MEMSZ / DM32_LEAF];
+    unsigned nleaves;
+    unsigned nreads;                   // Probe and leaf reads
+    unsigned long long nbytes;         // Bytes transferred
+    unsigned skipped;                  // Bytes judged blank by probes
+    unsigned retries0;                 // Retry count at start
+    int distress;                      // Radio stopped responding properly
+    uint32_t stop_addr;                // Where discovery stopped
+} dm32_disc;
+
+// Read a block for discovery; detect radio distress.
+// Returns 0 on success, -1 when discovery must stop.
+static int dm32_disc_read(uint32_t addr, uint16_t len)
+{
+    if (dm32_disc.distress)
+        return -1;
+    dm32_disc.nreads++;
+    if (dm32_read_block_retry(addr, len, 2) != 0 ||
+        dm32_rtt.nretries - dm32_disc.retries0 > DM32_MAX_RETRIES) {
+        dm32_disc.distress = 1;
+        dm32_disc.stop_addr = addr;
+        return -1;
+    }
+    dm32_disc.nbytes += len;
+    return 0;
+}
+
+// Check whether bytes are uniform 0xFF or 0x00 fill.
+static int dm32_is_blank(const unsigned char *p, unsigned len)
+{
+    unsigned i;
+
+    if (p[0] != 0xFF && p[0] != 0x00)
+        return 0;
+    for (i = 1; i < len; i++)
+        if (p[i] != p[0])
+            return 0;
+    return 1;
+}
+
+// Probe a region at a few spots. Returns 1 when data was seen,
+// 0 when all probes are blank, -1 on distress.
+static int dm32_probe_region(uint32_t addr, unsigned size)
 {
-    fprintf(stderr, "DM32 upload not implemented.\n");
+    unsigned step = size / DM32_PROBE_SPOTS;
+    unsigned i;
+
+    for (i = 0; i < DM32_PROBE_SPOTS; i++) {
+        uint32_t a = addr + i * step + (i & 1) * (step - DM32_PROBE_LEN) / 2;
+
+        if (dm32_disc_read(a, DM32_PROBE_LEN) < 0)
+            return -1;
+        if (!dm32_is_blank(&radio_mem[a], DM32_PROBE_LEN))
+            return 1;
+    }
+    return 0;
+}
+
+// Discover live leaves in the region, recursively.
+static void dm32_discover_region(uint32_t addr, unsigned size)
+{
+    if (size <= DM32_LEAF) {
+        unsigned i, nonff = 0, non00 = 0;
+
+        if (dm32_disc_read(addr, size) < 0)
+            return;
+        for (i = 0; i < size; i++) {
+            if (radio_mem[addr + i] != 0xFF) nonff++;
+            if (radio_mem[addr + i] != 0x00) non00++;
+        }
+        if (dm32_is_blank(&radio_mem[addr], size)) {
+            dm32_disc.skipped += size;
+            return;
+        }
+        dm32_leaf_t *l = &dm32_disc.leaf[dm32_disc.nleaves++];
+        l->addr = addr;
+        l->nonff = nonff;
+        l->non00 = non00;
+        return;
+    }
+
+    int seen = dm32_probe_region(addr, size);
+    if (seen < 0)
+        return;
+    if (seen == 0) {
+        dm32_disc.skipped += size;
+        return;
+    }
+    dm32_discover_region(addr, size / 2);
+    dm32_discover_region(addr + size / 2, size / 2);
+}
+
+static void dm32_discover_map(radio_device_t *radio, FILE *out)
+{
+    unsigned long long start = now_usec();
+    uint32_t addr;
+    unsigned i, live;
+
+    if (dm32_enter_program() < 0)
+        return;
+
+    memset(&dm32_disc, 0, sizeof(dm32_disc));
+    dm32_disc.retries0 = dm32_rtt.nretries;
+    for (addr = 0; addr < DM32_MEMSZ; addr += DM32_REGION) {
+        dm32_discover_region(addr, DM32_REGION);
+        progress_update(addr + DM32_REGION, DM32_MEMSZ);
+        if (dm32_disc.distress)
+            break;
+        if (!trace_flag) {
+            fprintf(stderr, "#");
+            fflush(stderr);
+        }
+    }
+    if (!trace_flag)
+        fprintf(stderr, "\n");
+    if (trace_flag)
+        rtt_print_stats(&dm32_rtt);
+
+    unsigned msec = (now_usec() - start) / 1000;
+    live = dm32_disc.nleaves * DM32_LEAF;
+    fprintf(out, "/*\n");
+    fprintf(out, " * Address map of Baofeng DM-32 memory, generated by 'dmrconfig -m'.\n");
+    fprintf(out, " *\n");
+    fprintf(out, " * Probed 0x000000...0x%06X with %u reads, %llu bytes in %u.%03u sec.\n",
+        (dm32_disc.distress ? dm32_disc.stop_addr : DM32_MEMSZ) - 1,
+        dm32_disc.nreads, dm32_disc.nbytes, msec / 1000, msec % 1000);
+    fprintf(out, " * Live: %u ranges, %u bytes (%u%% of address space).\n",
+        dm32_disc.nleaves, live, (unsigned)(live * 100ULL / DM32_MEMSZ));
+    fprintf(out, " * Blank: %u bytes of uniform 0xFF or 0x00 skipped.\n", dm32_disc.skipped);
+    if (dm32_disc.distress)
+        fprintf(out, " * Stopped at 0x%06X: radio not responding, the map is partial.\n",
+            dm32_disc.stop_addr);
+    fprintf(out, " *\n");
+    fprintf(out, " * Each entry is a 24-bit address and a 16-bit length,\n");
+    fprintf(out, " * with the density of non-0xFF and non-0x00 bytes.\n");
+    fprintf(out, " */\n");
+    for (i = 0; i < dm32_disc.nleaves; i++) {
+        dm32_leaf_t *l = &dm32_disc.leaf[i];
+
+        fprintf(out, "{ 0x%06X, 0x%04X },            // nonFF %3u%%, non00 %3u%%\n",
+            l->addr, DM32_LEAF, l->nonff * 100 / DM32_LEAF, l->non00 * 100 / DM32_LEAF);
+    }
+
+    fprintf(stderr, "DM32: %u live ranges, %u bytes, %u reads in %u.%03u sec.\n",
+        dm32_disc.nleaves, live, dm32_disc.nreads, msec / 1000, msec % 1000);
+    if (dm32_disc.distress)
+        fprintf(stderr, "DM32: radio not responding at 0x%06X, discovery stopped.\n",
+            dm32_disc.stop_addr);
+}
+
+// -----------------------------------------------------------------------------
+// Link test
+// -----------------------------------------------------------------------------
+// R frames of growing length over the first region. A short frame pays the
+// latency more often; a long one suffers more from a lossy cable.
+static int dm32_link_read(unsigned addr, unsigned char *data, const link_param_t *param)
+{
+    return dm32_read_block_retry(addr, param->size, 2) == 0 ? 0 : -1;
+}
+
+static void dm32_linktest(radio_device_t *radio)
+{
+    static const link_param_t tab[] = {
+        { 16, 1 }, { 256, 1 }, { 1024, 1 }, { 4096, 1 },
+    };
+
+    if (dm32_enter_program() < 0)
+        return;
+    linktest_run("DM32", dm32_link_read, tab, 4, 0, DM32_REGION);
+    if (trace_flag)
+        rtt_print_stats(&dm32_rtt);
 }
 
 static int dm32_is_compatible(radio_device_t *radio)
@@ -618,19 +847,10 @@ static int dm32_parse_slot(uint32_t base, dm32_channel_t *out)
 // represent the decimal digits of frequency in 10 Hz units, e.g. 0x44358750 -> 443.58750 MHz
 static double bcd_mhz(const unsigned char *p)
 {
-    int digits[8];
-    unsigned idx = 0;
-    for (int bi = 3; bi >= 0; --bi) {
-        unsigned char byte = p[bi];
-        digits[idx++] = (byte >> 4) & 0xF;
-        digits[idx++] = byte & 0xF;
-    }
-    for (int i = 0; i < 8; ++i) if (digits[i] > 9) return 0.0;
-    uint32_t val = 0;
-    for (int i = 0; i < 8; ++i) {
-        val = val * 10 + (uint32_t)digits[i];
-    }
-    return ((double)val) / 100000.0;
+    unsigned bcd = p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24;
+
+    if (!bcd_valid(bcd)) return 0.0;
+    return bcd_decode(bcd) / 100000.0;
 }
 
 // Helper: read little-endian float32 as MHz
@@ -646,19 +866,10 @@ static double f32_mhz(const unsigned char *p)
 // Alternative BCD decode: read bytes in forward order (little->big)
 static double bcd_mhz_alt(const unsigned char *p)
 {
-    int digits[8];
-    unsigned idx = 0;
-    for (int bi = 0; bi < 4; ++bi) {
-        unsigned char byte = p[bi];
-        digits[idx++] = (byte >> 4) & 0xF;
-        digits[idx++] = byte & 0xF;
-    }
-    for (int i = 0; i < 8; ++i) if (digits[i] > 9) return 0.0;
-    uint32_t val = 0;
-    for (int i = 0; i < 8; ++i) val = val * 10 + (uint32_t)digits[i];
-    double v = ((double)val) / 100000.0;
-    if (v < 0.0 || v > 2000.0) return 0.0;
-    return v;
+    unsigned bcd = p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+
+    if (!bcd_valid(bcd)) return 0.0;
+    return bcd_decode(bcd) / 100000.0;
 }
 
 // Robust frequency decode with fallbacks and sanity using rx_hint when decoding TX
@@ -796,14 +1007,17 @@ static void dm32_write_channels_fields_csv(void)
 // label '\0' [optional 0xFF padding] then bytes 50 87 ?? 44 50 87 ?? 44
 // removed: scan_channels_signature (heuristic)
 
-static void dm32_print_config(radio_device_t *radio, FILE *out, int verbose)
+static void dm32_print_config(radio_device_t *radio, FILE *file, int verbose)
 {
+    outbuf_t ob, *out = &ob;
+
     if (! verbose) return;
 
     // Match examples convention: print radio name header first.
-    fprintf(out, "Radio: %s\n", radio->name);
+    fprintf(file, "Radio: %s\n", radio->name);
+    outbuf_init(&ob, file);
 
-    fprintf(out, "# DM-32: region map (experimental)\n");
+    outbuf_printf(out, "# DM-32: region map (experimental)\n");
     for (unsigned i = 0; i < dm32_nblocks; ++i) {
         uint32_t a = dm32_blocks[i].addr;
         uint32_t e = a + dm32_blocks[i].len;
@@ -840,10 +1054,10 @@ static void dm32_print_config(radio_device_t *radio, FILE *out, int verbose)
         if (strstr(sample1, "Contacts") || strstr(sample2, "Contacts")) hint = " (contacts?)";
         else if (strstr(sample1, "Roam") || strstr(sample2, "Roam")) hint = " (roam?)";
         else if (strings > 10 && a >= 0x006000 && a < 0x007000) hint = " (channel/zone labels?)";
-        fprintf(out, "0x%06X..0x%06X size=%u nonFF=%u non00=%u strings=%u%s\n",
+        outbuf_printf(out, "0x%06X..0x%06X size=%u nonFF=%u non00=%u strings=%u%s\n",
                 a, a + dm32_blocks[i].len - 1, dm32_blocks[i].len, nonff, non00, strings, hint);
-        if (sample1[0]) fprintf(out, "  e.g. '%s'\n", sample1);
-        if (sample2[0]) fprintf(out, "       '%s'\n", sample2);
+        if (sample1[0]) outbuf_printf(out, "  e.g. '%s'\n", sample1);
+        if (sample2[0]) outbuf_printf(out, "       '%s'\n", sample2);
     }
 
     // Before Zones, emit channel tables in examples format using what we know.
@@ -857,23 +1071,23 @@ static void dm32_print_config(radio_device_t *radio, FILE *out, int verbose)
     }
     if (printed) {
         // Digital channels table.
-        fprintf(out, "\n");
-        fprintf(out, "# Table of digital channels.\n");
-        fprintf(out, "# 1) Channel number: 1-%d\n", DM32_NCHAN);
-        fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-        fprintf(out, "# 3) Receive frequency in MHz\n");
-        fprintf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
-        fprintf(out, "# 5) Transmit power: High, Low\n");
-        fprintf(out, "# 6) Scan list: - or index in Scanlist table\n");
-        fprintf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
-        fprintf(out, "# 8) Receive only: -, +\n");
-        fprintf(out, "# 9) Admit criteria: -, Free, Color\n");
-        fprintf(out, "# 10) Color code: 0, 1, 2, 3... 15\n");
-        fprintf(out, "# 11) Time slot: 1 or 2\n");
-        fprintf(out, "# 12) Receive group list: - or index in Grouplist table\n");
-        fprintf(out, "# 13) Contact for transmit: - or index in Contacts table\n");
-        fprintf(out, "#\n");
-        fprintf(out, "Digital Name             Receive   Transmit Power Scan TOT RO Admit  Color Slot RxGL TxContact\n");
+        outbuf_printf(out, "\n");
+        outbuf_printf(out, "# Table of digital channels.\n");
+        outbuf_printf(out, "# 1) Channel number: 1-%d\n", DM32_NCHAN);
+        outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+        outbuf_printf(out, "# 3) Receive frequency in MHz\n");
+        outbuf_printf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
+        outbuf_printf(out, "# 5) Transmit power: High, Low\n");
+        outbuf_printf(out, "# 6) Scan list: - or index in Scanlist table\n");
+        outbuf_printf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
+        outbuf_printf(out, "# 8) Receive only: -, +\n");
+        outbuf_printf(out, "# 9) Admit criteria: -, Free, Color\n");
+        outbuf_printf(out, "# 10) Color code: 0, 1, 2, 3... 15\n");
+        outbuf_printf(out, "# 11) Time slot: 1 or 2\n");
+        outbuf_printf(out, "# 12) Receive group list: - or index in Grouplist table\n");
+        outbuf_printf(out, "# 13) Contact for transmit: - or index in Contacts table\n");
+        outbuf_printf(out, "#\n");
+        outbuf_printf(out, "Digital Name             Receive   Transmit Power Scan TOT RO Admit  Color Slot RxGL TxContact\n");
 
     unsigned idx = 1;
     for (uint32_t p = ch_base; p < ch_end && p < dm32_written_max; p += DM32_CHAN_STRIDE) {
@@ -892,29 +1106,29 @@ static void dm32_print_config(radio_device_t *radio, FILE *out, int verbose)
         else if (diff < -0.599 && diff > -0.601) strcpy(txcol, "-0.6");
         else snprintf(txcol, sizeof(txcol), "%.5f", tx);
 
-        fprintf(out, "%5u   %-16.16s %-8.6g %-8s %-5s %-4s %-3s %-2s %-5u %-4u %-4s %-8s\n",
+        outbuf_printf(out, "%5u   %-16.16s %-8.6g %-8s %-5s %-4s %-3s %-2s %-5u %-4u %-4s %-8s\n",
             idx++, name16, rx, txcol, power, "-", "-", "-",
             (unsigned)ch.color_code, (unsigned)ch.timeslot, "-", "-");
     }
 
         // Analog channels table (unknown mapping yet) with just header for now.
-        fprintf(out, "\n");
-        fprintf(out, "# Table of analog channels.\n");
-        fprintf(out, "# 1) Channel number: 1-%d\n", DM32_NCHAN);
-        fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-        fprintf(out, "# 3) Receive frequency in MHz\n");
-        fprintf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
-        fprintf(out, "# 5) Transmit power: High, Low\n");
-        fprintf(out, "# 6) Scan list: - or index\n");
-        fprintf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
-        fprintf(out, "# 8) Receive only: -, +\n");
-        fprintf(out, "# 9) Admit criteria: -, Free, Tone\n");
-        fprintf(out, "# 10) Squelch level: 0, 1, 2, 3, 4, 5, 6, 7, 8, 9\n");
-        fprintf(out, "# 11) Guard tone for receive, or '-' to disable\n");
-        fprintf(out, "# 12) Guard tone for transmit, or '-' to disable\n");
-        fprintf(out, "# 13) Bandwidth in kHz: 12.5, 20, 25\n");
-        fprintf(out, "#\n");
-        fprintf(out, "Analog  Name             Receive   Transmit Power Scan TOT RO Admit  Squelch RxTone TxTone Width\n");
+        outbuf_printf(out, "\n");
+        outbuf_printf(out, "# Table of analog channels.\n");
+        outbuf_printf(out, "# 1) Channel number: 1-%d\n", DM32_NCHAN);
+        outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+        outbuf_printf(out, "# 3) Receive frequency in MHz\n");
+        outbuf_printf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
+        outbuf_printf(out, "# 5) Transmit power: High, Low\n");
+        outbuf_printf(out, "# 6) Scan list: - or index\n");
+        outbuf_printf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
+        outbuf_printf(out, "# 8) Receive only: -, +\n");
+        outbuf_printf(out, "# 9) Admit criteria: -, Free, Tone\n");
+        outbuf_printf(out, "# 10) Squelch level: 0, 1, 2, 3, 4, 5, 6, 7, 8, 9\n");
+        outbuf_printf(out, "# 11) Guard tone for receive, or '-' to disable\n");
+        outbuf_printf(out, "# 12) Guard tone for transmit, or '-' to disable\n");
+        outbuf_printf(out, "# 13) Bandwidth in kHz: 12.5, 20, 25\n");
+        outbuf_printf(out, "#\n");
+        outbuf_printf(out, "Analog  Name             Receive   Transmit Power Scan TOT RO Admit  Squelch RxTone TxTone Width\n");
         // Rows intentionally omitted until analog mapping is confirmed.
     }
 
@@ -962,20 +1176,21 @@ static void dm32_print_config(radio_device_t *radio, FILE *out, int verbose)
     }
 
     if (nclean) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of channel zones.\n");
-            fprintf(out, "# 1) Zone number: 1-%d\n", DM32_NZONES);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) List of channels: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of channel zones.\n");
+            outbuf_printf(out, "# 1) Zone number: 1-%d\n", DM32_NZONES);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) List of channels: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Zone    Name             Channels\n");
+        outbuf_printf(out, "Zone    Name             Channels\n");
         for (unsigned i=0; i<nclean; ++i) {
             // Zone numbers start at 1, names padded to 16 characters max like examples
-            fprintf(out, "%4u    %-16.16s -\n", i+1, clean[i].name);
+            outbuf_printf(out, "%4u    %-16.16s -\n", i+1, clean[i].name);
         }
     }
+    outbuf_flush(&ob);
 
     // Also write a CSV for offline mapping
     FILE *csv = fopen("dm32_zones.csv", "w");
@@ -1143,7 +1358,6 @@ static void dm32_write_csv(radio_device_t *radio, FILE *csv)
 radio_device_t radio_dm32 = {
     .name = "Baofeng DM-32 (experimental)",
     .download = dm32_download,
-    .upload = dm32_upload,
     .is_compatible = dm32_is_compatible,
     .read_image = dm32_read_image,
     .save_image = dm32_save_image,
@@ -1156,4 +1370,6 @@ radio_device_t radio_dm32 = {
     .update_timestamp = dm32_update_timestamp,
     .write_csv = dm32_write_csv,
     .channel_count = 0,
+    .discover_map = dm32_discover_map,
+    .linktest = dm32_linktest,
 };
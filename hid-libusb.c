@@ -37,9 +37,17 @@ static libusb_device_handle *dev;           // libusb device
 static struct libusb_transfer *transfer;    // async transfer descriptor
 static unsigned char receive_buf[42];       // receive buffer
 static volatile int nbytes_received = 0;    // receive result
+static unsigned char ep_in = 0x81;          // interrupt IN endpoint
+static unsigned char ep_out = 0;            // interrupt OUT endpoint, or 0
+static struct libusb_transfer *out_transfer; // async send descriptor
+static unsigned char send_buf[42];          // send buffer
+static volatile int send_status = 0;        // send result
 
 #define HID_INTERFACE   0                   // interface index
-#define TIMEOUT_MSEC    500                 // receive timeout
+
+// Receive timeout: adapted to round-trip time, but never below 500 msec.
+// A reply after a shorter timeout would be taken for the reply to the retry.
+static rtt_t rtt = RTT_INIT("HID", 500, 500, 2000, 3);
 
 //
 // Callback function for asynchronous receive.
@@ -75,39 +83,95 @@ static void read_callback(struct libusb_transfer *t)
    }
 }
 
+//
+// Callback function for asynchronous send.
+// Set send_status to 1 on success, or negative error code.
+//
+static void write_callback(struct libusb_transfer *t)
+{
+    switch (t->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+        send_status = 1;
+        break;
+    case LIBUSB_TRANSFER_CANCELLED:
+        send_status = LIBUSB_ERROR_INTERRUPTED;
+        break;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        send_status = LIBUSB_ERROR_NO_DEVICE;
+        break;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        send_status = LIBUSB_ERROR_TIMEOUT;
+        break;
+    default:
+        send_status = LIBUSB_ERROR_IO;
+    }
+}
+
+//
+// Send data via interrupt OUT endpoint, when the device has it.
+// Otherwise use HID Set_Report request on the control endpoint.
+// Return negative status on error.
+//
+static int write_data(const unsigned char *data, unsigned length, unsigned timeout_msec)
+{
+    if (! ep_out) {
+        return libusb_control_transfer(dev,
+            LIBUSB_REQUEST_TYPE_CLASS|LIBUSB_RECIPIENT_INTERFACE|LIBUSB_ENDPOINT_OUT,
+            0x09/*HID Set_Report*/, (2/*HID output*/ << 8) | 0,
+            HID_INTERFACE, (unsigned char*)data, length, timeout_msec);
+    }
+
+    if (! out_transfer) {
+        // Allocate transfer descriptor on first invocation.
+        out_transfer = libusb_alloc_transfer(0);
+    }
+    memcpy(send_buf, data, length);
+    libusb_fill_interrupt_transfer(out_transfer, dev, ep_out,
+        send_buf, length, write_callback, 0, timeout_msec);
+    send_status = 0;
+    return libusb_submit_transfer(out_transfer);
+}
+
 //
 // Write data to the device and receive reply.
 // Return negative status on error.
 // Return received byte count of success.
-// On timeout, repeat the transaction.
+// On timeout, repeat the transaction a few times, with growing timeout.
 // Need to use callback for receive interrupt transfer.
 //
 static int write_read(const unsigned char *data, unsigned length, unsigned char *reply, unsigned rlength)
 {
+    unsigned attempt = 0, timeout_msec;
+    unsigned long long start;
+
     if (! transfer) {
         // Allocate transfer descriptor on first invocation.
         transfer = libusb_alloc_transfer(0);
     }
-    libusb_fill_interrupt_transfer(transfer, dev,
-        LIBUSB_RECIPIENT_INTERFACE|LIBUSB_ENDPOINT_IN,
-        reply, rlength, read_callback, 0, TIMEOUT_MSEC);
 again:
+    timeout_msec = rtt_timeout(&rtt, attempt);
+    libusb_fill_interrupt_transfer(transfer, dev, ep_in,
+        reply, rlength, read_callback, 0, timeout_msec);
     nbytes_received = 0;
+    start = now_usec();
     libusb_submit_transfer(transfer);
 
-    int result = libusb_control_transfer(dev,
-        LIBUSB_REQUEST_TYPE_CLASS|LIBUSB_RECIPIENT_INTERFACE|LIBUSB_ENDPOINT_OUT,
-        0x09/*HID Set_Report*/, (2/*HID output*/ << 8) | 0,
-        HID_INTERFACE, (unsigned char*)data, length, TIMEOUT_MSEC);
-
+    int result = write_data(data, length, timeout_msec);
     if (result < 0) {
-        fprintf(stderr, "Error %d transmitting data via control transfer: %s\n",
-            result, libusb_strerror(result));
+        fprintf(stderr, "Error %d transmitting data via %s transfer: %s\n",
+            result, ep_out ? "interrupt" : "control", libusb_strerror(result));
         libusb_cancel_transfer(transfer);
         return -1;
     }
 
-    while (nbytes_received == 0) {
+    // With interrupt OUT, wait for both send and receive to complete.
+    while (nbytes_received == 0 || (ep_out && send_status == 0)) {
+        if (send_status < 0) {
+            fprintf(stderr, "Error %d transmitting data via interrupt transfer: %s\n",
+                send_status, libusb_strerror(send_status));
+            libusb_cancel_transfer(transfer);
+            return -1;
+        }
         result = libusb_handle_events(ctx);
         if (result < 0) {
             /* Break out of this loop only on fatal error.*/
@@ -123,11 +187,16 @@ again:
     }
 
     if (nbytes_received == LIBUSB_ERROR_TIMEOUT) {
-        if (trace_flag > 0) {
+        if (! rtt_retry(&rtt, attempt++)) {
             fprintf(stderr, "No response from HID device!\n");
+            return -1;
         }
         goto again;
     }
+
+    // Only unambiguous replies are measured (Karn's algorithm).
+    if (attempt == 0 && nbytes_received > 0)
+        rtt_sample(&rtt, start);
     return nbytes_received;
 }
 
@@ -191,6 +260,110 @@ void hid_send_recv(const unsigned char *data, unsigned nbytes, unsigned char *rd
     memcpy(rdata, reply+4, rlength);
 }
 
+//
+// Find interrupt endpoints of the HID interface.
+// Without interrupt OUT endpoint, requests are sent via Set_Report.
+//
+static void find_endpoints()
+{
+    struct libusb_config_descriptor *config;
+    const struct libusb_interface_descriptor *intf;
+    int i;
+
+    ep_in = 0x81;
+    ep_out = 0;
+    if (libusb_get_active_config_descriptor(libusb_get_device(dev), &config) < 0)
+        return;
+
+    if (config->bNumInterfaces > HID_INTERFACE &&
+        config->interface[HID_INTERFACE].num_altsetting > 0) {
+        intf = &config->interface[HID_INTERFACE].altsetting[0];
+
+        for (i=0; i<intf->bNumEndpoints; i++) {
+            const struct libusb_endpoint_descriptor *ep = &intf->endpoint[i];
+
+            if ((ep->bmAttributes & 3) != LIBUSB_TRANSFER_TYPE_INTERRUPT)
+                continue;
+            if (ep->bEndpointAddress & LIBUSB_ENDPOINT_IN)
+                ep_in = ep->bEndpointAddress;
+            else
+                ep_out = ep->bEndpointAddress;
+        }
+    }
+    libusb_free_config_descriptor(config);
+
+    if (trace_flag) {
+        fprintf(stderr, "HID endpoints: IN %#x, OUT %s\n",
+            ep_in, ep_out ? "interrupt" : "Set_Report");
+    }
+}
+
+//
+// Get the serial number of the opened device, to identify the radio.
+//
+static void get_serial(libusb_device_handle *handle)
+{
+    struct libusb_device_descriptor desc;
+
+    usb_serial[0] = 0;
+    if (libusb_get_device_descriptor(libusb_get_device(handle), &desc) < 0 ||
+        desc.iSerialNumber == 0 ||
+        libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber,
+            (unsigned char*) usb_serial, sizeof(usb_serial)) < 0)
+        usb_serial[0] = 0;
+}
+
+//
+// Get the location of the device: bus and port numbers,
+// as named in sysfs, like "1-1.4".  Return 0 when not known.
+//
+static int get_location(libusb_device *device, char *name, int size)
+{
+    uint8_t ports[8];
+    int nports, len, k;
+
+    nports = libusb_get_port_numbers(device, ports, sizeof(ports));
+    if (nports <= 0)
+        return 0;
+    len = snprintf(name, size, "%d", libusb_get_bus_number(device));
+    for (k=0; k<nports && len < size; k++)
+        len += snprintf(name + len, size - len, "%c%d", k ? '.' : '-', ports[k]);
+    return 1;
+}
+
+//
+// Open the device with given VID:PID. When usb_location is set,
+// only the device at this location is taken.
+//
+static libusb_device_handle *open_device(int vid, int pid)
+{
+    libusb_device **list, *found = 0;
+    libusb_device_handle *handle = 0;
+    struct libusb_device_descriptor desc;
+    char name[32];
+    ssize_t n, i;
+
+    if (! usb_location)
+        return libusb_open_device_with_vid_pid(ctx, vid, pid);
+
+    n = libusb_get_device_list(ctx, &list);
+    if (n < 0)
+        return 0;
+    for (i=0; i<n; i++) {
+        if (libusb_get_device_descriptor(list[i], &desc) == 0 &&
+            desc.idVendor == vid && desc.idProduct == pid &&
+            get_location(list[i], name, sizeof(name)) &&
+            strcmp(name, usb_location) == 0) {
+            found = list[i];
+            break;
+        }
+    }
+    if (found && libusb_open(found, &handle) < 0)
+        handle = 0;
+    libusb_free_device_list(list, 1);
+    return handle;
+}
+
 //
 // Connect to the specified device.
 // Initiate the programming session.
@@ -204,7 +377,7 @@ int hid_init(int vid, int pid)
         exit(-1);
     }
 
-    dev = libusb_open_device_with_vid_pid(ctx, vid, pid);
+    dev = open_device(vid, pid);
     if (!dev) {
         if (trace_flag) {
             fprintf(stderr, "Cannot find USB device %04x:%04x\n",
@@ -214,6 +387,7 @@ int hid_init(int vid, int pid)
         ctx = 0;
         return -1;
     }
+    get_serial(dev);
     if (libusb_kernel_driver_active(dev, 0)) {
         libusb_detach_kernel_driver(dev, 0);
     }
@@ -227,6 +401,7 @@ int hid_init(int vid, int pid)
         ctx = 0;
         exit(-1);
     }
+    find_endpoints();
     return 0;
 }
 
@@ -235,10 +410,17 @@ void hid_close()
     if (!ctx)
         return;
 
+    if (trace_flag)
+        rtt_print_stats(&rtt);
+    rtt_save(&rtt);
     if (transfer) {
         libusb_free_transfer(transfer);
         transfer = 0;
     }
+    if (out_transfer) {
+        libusb_free_transfer(out_transfer);
+        out_transfer = 0;
+    }
     libusb_release_interface(dev, HID_INTERFACE);
     libusb_close(dev);
     libusb_exit(ctx);
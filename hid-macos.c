@@ -37,6 +37,10 @@ static unsigned char transfer_buf[42];      // device buffer
 static unsigned char receive_buf[42];       // receive buffer
 static volatile int nbytes_received = 0;    // receive result
 
+// Receive timeout: adapted to round-trip time, but never below 100 msec.
+// A reply after a shorter timeout would be taken for the reply to the retry.
+static rtt_t rtt = RTT_INIT("HID", 100, 100, 2000, 3);
+
 //
 // Send a request to the device.
 // Store the reply into the rdata[] array.
@@ -45,7 +49,8 @@ static volatile int nbytes_received = 0;    // receive result
 void hid_send_recv(const unsigned char *data, unsigned nbytes, unsigned char *rdata, unsigned rlength)
 {
     unsigned char buf[42];
-    unsigned k;
+    unsigned k, attempt;
+    unsigned long long start, deadline;
     IOReturn result;
 
     memset(buf, 0, sizeof(buf));
@@ -68,8 +73,11 @@ void hid_send_recv(const unsigned char *data, unsigned nbytes, unsigned char *rd
     }
     nbytes_received = 0;
     memset(receive_buf, 0, sizeof(receive_buf));
+    attempt = 0;
 again:
     // Write to HID device.
+    start = now_usec();
+    deadline = start + rtt_timeout(&rtt, attempt) * 1000ULL;
     result = IOHIDDeviceSetReport(dev, kIOHIDReportTypeOutput, 0, buf, sizeof(buf));
     if (result != kIOReturnSuccess) {
         fprintf(stderr, "HID output error: %d!\n", result);
@@ -78,17 +86,22 @@ again:
 
     // Run main application loop until reply received.
     CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0, 0);
-    for (k = 0; nbytes_received <= 0; k++) {
+    while (nbytes_received <= 0) {
         usleep(100);
         CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0, 0);
-        if (k >= 1000) {
-            if (trace_flag > 0) {
+        if (now_usec() > deadline) {
+            if (! rtt_retry(&rtt, attempt++)) {
                 fprintf(stderr, "No response from HID device!\n");
+                exit(-1);
             }
             goto again;
         }
     }
 
+    // Only unambiguous replies are measured (Karn's algorithm).
+    if (attempt == 0)
+        rtt_sample(&rtt, start);
+
     if (nbytes_received != sizeof(receive_buf)) {
         fprintf(stderr, "Short read: %d bytes instead of %d!\n",
             nbytes_received, (int)sizeof(receive_buf));
@@ -228,6 +241,9 @@ void hid_close()
     if (!dev)
         return;
 
+    if (trace_flag)
+        rtt_print_stats(&rtt);
+    rtt_save(&rtt);
     IOHIDDeviceClose(dev, kIOHIDOptionsTypeNone);
     dev = 0;
 }
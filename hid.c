@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "radio.h"
 #include "util.h"
 
 static const unsigned char CMD_PRG[]   = "\2PROGRA";
@@ -78,14 +79,19 @@ const char *hid_identify()
     return (char*)reply;
 }
 
-void hid_read_block(int bno, unsigned char *data, int nbytes)
+//
+// Switch to the memory bank, which contains the given address.
+//
+static void select_bank(unsigned addr)
 {
-    unsigned addr = bno * nbytes;
-    unsigned char ack, cmd[4], reply[32+4];
-    int n;
+    unsigned char ack;
 
     if (addr < 0x10000 && offset != 0) {
         offset = 0;
+        if (plan_flag) {
+            plan_account("HID bank", 1, 1, 0);
+            return;
+        }
         hid_send_recv(CMD_CWB0, 8, &ack, 1);
         if (ack != CMD_ACK[0]) {
             fprintf(stderr, "%s: Wrong acknowledge %#x, expected %#x\n",
@@ -94,6 +100,10 @@ void hid_read_block(int bno, unsigned char *data, int nbytes)
         }
     } else if (addr >= 0x10000 && offset == 0) {
         offset = 0x00010000;
+        if (plan_flag) {
+            plan_account("HID bank", 1, 1, 0);
+            return;
+        }
         hid_send_recv(CMD_CWB1, 8, &ack, 1);
         if (ack != CMD_ACK[0]) {
             fprintf(stderr, "%s: Wrong acknowledge %#x, expected %#x\n",
@@ -101,6 +111,20 @@ void hid_read_block(int bno, unsigned char *data, int nbytes)
             exit(-1);
         }
     }
+}
+
+void hid_read_block(int bno, unsigned char *data, int nbytes)
+{
+    unsigned addr = bno * nbytes;
+    unsigned char cmd[4], reply[32+4];
+    int n;
+
+    select_bank(addr);
+    if (plan_flag) {
+        // The data stay intact.
+        plan_account("HID read", nbytes / 32, nbytes / 32, nbytes);
+        return;
+    }
 
     for (n=0; n<nbytes; n+=32) {
         cmd[0] = CMD_READ[0];
@@ -112,28 +136,20 @@ void hid_read_block(int bno, unsigned char *data, int nbytes)
     }
 }
 
-void hid_write_block(int bno, unsigned char *data, int nbytes)
+//
+// Write nbytes at given address, in chunks of 32 bytes.
+// Both address and size must be multiples of 32,
+// and the span must not cross the bank boundary.
+//
+static void write_span(unsigned addr, unsigned char *data, unsigned nbytes)
 {
-    unsigned addr = bno * nbytes;
     unsigned char ack, cmd[4+32];
-    int n;
+    unsigned n;
 
-    if (addr < 0x10000 && offset != 0) {
-        offset = 0;
-        hid_send_recv(CMD_CWB0, 8, &ack, 1);
-        if (ack != CMD_ACK[0]) {
-            fprintf(stderr, "%s: Wrong acknowledge %#x, expected %#x\n",
-                __func__, ack, CMD_ACK[0]);
-            exit(-1);
-        }
-    } else if (addr >= 0x10000 && offset == 0) {
-        offset = 0x00010000;
-        hid_send_recv(CMD_CWB1, 8, &ack, 1);
-        if (ack != CMD_ACK[0]) {
-            fprintf(stderr, "%s: Wrong acknowledge %#x, expected %#x\n",
-                __func__, ack, CMD_ACK[0]);
-            exit(-1);
-        }
+    select_bank(addr);
+    if (plan_flag) {
+        plan_account("HID write", nbytes / 32, nbytes / 32, nbytes);
+        return;
     }
 
     for (n=0; n<nbytes; n+=32) {
@@ -151,10 +167,84 @@ void hid_write_block(int bno, unsigned char *data, int nbytes)
     }
 }
 
+void hid_write_block(int bno, unsigned char *data, int nbytes)
+{
+    write_span(bno * nbytes, data, nbytes);
+}
+
+//
+// Write a list of address ranges from the memory image.
+// Ranges in the current bank go first, then the other bank,
+// so at most one bank switch is needed.
+// Print '#' for every 4 kbytes written.
+//
+void hid_write_ranges(const range_t *tab, int ntab, unsigned char *mem)
+{
+    unsigned bank = offset, nwritten = 0, done = 0, total = 0;
+    int pass, i;
+
+    for (i=0; i<ntab; i++)
+        total += tab[i].end - tab[i].start;
+
+    for (pass=0; pass<2; pass++) {
+        unsigned lo = bank ? 0x10000 : 0;
+        unsigned hi = bank ? ~0u : 0x10000;
+
+        for (i=0; i<ntab; i++) {
+            unsigned start = (tab[i].start > lo) ? tab[i].start : lo;
+            unsigned end = (tab[i].end < hi) ? tab[i].end : hi;
+            unsigned n;
+
+            for (; start < end; start += n) {
+                // Split at 4 kbytes, for progress report.
+                n = 4096 - start % 4096;
+                if (n > end - start)
+                    n = end - start;
+                radio_mem_wait(start + n);
+                write_span(start, &mem[start], n);
+                done += n;
+                progress_update(done, total);
+
+                nwritten += n;
+                if (nwritten >= 4096) {
+                    nwritten -= 4096;
+                    fprintf(stderr, "#");
+                    fflush(stderr);
+                }
+            }
+        }
+        bank ^= 0x10000;
+    }
+}
+
+//
+// Read callback for the link test.
+//
+static int link_read(unsigned addr, unsigned char *data, const link_param_t *param)
+{
+    hid_read_block(addr / param->size, data, param->size);
+    return 0;
+}
+
+//
+// Benchmark the link with reads of a span of memory.
+// The protocol has 32-byte reads, one request in flight.
+//
+void hid_linktest(unsigned addr, unsigned span)
+{
+    static const link_param_t tab[] = { { 32, 1 } };
+
+    linktest_run("HID", link_read, tab, 1, addr, span);
+}
+
 void hid_read_finish()
 {
     unsigned char ack;
 
+    if (plan_flag) {
+        plan_account("HID command", 1, 1, 0);
+        return;
+    }
     hid_send_recv(CMD_ENDR, 4, &ack, 1);
     if (ack != CMD_ACK[0]) {
         fprintf(stderr, "%s: Wrong acknowledge %#x, expected %#x\n",
@@ -166,6 +256,10 @@ void hid_write_finish()
 {
     unsigned char ack;
 
+    if (plan_flag) {
+        plan_account("HID command", 1, 1, 0);
+        return;
+    }
     hid_send_recv(CMD_ENDW, 4, &ack, 1);
     if (ack != CMD_ACK[0]) {
         fprintf(stderr, "%s: Wrong acknowledge %#x, expected %#x\n",
@@ -0,0 +1,797 @@
+/*
+ * Inverted index over archived codeplug images.
+ *
+ * Copyright (C) 2018 Serge Vakulenko, KK6ABQ
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. The name of the author may not be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// The index is a text file:
+//
+//      DMRCONFIG-INDEX 1 <number of images>
+//      I <tab> <mtime> <tab> <size> <tab> <path>       -- one per image
+//      <key> <tab> <image number> <tab> <record>       -- postings
+//
+// Postings are sorted by key, so a query is a binary search
+// over the file, without loading it.  Keys are:
+//
+//      id:<dmr id>             -- contacts, grouplists, digital channels
+//      freq:<hz>               -- receive or transmit frequency of a channel
+//      chan:<name>             -- channel name, lower case
+//      zone:<name>             -- zone name, lower case
+//
+// Images are decoded by the driver's print_config routine,
+// so every supported radio is indexed the same way.
+// On update, images with unchanged size and modification time
+// keep their postings and are not decoded again.  Images of the
+// old index need not be listed again: they stay in the index
+// until the file is removed.
+//
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#ifndef MINGW32
+#   include <sys/wait.h>
+#endif
+#include "radio.h"
+#include "util.h"
+
+#define INDEX_MAGIC     "DMRCONFIG-INDEX 1"
+
+//
+// Indexed image.
+//
+typedef struct {
+    char *path;
+    long long mtime;
+    long long size;
+    int pid;                    // Worker process, or 0
+    FILE *conf;                 // Decoded configuration
+    int old;                    // Image number in the old index, or -1
+    int ok;                     // Decoded successfully
+} image_t;
+
+//
+// Posting: key and record, stored as "key\0record".
+//
+typedef struct {
+    char *text;
+    int image;
+} posting_t;
+
+static image_t *images;
+static int nimages;
+static posting_t *postings;
+static int npostings, maxpostings;
+
+//
+// Add posting to the table.
+//
+static void add_posting(const char *key, int image, const char *record)
+{
+    int klen = strlen(key);
+
+    if (npostings >= maxpostings) {
+        maxpostings = maxpostings ? maxpostings * 2 : 4096;
+        postings = realloc(postings, maxpostings * sizeof(posting_t));
+        if (! postings) {
+            fprintf(stderr, "Out of memory!\n");
+            exit(-1);
+        }
+    }
+    postings[npostings].text = malloc(klen + strlen(record) + 2);
+    strcpy(postings[npostings].text, key);
+    strcpy(postings[npostings].text + klen + 1, record);
+    postings[npostings].image = image;
+    npostings++;
+}
+
+//
+// Compare postings by key, then by image, for qsort().
+//
+static int compare_postings(const void *pa, const void *pb)
+{
+    const posting_t *a = pa, *b = pb;
+    int c = strcmp(a->text, b->text);
+
+    if (c != 0)
+        return c;
+    if (a->image != b->image)
+        return a->image - b->image;
+    return strcmp(a->text + strlen(a->text) + 1, b->text + strlen(b->text) + 1);
+}
+
+//
+// Compare images by path, for qsort().
+//
+static int compare_images(const void *pa, const void *pb)
+{
+    const image_t *a = pa, *b = pb;
+
+    return strcmp(a->path, b->path);
+}
+
+//
+// Find image by path among the first n images, sorted by path.
+// Return the image number, or -1 when not found.
+//
+static int find_image(const char *path, int n)
+{
+    image_t key, *im;
+
+    key.path = (char*) path;
+    im = bsearch(&key, images, n, sizeof(image_t), compare_images);
+    return im ? im - images : -1;
+}
+
+//
+// Append one image file to the list.
+//
+static void add_image_file(const char *path, struct stat *st)
+{
+    images = realloc(images, (nimages + 1) * sizeof(image_t));
+    if (! images) {
+        fprintf(stderr, "Out of memory!\n");
+        exit(-1);
+    }
+    memset(&images[nimages], 0, sizeof(image_t));
+    images[nimages].path = strdup(path);
+    images[nimages].mtime = st->st_mtime;
+    images[nimages].size = st->st_size;
+    images[nimages].old = -1;
+    nimages++;
+}
+
+//
+// Append image file names to the list.
+// Directories are scanned for *.img files.
+//
+static void add_images(const char *name)
+{
+    DIR *dir;
+    struct dirent *ent;
+    struct stat st;
+
+    dir = opendir(name);
+    if (! dir) {
+        if (stat(name, &st) < 0) {
+            perror(name);
+            return;
+        }
+        add_image_file(name, &st);
+        return;
+    }
+    while ((ent = readdir(dir)) != 0) {
+        int len = strlen(ent->d_name);
+
+        if (ent->d_name[0] == '.')
+            continue;
+
+        char *path = malloc(strlen(name) + len + 2);
+        sprintf(path, "%s/%s", name, ent->d_name);
+        if (stat(path, &st) == 0 && (S_ISDIR(st.st_mode) ||
+            (len > 4 && strcmp(ent->d_name + len - 4, ".img") == 0)))
+            add_images(path);
+        free(path);
+    }
+    closedir(dir);
+}
+
+//
+// Make a key from prefix and name: lower case, spaces replaced by '_'.
+//
+static void make_key(char *key, int size, const char *prefix, const char *name)
+{
+    int n = snprintf(key, size, "%s", prefix);
+
+    for (; *name && n < size-1; name++)
+        key[n++] = (*name == ' ') ? '_' : tolower((unsigned char) *name);
+    key[n] = 0;
+}
+
+//
+// Add posting for a frequency in MHz.
+//
+static void add_frequency(double mhz, int image, const char *record)
+{
+    char key[64];
+
+    if (mhz <= 0)
+        return;
+    snprintf(key, sizeof(key), "freq:%lld", (long long) (mhz * 1000000 + 0.5));
+    add_posting(key, image, record);
+}
+
+//
+// Add posting for a contact number, resolved to DMR ID.
+//
+static void add_contact(int cnum, char **ids, int nids, int image, const char *record)
+{
+    char key[64];
+
+    if (cnum <= 0 || cnum >= nids || ! ids[cnum])
+        return;
+    snprintf(key, sizeof(key), "id:%s", ids[cnum]);
+    add_posting(key, image, record);
+}
+
+//
+// Table being parsed from the decoded configuration.
+//
+enum {
+    TAB_NONE, TAB_DIGITAL, TAB_ANALOG, TAB_ZONE, TAB_CONTACT, TAB_GROUPLIST,
+};
+
+//
+// Get table id from the header line.
+//
+static int table_id(const char *line)
+{
+    if (strncmp(line, "Digital ", 8) == 0)
+        return TAB_DIGITAL;
+    if (strncmp(line, "Analog ", 7) == 0)
+        return TAB_ANALOG;
+    if (strncmp(line, "Zone ", 5) == 0)
+        return TAB_ZONE;
+    if (strncmp(line, "Contact ", 8) == 0)
+        return TAB_CONTACT;
+    if (strncmp(line, "Grouplist ", 10) == 0)
+        return TAB_GROUPLIST;
+    return TAB_NONE;
+}
+
+//
+// Split the line into whitespace separated words.
+// Comment after '#' is dropped.
+// Return the number of words.
+//
+static int split_words(char *line, char **word, int maxwords)
+{
+    int n = 0;
+    char *p = strchr(line, '#');
+
+    if (p)
+        *p = 0;
+    for (p=strtok(line, " \t\r\n"); p && n<maxwords; p=strtok(0, " \t\r\n"))
+        word[n++] = p;
+    return n;
+}
+
+//
+// Extract postings from the decoded configuration of the image.
+// Contacts are collected in the first pass, to resolve
+// contact numbers of grouplists and channels into DMR IDs.
+//
+static void index_config(FILE *conf, int image)
+{
+    char line[1024], *word[32], record[64], key[256];
+    char **ids = 0;
+    int nids = 0, table, n;
+
+    // Pass 1: contact numbers to IDs.
+    rewind(conf);
+    table = TAB_NONE;
+    while (fgets(line, sizeof(line), conf)) {
+        if (isalpha((unsigned char) line[0])) {
+            table = table_id(line);
+            continue;
+        }
+        if (table != TAB_CONTACT)
+            continue;
+        n = split_words(line, word, 32);
+        if (n < 4)
+            continue;
+
+        int cnum = atoi(word[0]);
+        if (cnum <= 0)
+            continue;
+        if (cnum >= nids) {
+            ids = realloc(ids, (cnum + 256) * sizeof(char*));
+            memset(ids + nids, 0, (cnum + 256 - nids) * sizeof(char*));
+            nids = cnum + 256;
+        }
+        free(ids[cnum]);
+        ids[cnum] = strdup(word[3]);
+    }
+
+    // Pass 2: all postings.
+    rewind(conf);
+    table = TAB_NONE;
+    while (fgets(line, sizeof(line), conf)) {
+        if (isalpha((unsigned char) line[0])) {
+            table = table_id(line);
+            continue;
+        }
+        if (table == TAB_NONE)
+            continue;
+        n = split_words(line, word, 32);
+        if (n < 2 || ! isdigit((unsigned char) word[0][0]))
+            continue;
+
+        switch (table) {
+        case TAB_DIGITAL:
+        case TAB_ANALOG: {
+            double rx, tx;
+
+            snprintf(record, sizeof(record), "%s %s",
+                table == TAB_DIGITAL ? "Digital" : "Analog", word[0]);
+            make_key(key, sizeof(key), "chan:", word[1]);
+            add_posting(key, image, record);
+            if (n < 4)
+                break;
+            rx = strtod(word[2], 0);
+            if (word[3][0] == '+' || word[3][0] == '-')
+                tx = rx + strtod(word[3], 0);
+            else if (word[3][0] == '=')
+                tx = rx;
+            else
+                tx = strtod(word[3], 0);
+            add_frequency(rx, image, record);
+            if ((long long) (tx * 1000000 + 0.5) != (long long) (rx * 1000000 + 0.5))
+                add_frequency(tx, image, record);
+            if (table == TAB_DIGITAL && n >= 13)
+                add_contact(atoi(word[12]), ids, nids, image, record);
+            break;
+        }
+        case TAB_ZONE:
+            if (strcmp(word[1], "-") == 0)
+                break;
+            snprintf(record, sizeof(record), "Zone %s", word[0]);
+            make_key(key, sizeof(key), "zone:", word[1]);
+            add_posting(key, image, record);
+            break;
+
+        case TAB_CONTACT:
+            if (n < 4)
+                break;
+            snprintf(record, sizeof(record), "Contact %s", word[0]);
+            snprintf(key, sizeof(key), "id:%s", word[3]);
+            add_posting(key, image, record);
+            break;
+
+        case TAB_GROUPLIST: {
+            char *p;
+
+            if (n < 3)
+                break;
+            snprintf(record, sizeof(record), "Grouplist %s", word[0]);
+            for (p=strtok(word[2], ","); p; p=strtok(0, ",")) {
+                int first = atoi(p), last = first, c;
+                char *dash = strchr(p, '-');
+
+                if (dash)
+                    last = atoi(dash + 1);
+                for (c=first; c<=last && c<nids; c++)
+                    add_contact(c, ids, nids, image, record);
+            }
+            break;
+        }
+        }
+    }
+
+    while (nids > 0)
+        free(ids[--nids]);
+    free(ids);
+}
+
+//
+// Load postings of unchanged images from the old index.
+// Images of the old index, which are not in the new list,
+// are kept as well: dropped when the file no longer exists,
+// and decoded again when its size or time has changed.
+// Return 0 when there is no valid index.
+//
+static int load_index(const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    char line[1024], **paths;
+    long long *mtimes, *sizes;
+    int nold, i, k, *remap;
+
+    if (! f)
+        return 0;
+    if (! fgets(line, sizeof(line), f) ||
+        strncmp(line, INDEX_MAGIC " ", sizeof(INDEX_MAGIC)) != 0) {
+        fprintf(stderr, "%s: Not an index file.\n", filename);
+        exit(-1);
+    }
+    nold = atoi(line + sizeof(INDEX_MAGIC));
+    paths = calloc(nold + 1, sizeof(char*));
+    mtimes = calloc(nold + 1, sizeof(long long));
+    sizes = calloc(nold + 1, sizeof(long long));
+    remap = calloc(nold + 1, sizeof(int));
+    for (i=0; i<nold; i++) {
+        char *p, *q;
+
+        if (! fgets(line, sizeof(line), f) || line[0] != 'I' || line[1] != '\t')
+            goto bad;
+        line[strcspn(line, "\r\n")] = 0;
+        mtimes[i] = strtoll(line + 2, &p, 10);
+        sizes[i] = strtoll(p + 1, &q, 10);
+        paths[i] = strdup(q + 1);
+    }
+
+    // Add old images, which still exist, to the new list.
+    int nlisted = nimages;
+    for (i=0; i<nold; i++) {
+        struct stat st;
+
+        if (find_image(paths[i], nlisted) < 0 && stat(paths[i], &st) == 0)
+            add_image_file(paths[i], &st);
+    }
+    if (nimages > nlisted)
+        qsort(images, nimages, sizeof(image_t), compare_images);
+
+    // Match old images with the new list.
+    for (i=0; i<nold; i++) {
+        remap[i] = -1;
+        k = find_image(paths[i], nimages);
+        if (k >= 0 && images[k].old < 0 &&
+            images[k].mtime == mtimes[i] && images[k].size == sizes[i]) {
+            images[k].old = i;
+            images[k].ok = 1;
+            remap[i] = k;
+        }
+    }
+
+    // Keep postings of unchanged images.
+    while (fgets(line, sizeof(line), f)) {
+        char *tab1 = strchr(line, '\t'), *tab2;
+
+        if (! tab1 || ! (tab2 = strchr(tab1 + 1, '\t')))
+            goto bad;
+        *tab1 = 0;
+        *tab2 = 0;
+        i = atoi(tab1 + 1);
+        if (i < 0 || i >= nold || remap[i] < 0)
+            continue;
+        tab2[1 + strcspn(tab2 + 1, "\r\n")] = 0;
+        add_posting(line, remap[i], tab2 + 1);
+    }
+    fclose(f);
+    for (i=0; i<nold; i++)
+        free(paths[i]);
+    free(paths);
+    free(mtimes);
+    free(sizes);
+    free(remap);
+    return 1;
+bad:
+    fprintf(stderr, "%s: Corrupted index file.\n", filename);
+    exit(-1);
+}
+
+//
+// Decode the image and print configuration to a file.
+//
+static void decode_image(image_t *im)
+{
+    radio_read_image(im->path);
+    radio_print_config(im->conf, 0);
+    fflush(im->conf);
+}
+
+//
+// Decode all changed images, every one by a separate worker process,
+// up to one worker per processor core.
+//
+static void decode_images(void)
+{
+    int i;
+
+#ifdef MINGW32
+    // No fork(): decode one by one. Errors terminate the program.
+    for (i=0; i<nimages; i++) {
+        if (images[i].old >= 0)
+            continue;
+        images[i].conf = tmpfile();
+        decode_image(&images[i]);
+        images[i].ok = 1;
+    }
+#else
+    int nworkers = parallel_nchunks(nimages, 1), nrunning = 0, next = 0;
+
+    fflush(stdout);
+    fflush(stderr);
+    for (;;) {
+        // Start workers.
+        while (next < nimages && nrunning < nworkers) {
+            image_t *im = &images[next++];
+
+            if (im->old >= 0)
+                continue;
+            im->conf = tmpfile();
+            if (! im->conf) {
+                perror("tmpfile");
+                exit(-1);
+            }
+            im->pid = fork();
+            if (im->pid < 0) {
+                perror("fork");
+                exit(-1);
+            }
+            if (im->pid == 0) {
+                // Worker: decode quietly.
+                int null = open("/dev/null", O_WRONLY);
+
+                if (null < 0 || dup2(null, 1) < 0 || dup2(null, 2) < 0)
+                    _exit(-1);
+                decode_image(im);
+                _exit(0);
+            }
+            nrunning++;
+        }
+        if (nrunning == 0)
+            break;
+
+        // Wait for any worker to finish.
+        int status, pid = wait(&status);
+        if (pid < 0) {
+            perror("wait");
+            exit(-1);
+        }
+        for (i=0; i<nimages; i++) {
+            if (images[i].pid == pid) {
+                images[i].ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                images[i].pid = 0;
+                nrunning--;
+                break;
+            }
+        }
+    }
+#endif
+}
+
+//
+// Write the index to a temporary file, then replace the old one.
+//
+static void save_index(const char *filename)
+{
+    char *tmpname = malloc(strlen(filename) + 8);
+    FILE *f;
+    int i, nok = 0, *number;
+
+    sprintf(tmpname, "%s.tmp", filename);
+    f = fopen(tmpname, "wb");
+    if (! f) {
+        perror(tmpname);
+        exit(-1);
+    }
+    setvbuf(f, 0, _IOFBF, 64*1024);
+
+    // Failed images are not listed, so they are retried next time.
+    number = calloc(nimages + 1, sizeof(int));
+    for (i=0; i<nimages; i++) {
+        number[i] = images[i].ok ? nok++ : -1;
+    }
+    fprintf(f, "%s %d\n", INDEX_MAGIC, nok);
+    for (i=0; i<nimages; i++) {
+        if (images[i].ok)
+            fprintf(f, "I\t%lld\t%lld\t%s\n", images[i].mtime, images[i].size, images[i].path);
+    }
+    for (i=0; i<npostings; i++) {
+        posting_t *p = &postings[i];
+
+        if (number[p->image] < 0)
+            continue;
+        fprintf(f, "%s\t%d\t%s\n", p->text, number[p->image], p->text + strlen(p->text) + 1);
+    }
+    if (fclose(f) != 0 || rename(tmpname, filename) < 0) {
+        perror(filename);
+        unlink(tmpname);
+        exit(-1);
+    }
+    free(number);
+    free(tmpname);
+}
+
+//
+// Build or update the index over a list of images or directories.
+// Return the number of images, which could not be decoded.
+//
+int radio_index_images(const char *filename, int nnames, char **names)
+{
+    unsigned long long start = now_usec();
+    int nfailed = 0, nupdated = 0, i;
+
+    for (i=0; i<nnames; i++)
+        add_images(names[i]);
+    qsort(images, nimages, sizeof(image_t), compare_images);
+
+    load_index(filename);
+    decode_images();
+
+    for (i=0; i<nimages; i++) {
+        if (images[i].old >= 0)
+            continue;
+        if (! images[i].ok) {
+            printf("FAIL %s\n", images[i].path);
+            nfailed++;
+        } else {
+            index_config(images[i].conf, i);
+            nupdated++;
+        }
+        if (images[i].conf)
+            fclose(images[i].conf);
+    }
+    qsort(postings, npostings, sizeof(posting_t), compare_postings);
+    save_index(filename);
+
+    unsigned usec = now_usec() - start;
+    printf("Indexed %d images: %d updated, %d unchanged, %d failed, %d postings, %u.%03u sec total.\n",
+        nimages - nfailed, nupdated, nimages - nupdated - nfailed, nfailed,
+        npostings, usec / 1000000, usec / 1000 % 1000);
+    return nfailed;
+}
+
+//
+// Read the line at the given offset, and get the key length.
+// Return 0 at end of file.
+//
+static int read_posting(FILE *f, long pos, char *line, int size, int *keylen)
+{
+    fseek(f, pos, SEEK_SET);
+    if (! fgets(line, size, f))
+        return 0;
+    *keylen = strcspn(line, "\t");
+    return 1;
+}
+
+//
+// Compare the key of the posting line with the given key.
+//
+static int compare_key(const char *line, int keylen, const char *key)
+{
+    int len = strlen(key);
+    int c = strncmp(line, key, keylen < len ? keylen : len);
+
+    if (c != 0)
+        return c;
+    return keylen - len;
+}
+
+//
+// Print all postings of the given key.
+// Return the number of postings found.
+//
+static int query_key(FILE *f, long first, long last, char **paths, int npaths, const char *key)
+{
+    char line[1024];
+    long lo = first, hi = last, pos;
+    int keylen, len, nfound = 0;
+
+    // Binary search for the first line with key >= the given key.
+    // Invariant: lo and hi are line starts.
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        int c;
+
+        // Find the start of the line after mid.
+        pos = lo;
+        if (mid > lo) {
+            fseek(f, mid - 1, SEEK_SET);
+            for (c=getc(f); c != EOF && c != '\n'; c=getc(f))
+                continue;
+            pos = ftell(f);
+            if (c == EOF || pos >= hi)
+                pos = lo;
+        }
+        if (! read_posting(f, pos, line, sizeof(line), &keylen))
+            break;
+        if (compare_key(line, keylen, key) < 0)
+            lo = pos + strlen(line);
+        else
+            hi = pos;
+    }
+
+    // Print matching lines.
+    for (pos=lo; read_posting(f, pos, line, sizeof(line), &keylen); pos += len) {
+        char *tab;
+        int image;
+
+        len = strlen(line);
+        if (compare_key(line, keylen, key) != 0)
+            break;
+        image = atoi(line + keylen + 1);
+        tab = strchr(line + keylen + 1, '\t');
+        if (! tab || image < 0 || image >= npaths)
+            continue;
+        tab[1 + strcspn(tab + 1, "\r\n")] = 0;
+        line[keylen] = 0;
+        printf("%s\t%s\t%s\n", paths[image], tab + 1, line);
+        nfound++;
+    }
+    return nfound;
+}
+
+//
+// Query the index.  Key is either prefixed (id:, freq:, chan:, zone:),
+// or its kind is guessed: integer is DMR ID, decimal number
+// is frequency in MHz, anything else is channel or zone name.
+// Return the number of postings found.
+//
+int radio_query_index(const char *filename, const char *query)
+{
+    FILE *f = fopen(filename, "rb");
+    char line[1024], key[256], **paths;
+    long first, last;
+    int npaths, nfound = 0, i;
+
+    if (! f) {
+        perror(filename);
+        exit(-1);
+    }
+    if (! fgets(line, sizeof(line), f) ||
+        strncmp(line, INDEX_MAGIC " ", sizeof(INDEX_MAGIC)) != 0) {
+        fprintf(stderr, "%s: Not an index file.\n", filename);
+        exit(-1);
+    }
+    npaths = atoi(line + sizeof(INDEX_MAGIC));
+    paths = calloc(npaths + 1, sizeof(char*));
+    for (i=0; i<npaths; i++) {
+        char *p;
+
+        if (! fgets(line, sizeof(line), f) || line[0] != 'I') {
+            fprintf(stderr, "%s: Corrupted index file.\n", filename);
+            exit(-1);
+        }
+        line[strcspn(line, "\r\n")] = 0;
+        p = strrchr(line, '\t');
+        paths[i] = strdup(p ? p + 1 : "");
+    }
+    first = ftell(f);
+    fseek(f, 0, SEEK_END);
+    last = ftell(f);
+
+    if (strncmp(query, "id:", 3) == 0 || strncmp(query, "freq:", 5) == 0) {
+        nfound = query_key(f, first, last, paths, npaths, query);
+    } else if (strncmp(query, "chan:", 5) == 0) {
+        make_key(key, sizeof(key), "chan:", query + 5);
+        nfound = query_key(f, first, last, paths, npaths, key);
+    } else if (strncmp(query, "zone:", 5) == 0) {
+        make_key(key, sizeof(key), "zone:", query + 5);
+        nfound = query_key(f, first, last, paths, npaths, key);
+    } else if (query[0] && strspn(query, "0123456789") == strlen(query)) {
+        snprintf(key, sizeof(key), "id:%s", query);
+        nfound = query_key(f, first, last, paths, npaths, key);
+    } else if (query[0] && strspn(query, "0123456789.") == strlen(query)) {
+        snprintf(key, sizeof(key), "freq:%lld", (long long) (strtod(query, 0) * 1000000 + 0.5));
+        nfound = query_key(f, first, last, paths, npaths, key);
+    } else {
+        make_key(key, sizeof(key), "chan:", query);
+        nfound = query_key(f, first, last, paths, npaths, key);
+        make_key(key, sizeof(key), "zone:", query);
+        nfound += query_key(f, first, last, paths, npaths, key);
+    }
+    fclose(f);
+    for (i=0; i<npaths; i++)
+        free(paths[i]);
+    free(paths);
+    return nfound;
+}
@@ -27,6 +27,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "radio.h"
 #include "util.h"
@@ -39,6 +40,18 @@ extern int optind;
 
 int trace_flag = 0;
 
+//
+// Configuration is written to a temporary file, and renamed
+// into place only when the download succeeds.
+//
+static const char *conf_tmpname;
+
+static void remove_conf_tmpname()
+{
+    if (conf_tmpname)
+        unlink(conf_tmpname);
+}
+
 void usage()
 {
     fprintf(stderr, "DMR Config, Version %s, %s\n", version, copyright);
@@ -52,6 +65,8 @@ void usage()
     fprintf(stderr, "                         Verify configuration script for the radio.\n");
     fprintf(stderr, "    dmrconfig -z file.conf\n");
     fprintf(stderr, "                         Read (validate) a configuration file.\n");
+    fprintf(stderr, "    dmrconfig -z file.conf... | directory...\n");
+    fprintf(stderr, "                         Validate many configuration files in parallel.\n");
     fprintf(stderr, "    dmrconfig -c [-t] file.conf\n");
     fprintf(stderr, "                         Apply configuration script to the radio.\n");
     fprintf(stderr, "    dmrconfig -c file.img file.conf\n");
@@ -59,30 +74,84 @@ void usage()
     fprintf(stderr, "                         Store modified copy to a file 'device.img'.\n");
     fprintf(stderr, "    dmrconfig file.img\n");
     fprintf(stderr, "                         Display configuration from the codeplug image.\n");
+    fprintf(stderr, "    dmrconfig -s file.img file.conf fleet.csv\n");
+    fprintf(stderr, "                         Apply configuration script to the codeplug image once,\n");
+    fprintf(stderr, "                         then stamp ID, name and intro lines for every radio\n");
+    fprintf(stderr, "                         from the CSV list: serial,id,name[,intro1[,intro2]].\n");
+    fprintf(stderr, "                         Store files 'serial.img' and 'serial.ranges'.\n");
+    fprintf(stderr, "    dmrconfig -i index.db file.img... | directory...\n");
+    fprintf(stderr, "                         Build or update the index of archived codeplug images.\n");
+    fprintf(stderr, "    dmrconfig -q index.db key...\n");
+    fprintf(stderr, "                         Find images by DMR ID, frequency in MHz, channel or zone name.\n");
+    fprintf(stderr, "                         Prefix id:, freq:, chan: or zone: selects the kind of key.\n");
     fprintf(stderr, "    dmrconfig -u [-t] file.csv\n");
     fprintf(stderr, "                         Update contacts database from CSV file.\n");
+    fprintf(stderr, "    dmrconfig -c -u [-t] file.conf file.csv\n");
+    fprintf(stderr, "    dmrconfig -w -u [-t] file.img file.csv\n");
+    fprintf(stderr, "    dmrconfig -v -u [-t] file.conf file.csv\n");
+    fprintf(stderr, "                         Configure, write or verify the radio, then update\n");
+    fprintf(stderr, "                         contacts database, in one session with the radio.\n");
+    fprintf(stderr, "    dmrconfig -d old.csv new.csv\n");
+    fprintf(stderr, "                         Compare two versions of contacts database: print\n");
+    fprintf(stderr, "                         added, removed and modified IDs. Either file can be\n");
+    fprintf(stderr, "                         a snapshot *.ids, saved in ~/.cache/dmrconfig by -u.\n");
+    fprintf(stderr, "    dmrconfig -x [-t] file.csv\n");
+    fprintf(stderr, "                         Export contacts database from the radio to CSV file.\n");
+    fprintf(stderr, "    dmrconfig -n -r|-w|-c|-u [-t] file.img [file.conf] [file.csv]\n");
+    fprintf(stderr, "                         Dry run: count transactions of a download, upload\n");
+    fprintf(stderr, "                         or contacts update, and estimate the time, without\n");
+    fprintf(stderr, "                         the radio. Image stands for the contents of the radio.\n");
+    fprintf(stderr, "    dmrconfig -m [-t] file.h\n");
+    fprintf(stderr, "                         Probe memory of the radio, and write the map of live\n");
+    fprintf(stderr, "                         ranges (DM-32 only), in the format of dm32-map.h.\n");
+    fprintf(stderr, "    dmrconfig -b [-t]\n");
+    fprintf(stderr, "                         Benchmark the link to the radio with harmless reads:\n");
+    fprintf(stderr, "                         latency, throughput, errors and retries. The best\n");
+    fprintf(stderr, "                         transfer parameters are saved for later sessions.\n");
+    fprintf(stderr, "    dmrconfig -k [-t] [unit]\n");
+    fprintf(stderr, "                         Clone the codeplug from one radio to another radio\n");
+    fprintf(stderr, "                         of the same model: both are attached, and the write\n");
+    fprintf(stderr, "                         goes along with the read. Source is the radio with\n");
+    fprintf(stderr, "                         the lower USB location (unit 0), or the other one (unit 1).\n");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "    -r           Read codeplug from the radio.\n");
     fprintf(stderr, "    -w           Write codeplug to the radio.\n");
     fprintf(stderr, "    -c           Configure the radio from a text script.\n");
     fprintf(stderr, "    -v           Verify config file.\n");
     fprintf(stderr, "    -z           Validate config file.\n");
+    fprintf(stderr, "    -s           Stamp per-radio images from a base config.\n");
+    fprintf(stderr, "    -i           Index codeplug images.\n");
+    fprintf(stderr, "    -q           Query the index.\n");
     fprintf(stderr, "    -u           Update contacts database.\n");
+    fprintf(stderr, "    -x           Export contacts database.\n");
+    fprintf(stderr, "    -d           Compare contacts databases.\n");
+    fprintf(stderr, "    -m           Discover memory map of the radio.\n");
+    fprintf(stderr, "    -b           Benchmark the link to the radio.\n");
+    fprintf(stderr, "    -k           Clone one radio to another.\n");
     fprintf(stderr, "    -l           List all supported radios.\n");
+    fprintf(stderr, "    -n           Plan the transfer: dry run without the radio.\n");
     fprintf(stderr, "    -t           Trace USB protocol.\n");
+    fprintf(stderr, "    -p fd        Write progress events to file descriptor, as JSON lines.\n");
     exit(-1);
 }
 
 int main(int argc, char **argv)
 {
     int read_flag = 0, write_flag = 0, config_flag = 0, csv_flag = 0;
-    int list_flag = 0, verify_flag = 0, validate_flag = 0;
+    int list_flag = 0, verify_flag = 0, validate_flag = 0, stamp_flag = 0;
+    int export_flag = 0, index_flag = 0, query_flag = 0, map_flag = 0;
+    int session_flag = 0, link_flag = 0, clone_flag = 0, delta_flag = 0;
 
     copyright = "Copyright (C) 2018 Serge Vakulenko KK6ABQ";
     trace_flag = 0;
     for (;;) {
-        switch (getopt(argc, argv, "tcwrulvz")) {
+        switch (getopt(argc, argv, "tcwrulvzsxdiqmbknp:")) {
         case 't': ++trace_flag;  continue;
+        case 'p':
+            if (optarg[0] < '0' || optarg[0] > '9')
+                usage();
+            progress_open(atoi(optarg));
+            continue;
         case 'r': ++read_flag;   continue;
         case 'w': ++write_flag;  continue;
         case 'c': ++config_flag; continue;
@@ -90,6 +159,15 @@ int main(int argc, char **argv)
         case 'l': ++list_flag;   continue;
 	case 'v': ++verify_flag; continue;
         case 'z': ++validate_flag; continue;
+        case 's': ++stamp_flag;  continue;
+        case 'x': ++export_flag; continue;
+        case 'd': ++delta_flag;  continue;
+        case 'i': ++index_flag;  continue;
+        case 'q': ++query_flag;  continue;
+        case 'm': ++map_flag;    continue;
+        case 'b': ++link_flag;   continue;
+        case 'k': ++clone_flag;  continue;
+        case 'n': ++plan_flag;   continue;
         default:
             usage();
         case EOF:
@@ -103,29 +181,84 @@ int main(int argc, char **argv)
         radio_list();
         exit(0);
     }
-    if (read_flag + write_flag + config_flag + csv_flag + verify_flag + validate_flag > 1) {
-        fprintf(stderr, "Only one of -r, -w, -c, -v, -z or -u options is allowed.\n");
+    if (csv_flag && write_flag + config_flag + verify_flag == 1) {
+        // Contacts update follows -w, -c or -v in the same session,
+        // saving the second handshake and reboot of the radio.
+        session_flag = 1;
+        csv_flag = 0;
+    }
+    if (read_flag + write_flag + config_flag + csv_flag + verify_flag + validate_flag + stamp_flag + export_flag +
+        index_flag + query_flag + map_flag + link_flag + clone_flag + delta_flag > 1) {
+        fprintf(stderr, "Only one of -r, -w, -c, -v, -z, -s, -i, -q, -m, -b, -k, -d, -u or -x options is allowed.\n");
         usage();
     }
-    setvbuf(stdout, 0, _IOLBF, 0);
+    if (read_flag + write_flag + config_flag + csv_flag + verify_flag + validate_flag + stamp_flag + export_flag +
+        index_flag + query_flag + map_flag + link_flag + clone_flag + delta_flag == 0 &&
+        !isatty(1)) {
+        // Printing configuration to file or pipe: use large blocks.
+        setvbuf(stdout, 0, _IOFBF, 64*1024);
+    } else {
+        setvbuf(stdout, 0, _IOLBF, 0);
+    }
     setvbuf(stderr, 0, _IOLBF, 0);
 
+    if (plan_flag) {
+        // Dry run of the transfer, the image stands for the radio.
+        if (read_flag + write_flag + config_flag + csv_flag + session_flag == 0 ||
+            verify_flag + validate_flag + stamp_flag + export_flag + index_flag +
+            query_flag + map_flag + link_flag + clone_flag + delta_flag > 0 ||
+            argc != 1 + config_flag + csv_flag + session_flag)
+            usage();
+
+        radio_read_image(argv[0]);
+        radio_print_version(stdout);
+        if (csv_flag || session_flag)
+            radio_check_csv();
+        if (read_flag || config_flag)
+            radio_download(0);
+        if (config_flag) {
+            radio_parse_config(argv[1]);
+            radio_verify_config();
+        }
+        if (write_flag || config_flag)
+            radio_upload(config_flag);
+        if (csv_flag || session_flag)
+            radio_write_csv(argv[argc-1]);
+        plan_print(stdout);
+        return 0;
+    }
+
+    if (session_flag) {
+        if (argc != 2)
+            usage();
+
+        // Fail before touching the radio when the CSV is missing.
+        if (access(argv[1], R_OK) < 0) {
+            perror(argv[1]);
+            exit(-1);
+        }
+    }
+
     if (write_flag) {
         // Restore image file to device.
-        if (argc != 1)
+        if (argc != 1 + session_flag)
             usage();
 
         radio_connect();
+        if (session_flag)
+            radio_check_csv();
         radio_read_image(argv[0]);
         radio_print_version(stdout);
         radio_upload(0);
+        if (session_flag)
+            radio_write_csv(argv[1]);
         radio_disconnect();
 
     } else if (config_flag) {
         if (argc != 1 && argc != 2)
             usage();
 
-        if (argc == 2) {
+        if (argc == 2 && !session_flag) {
             // Apply text config to image file.
             radio_read_image(argv[0]);
             radio_print_version(stdout);
@@ -136,23 +269,31 @@ int main(int argc, char **argv)
         } else {
             // Update device from text config file.
             radio_connect();
-            radio_download();
+            if (session_flag)
+                radio_check_csv();
+            radio_download(0);
             radio_print_version(stdout);
             radio_save_image("backup.img");
             radio_parse_config(argv[0]);
             radio_verify_config();
             radio_upload(1);
+            if (session_flag)
+                radio_write_csv(argv[1]);
             radio_disconnect();
         }
 
     } else if (verify_flag) {
-        if (argc != 1)
+        if (argc != 1 + session_flag)
 	    usage();
 
 	// Verify text config file.
 	radio_connect();
+	if (session_flag)
+	    radio_check_csv();
 	radio_parse_config(argv[0]);
 	radio_verify_config();
+	if (session_flag)
+	    radio_write_csv(argv[1]);
 	radio_disconnect();
 
     } else if (read_flag) {
@@ -160,22 +301,41 @@ int main(int argc, char **argv)
             usage();
 
         // Dump device to image file.
+        // When possible, configuration is decoded during download.
+        const char *filename = "device.conf";
         radio_connect();
-        radio_download();
+        conf_tmpname = "device.conf.tmp";
+        FILE *conf = fopen(conf_tmpname, "w");
+        if (!conf) {
+            perror(conf_tmpname);
+            exit(-1);
+        }
+        atexit(remove_conf_tmpname);
+        setvbuf(conf, 0, _IOFBF, 64*1024);
+        int streaming = radio_print_config_async(conf, 1);
+        radio_download(1);
         radio_print_version(stdout);
         radio_disconnect();
         radio_save_image("device.img");
 
         // Print configuration to file.
-        const char *filename = "device.conf";
         printf("Print configuration to file '%s'.\n", filename);
-        FILE *conf = fopen(filename, "w");
-        if (!conf) {
+        if (streaming)
+            radio_print_config_wait();
+        else
+            radio_print_config(conf, 1);
+        if (fclose(conf) != 0) {
+            perror(conf_tmpname);
+            exit(-1);
+        }
+#ifdef MINGW32
+        unlink(filename);
+#endif
+        if (rename(conf_tmpname, filename) < 0) {
             perror(filename);
             exit(-1);
         }
-        radio_print_config(conf, 1);
-        fclose(conf);
+        conf_tmpname = 0;
 
     } else if (csv_flag) {
         // Update contacts database on the device.
@@ -186,8 +346,90 @@ int main(int argc, char **argv)
         radio_write_csv(argv[0]);
         radio_disconnect();
 
+    } else if (export_flag) {
+        // Export contacts database from the device.
+        if (argc != 1)
+            usage();
+
+        radio_connect();
+        radio_read_csv(argv[0]);
+        radio_disconnect();
+
+    } else if (map_flag) {
+        // Discover memory map of the device.
+        if (argc != 1)
+            usage();
+
+        radio_connect();
+        radio_discover_map(argv[0]);
+        radio_disconnect();
+
+    } else if (link_flag) {
+        // Benchmark the link to the device.
+        if (argc != 0)
+            usage();
+
+        radio_connect();
+        radio_linktest();
+        radio_disconnect();
+
+    } else if (clone_flag) {
+        // Copy the codeplug between two radios.
+        if (argc > 1 || (argc == 1 && strcmp(argv[0], "0") != 0 &&
+                                      strcmp(argv[0], "1") != 0))
+            usage();
+
+        radio_clone(argc == 1 ? atoi(argv[0]) : 0);
+
+    } else if (delta_flag) {
+        // Compare two snapshots of contacts database.
+        if (argc != 2)
+            usage();
+
+        if (csv_print_delta(stdout, argv[0], argv[1]) != 0)
+            exit(1);
+
+    } else if (stamp_flag) {
+        if (argc != 3)
+            usage();
+
+        // Compile the shared config once, then stamp per-radio fields.
+        radio_read_image(argv[0]);
+        radio_print_version(stdout);
+        radio_parse_config(argv[1]);
+        radio_verify_config();
+        radio_stamp_images(argv[2]);
+
+    } else if (index_flag) {
+        if (argc < 2)
+            usage();
+
+        // Decode new and changed images, keep the rest of the index.
+        if (radio_index_images(argv[0], argc - 1, argv + 1) > 0)
+            exit(-1);
+
+    } else if (query_flag) {
+        int i, nfound = 0;
+
+        if (argc < 2)
+            usage();
+
+        for (i=1; i<argc; i++)
+            nfound += radio_query_index(argv[0], argv[i]);
+        if (nfound == 0)
+            exit(1);
+
     } else if (validate_flag) {
-      radio_validate_config(argv[0]);
+        if (argc < 1)
+            usage();
+
+        if (argc == 1 && is_file(argv[0])) {
+            radio_validate_config(argv[0]);
+        } else {
+            // Many files, or directory: validate in parallel.
+            if (radio_validate_configs(argc, argv) > 0)
+                exit(-1);
+        }
     } else {
         if (argc != 1)
             usage();
@@ -359,20 +359,54 @@ static void md380_print_version(radio_device_t *radio, FILE *out)
     }
 }
 
+//
+// Read the block with timestamp, radio name and ID,
+// and a few random blocks, and check the cached image.
+//
+static int cache_valid()
+{
+    general_settings_t *gs = GET_SETTINGS();
+    unsigned n = dfu_transfer_size();
+    range_t tab[4];
+    int i;
+
+    // Radio ID identifies the cached image.
+    tab[0].start = gs->radio_id - radio_mem;
+    tab[0].end = tab[0].start + sizeof(gs->radio_id);
+
+    for (i=1; i<4; i++) {
+        tab[i].start = (i == 1) ? OFFSET_TIMESTMP / n * n : rand() % (MEMSZ / n) * n;
+        tab[i].end = tab[i].start + n;
+        dfu_read(tab[i].start, &radio_mem[tab[i].start], n);
+    }
+    return radio_cache_lookup(tab, 4);
+}
+
 //
 // Read memory image from the device.
+// Skip the download when the cached image is still valid.
 //
 static void md380_download(radio_device_t *radio)
 {
-    int bno;
+    unsigned addr, n, kb;
 
-    for (bno=0; bno<MEMSZ/1024; bno++) {
-        dfu_read_block(bno, &radio_mem[bno*1024], 1024);
+    if (cache_valid())
+        return;
 
-        ++radio_progress;
-        if (radio_progress % 32 == 0) {
-            fprintf(stderr, "#");
-            fflush(stderr);
+    for (addr=0; addr<MEMSZ; addr+=n) {
+        n = dfu_transfer_size();
+        if (n > MEMSZ - addr)
+            n = MEMSZ - addr;
+        dfu_read(addr, &radio_mem[addr], n);
+        radio_mem_ready(addr + n);
+        progress_update(addr + n, MEMSZ);
+
+        for (kb=0; kb<n/1024; kb++) {
+            ++radio_progress;
+            if (radio_progress % 32 == 0) {
+                fprintf(stderr, "#");
+                fflush(stderr);
+            }
         }
     }
 }
@@ -382,21 +416,36 @@ static void md380_download(radio_device_t *radio)
 //
 static void md380_upload(radio_device_t *radio, int cont_flag)
 {
-    int bno;
+    unsigned addr, n, kb;
 
     dfu_erase(0, MEMSZ);
 
-    for (bno=0; bno<MEMSZ/1024; bno++) {
-        dfu_write_block(bno, &radio_mem[bno*1024], 1024);
-
-        ++radio_progress;
-        if (radio_progress % 32 == 0) {
-            fprintf(stderr, "#");
-            fflush(stderr);
+    for (addr=0; addr<MEMSZ; addr+=n) {
+        n = dfu_transfer_size();
+        if (n > MEMSZ - addr)
+            n = MEMSZ - addr;
+        radio_mem_wait(addr + n);
+        dfu_write(addr, &radio_mem[addr], n);
+        progress_update(addr + n, MEMSZ);
+
+        for (kb=0; kb<n/1024; kb++) {
+            ++radio_progress;
+            if (radio_progress % 32 == 0) {
+                fprintf(stderr, "#");
+                fflush(stderr);
+            }
         }
     }
 }
 
+//
+// Benchmark the link with reads of the configuration memory.
+//
+static void md380_linktest(radio_device_t *radio)
+{
+    dfu_linktest(0, 256*1024);
+}
+
 //
 // Check whether the memory image is compatible with this device.
 //
@@ -573,7 +622,7 @@ static int is_valid_frequency(int mhz)
 //
 // Set the parameters for a given memory channel.
 //
-static void setup_channel(int i, int mode, char *name, double rx_mhz, double tx_mhz,
+static void setup_channel(int i, int mode, char *name, int rx_hz, int tx_hz,
     int power, int scanlist, int squelch, int tot, int rxonly,
     int admit, int colorcode, int timeslot, int grouplist, int contact,
     int rxtone, int txtone, int width)
@@ -592,8 +641,8 @@ static void setup_channel(int i, int mode, char *name, double rx_mhz, double tx_
     ch->tot                 = tot;
     ch->scan_list_index     = scanlist;
     ch->group_list_index    = grouplist;
-    ch->rx_frequency        = mhz_to_abcdefgh(rx_mhz);
-    ch->tx_frequency        = mhz_to_abcdefgh(tx_mhz);
+    ch->rx_frequency        = hz_to_abcdefgh(rx_hz);
+    ch->tx_frequency        = hz_to_abcdefgh(tx_hz);
     ch->ctcss_dcs_receive   = rxtone;
     ch->ctcss_dcs_transmit  = txtone;
 
@@ -687,7 +736,7 @@ static void erase_channel(int i)
     utf8_decode(ch->name, "", 16);
 }
 
-static void print_chanlist(FILE *out, uint16_t *unsorted, int nchan)
+static void print_chanlist(outbuf_t *out, uint16_t *unsorted, int nchan)
 {
     int last  = -1;
     int range = 0;
@@ -707,54 +756,54 @@ static void print_chanlist(FILE *out, uint16_t *unsorted, int nchan)
             range = 1;
         } else {
             if (range) {
-                fprintf(out, "-%d", last);
+                outbuf_printf(out, "-%d", last);
                 range = 0;
             }
             if (n > 0)
-                fprintf(out, ",");
-            fprintf(out, "%d", cnum);
+                outbuf_printf(out, ",");
+            outbuf_printf(out, "%d", cnum);
         }
         last = cnum;
     }
     if (range)
-        fprintf(out, "-%d", last);
+        outbuf_printf(out, "-%d", last);
 }
 
-static void print_id(FILE *out, int verbose)
+static void print_id(outbuf_t *out, int verbose)
 {
     general_settings_t *gs = GET_SETTINGS();
     unsigned id = gs->radio_id[0] | (gs->radio_id[1] << 8) | (gs->radio_id[2] << 16);
 
     if (verbose)
-        fprintf(out, "\n# Unique DMR ID and name of this radio.");
-    fprintf(out, "\nID: %u\nName: ", id);
+        outbuf_printf(out, "\n# Unique DMR ID and name of this radio.");
+    outbuf_printf(out, "\nID: %u\nName: ", id);
     if (VALID_TEXT(gs->radio_name)) {
-        print_unicode(out, gs->radio_name, 16, 0);
+        outbuf_unicode(out, gs->radio_name, 16, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
 }
 
-static void print_intro(FILE *out, int verbose)
+static void print_intro(outbuf_t *out, int verbose)
 {
     general_settings_t *gs = GET_SETTINGS();
 
     if (verbose)
-        fprintf(out, "\n# Text displayed when the radio powers up.\n");
-    fprintf(out, "Intro Line 1: ");
+        outbuf_printf(out, "\n# Text displayed when the radio powers up.\n");
+    outbuf_printf(out, "Intro Line 1: ");
     if (VALID_TEXT(gs->intro_line1)) {
-        print_unicode(out, gs->intro_line1, 10, 0);
+        outbuf_unicode(out, gs->intro_line1, 10, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\nIntro Line 2: ");
+    outbuf_printf(out, "\nIntro Line 2: ");
     if (VALID_TEXT(gs->intro_line2)) {
-        print_unicode(out, gs->intro_line2, 10, 0);
+        outbuf_unicode(out, gs->intro_line2, 10, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
 }
 
 //
@@ -784,30 +833,30 @@ static int have_channels(int mode)
 //      RX Only
 //      Admit Criteria
 //
-static void print_chan_base(FILE *out, channel_t *ch, int cnum)
+static void print_chan_base(outbuf_t *out, channel_t *ch, int cnum)
 {
-    fprintf(out, "%5d   ", cnum);
-    print_unicode(out, ch->name, 16, 1);
-    fprintf(out, " ");
-    print_freq(out, ch->rx_frequency);
-    fprintf(out, " ");
-    print_offset(out, ch->rx_frequency, ch->tx_frequency);
+    outbuf_printf(out, "%5d   ", cnum);
+    outbuf_unicode(out, ch->name, 16, 1);
+    outbuf_printf(out, " ");
+    outbuf_freq(out, ch->rx_frequency);
+    outbuf_printf(out, " ");
+    outbuf_offset(out, ch->rx_frequency, ch->tx_frequency);
 
-    fprintf(out, "%-4s  ", POWER_NAME[ch->power]);
+    outbuf_printf(out, "%-4s  ", POWER_NAME[ch->power]);
 
     if (ch->scan_list_index == 0)
-        fprintf(out, "-    ");
+        outbuf_printf(out, "-    ");
     else
-        fprintf(out, "%-4d ", ch->scan_list_index);
+        outbuf_printf(out, "%-4d ", ch->scan_list_index);
 
     if (ch->tot == 0)
-        fprintf(out, "-   ");
+        outbuf_printf(out, "-   ");
     else
-        fprintf(out, "%-3d ", ch->tot * 15);
+        outbuf_printf(out, "%-3d ", ch->tot * 15);
 
-    fprintf(out, "%c  ", "-+"[ch->rx_only]);
+    outbuf_printf(out, "%c  ", "-+"[ch->rx_only]);
 
-    fprintf(out, "%-6s ", ADMIT_NAME[ch->admit_criteria]);
+    outbuf_printf(out, "%-6s ", ADMIT_NAME[ch->admit_criteria]);
 }
 
 #ifdef PRINT_RARE_PARAMS
@@ -820,45 +869,45 @@ static void print_chan_base(FILE *out, channel_t *ch, int cnum)
 //      Lone Worker
 //      VOX
 //
-static void print_chan_ext(FILE *out, channel_t *ch)
+static void print_chan_ext(outbuf_t *out, channel_t *ch)
 {
-    fprintf(out, "%c  ", "-+"[ch->autoscan]);
-    fprintf(out, "%-6s ", INCALL_NAME[ch->in_call_criteria]);
-    fprintf(out, "%-3d ", ch->tot_rekey_delay);
-    fprintf(out, "%-5s ", REF_FREQUENCY[ch->rx_ref_frequency]);
-    fprintf(out, "%-5s ", REF_FREQUENCY[ch->tx_ref_frequency]);
-    fprintf(out, "%c  ", "-+"[ch->lone_worker]);
-    fprintf(out, "%c   ", "-+"[ch->vox]);
-    fprintf(out, "%c  ", "-+"[ch->talkaround]);
+    outbuf_printf(out, "%c  ", "-+"[ch->autoscan]);
+    outbuf_printf(out, "%-6s ", INCALL_NAME[ch->in_call_criteria]);
+    outbuf_printf(out, "%-3d ", ch->tot_rekey_delay);
+    outbuf_printf(out, "%-5s ", REF_FREQUENCY[ch->rx_ref_frequency]);
+    outbuf_printf(out, "%-5s ", REF_FREQUENCY[ch->tx_ref_frequency]);
+    outbuf_printf(out, "%c  ", "-+"[ch->lone_worker]);
+    outbuf_printf(out, "%c   ", "-+"[ch->vox]);
+    outbuf_printf(out, "%c  ", "-+"[ch->talkaround]);
 }
 #endif
 
-static void print_digital_channels(FILE *out, int verbose)
+static void print_digital_channels(outbuf_t *out, int verbose)
 {
     int i;
 
     if (verbose) {
-        fprintf(out, "# Table of digital channels.\n");
-        fprintf(out, "# 1) Channel number: 1-%d\n", NCHAN);
-        fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-        fprintf(out, "# 3) Receive frequency in MHz\n");
-        fprintf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
-        fprintf(out, "# 5) Transmit power: High, Low\n");
-        fprintf(out, "# 6) Scan list: - or index in Scanlist table\n");
-        fprintf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
-        fprintf(out, "# 8) Receive only: -, +\n");
-        fprintf(out, "# 9) Admit criteria: -, Free, Color\n");
-        fprintf(out, "# 10) Color code: 0, 1, 2, 3... 15\n");
-        fprintf(out, "# 11) Time slot: 1 or 2\n");
-        fprintf(out, "# 12) Receive group list: - or index in Grouplist table\n");
-        fprintf(out, "# 13) Contact for transmit: - or index in Contacts table\n");
-        fprintf(out, "#\n");
-    }
-    fprintf(out, "Digital Name             Receive   Transmit Power Scan TOT RO Admit  Color Slot RxGL TxContact");
+        outbuf_printf(out, "# Table of digital channels.\n");
+        outbuf_printf(out, "# 1) Channel number: 1-%d\n", NCHAN);
+        outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+        outbuf_printf(out, "# 3) Receive frequency in MHz\n");
+        outbuf_printf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
+        outbuf_printf(out, "# 5) Transmit power: High, Low\n");
+        outbuf_printf(out, "# 6) Scan list: - or index in Scanlist table\n");
+        outbuf_printf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
+        outbuf_printf(out, "# 8) Receive only: -, +\n");
+        outbuf_printf(out, "# 9) Admit criteria: -, Free, Color\n");
+        outbuf_printf(out, "# 10) Color code: 0, 1, 2, 3... 15\n");
+        outbuf_printf(out, "# 11) Time slot: 1 or 2\n");
+        outbuf_printf(out, "# 12) Receive group list: - or index in Grouplist table\n");
+        outbuf_printf(out, "# 13) Contact for transmit: - or index in Contacts table\n");
+        outbuf_printf(out, "#\n");
+    }
+    outbuf_printf(out, "Digital Name             Receive   Transmit Power Scan TOT RO Admit  Color Slot RxGL TxContact");
 #ifdef PRINT_RARE_PARAMS
-    fprintf(out, " AS InCall Dly RxRef TxRef LW VOX TA EmSys Privacy  PN PCC EAA DCC CU");
+    outbuf_printf(out, " AS InCall Dly RxRef TxRef LW VOX TA EmSys Privacy  PN PCC EAA DCC CU");
 #endif
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
     for (i=0; i<NCHAN; i++) {
         channel_t *ch = GET_CHANNEL(i);
 
@@ -873,20 +922,20 @@ static void print_digital_channels(FILE *out, int verbose)
         //      Repeater Slot
         //      Group List
         //      Contact Name
-        fprintf(out, "%-5d %-3d  ", ch->colorcode, ch->repeater_slot);
+        outbuf_printf(out, "%-5d %-3d  ", ch->colorcode, ch->repeater_slot);
 
         if (ch->group_list_index == 0)
-            fprintf(out, "-    ");
+            outbuf_printf(out, "-    ");
         else
-            fprintf(out, "%-4d ", ch->group_list_index);
+            outbuf_printf(out, "%-4d ", ch->group_list_index);
 
         if (ch->contact_name_index == 0)
-            fprintf(out, "-");
+            outbuf_printf(out, "-");
         else
-            fprintf(out, "%-4d", ch->contact_name_index);
+            outbuf_printf(out, "%-4d", ch->contact_name_index);
 
 #ifdef PRINT_RARE_PARAMS
-        fprintf(out, "      ");
+        outbuf_printf(out, "      ");
 
         print_chan_ext(out, ch);
 
@@ -901,60 +950,60 @@ static void print_digital_channels(FILE *out, int verbose)
         //      DCDM switch (inverted)
         //      Leader/MS
         if (ch->emergency_system_index == 0)
-            fprintf(out, "-     ");
+            outbuf_printf(out, "-     ");
         else
-            fprintf(out, "%-5d ", ch->emergency_system_index);
+            outbuf_printf(out, "%-5d ", ch->emergency_system_index);
 
-        fprintf(out, "%-8s ", PRIVACY_NAME[ch->privacy]);
+        outbuf_printf(out, "%-8s ", PRIVACY_NAME[ch->privacy]);
 
         if (ch->privacy == PRIV_NONE)
-            fprintf(out, "-  ");
+            outbuf_printf(out, "-  ");
         else
-            fprintf(out, "%-2d ", ch->privacy_no + 1);
+            outbuf_printf(out, "%-2d ", ch->privacy_no + 1);
 
-        fprintf(out, "%c   ", "-+"[ch->private_call_conf]);
-        fprintf(out, "%c   ", "-+"[ch->emergency_alarm_ack]);
-        fprintf(out, "%c   ", "-+"[ch->data_call_conf]);
-        fprintf(out, "%c   ", "+-"[ch->uncompressed_udp]);
+        outbuf_printf(out, "%c   ", "-+"[ch->private_call_conf]);
+        outbuf_printf(out, "%c   ", "-+"[ch->emergency_alarm_ack]);
+        outbuf_printf(out, "%c   ", "-+"[ch->data_call_conf]);
+        outbuf_printf(out, "%c   ", "+-"[ch->uncompressed_udp]);
 #endif
         // Print contact name as a comment.
         if (ch->contact_name_index > 0) {
             contact_t *ct = GET_CONTACT(ch->contact_name_index - 1);
             if (VALID_CONTACT(ct)) {
-                fprintf(out, " # ");
-                print_unicode(out, ct->name, 16, 0);
+                outbuf_printf(out, " # ");
+                outbuf_unicode(out, ct->name, 16, 0);
             }
         }
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
     }
 }
 
-static void print_analog_channels(FILE *out, int verbose)
+static void print_analog_channels(outbuf_t *out, int verbose)
 {
     int i;
 
     if (verbose) {
-        fprintf(out, "# Table of analog channels.\n");
-        fprintf(out, "# 1) Channel number: 1-%d\n", NCHAN);
-        fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-        fprintf(out, "# 3) Receive frequency in MHz\n");
-        fprintf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
-        fprintf(out, "# 5) Transmit power: High, Low\n");
-        fprintf(out, "# 6) Scan list: - or index\n");
-        fprintf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
-        fprintf(out, "# 8) Receive only: -, +\n");
-        fprintf(out, "# 9) Admit criteria: -, Free, Tone\n");
-        fprintf(out, "# 10) Squelch level: Normal, Tight\n");
-        fprintf(out, "# 11) Guard tone for receive, or '-' to disable\n");
-        fprintf(out, "# 12) Guard tone for transmit, or '-' to disable\n");
-        fprintf(out, "# 13) Bandwidth in kHz: 12.5, 20, 25\n");
-        fprintf(out, "#\n");
-    }
-    fprintf(out, "Analog  Name             Receive   Transmit Power Scan TOT RO Admit  Squelch RxTone TxTone Width");
+        outbuf_printf(out, "# Table of analog channels.\n");
+        outbuf_printf(out, "# 1) Channel number: 1-%d\n", NCHAN);
+        outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+        outbuf_printf(out, "# 3) Receive frequency in MHz\n");
+        outbuf_printf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
+        outbuf_printf(out, "# 5) Transmit power: High, Low\n");
+        outbuf_printf(out, "# 6) Scan list: - or index\n");
+        outbuf_printf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
+        outbuf_printf(out, "# 8) Receive only: -, +\n");
+        outbuf_printf(out, "# 9) Admit criteria: -, Free, Tone\n");
+        outbuf_printf(out, "# 10) Squelch level: Normal, Tight\n");
+        outbuf_printf(out, "# 11) Guard tone for receive, or '-' to disable\n");
+        outbuf_printf(out, "# 12) Guard tone for transmit, or '-' to disable\n");
+        outbuf_printf(out, "# 13) Bandwidth in kHz: 12.5, 20, 25\n");
+        outbuf_printf(out, "#\n");
+    }
+    outbuf_printf(out, "Analog  Name             Receive   Transmit Power Scan TOT RO Admit  Squelch RxTone TxTone Width");
 #ifdef PRINT_RARE_PARAMS
-    fprintf(out, " AS Dly RxRef TxRef LW VOX TA RxSign TxSign ID");
+    outbuf_printf(out, " AS Dly RxRef TxRef LW VOX TA RxSign TxSign ID");
 #endif
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
     for (i=0; i<NCHAN; i++) {
         channel_t *ch = GET_CHANNEL(i);
 
@@ -969,25 +1018,25 @@ static void print_analog_channels(FILE *out, int verbose)
         //      CTCSS/DCS Dec
         //      CTCSS/DCS Enc
         //      Bandwidth
-        fprintf(out, "%-7s ", SQUELCH_NAME[ch->squelch]);
-        print_tone(out, ch->ctcss_dcs_receive);
-        fprintf(out, "  ");
-        print_tone(out, ch->ctcss_dcs_transmit);
-        fprintf(out, "  %s", BANDWIDTH[ch->bandwidth]);
+        outbuf_printf(out, "%-7s ", SQUELCH_NAME[ch->squelch]);
+        outbuf_tone(out, ch->ctcss_dcs_receive);
+        outbuf_printf(out, "  ");
+        outbuf_tone(out, ch->ctcss_dcs_transmit);
+        outbuf_printf(out, "  %s", BANDWIDTH[ch->bandwidth]);
 
 #ifdef PRINT_RARE_PARAMS
         print_chan_ext(out, ch);
-        fprintf(out, "  ");
+        outbuf_printf(out, "  ");
         // Extended analog parameters of the channel:
         //      Rx Signaling System
         //      Tx Signaling System
         //      Display PTT ID (inverted)
         //      Non-QT/DQT Turn-off Freq.
-        fprintf(out, "%-6s ", SIGNALING_SYSTEM[ch->rx_signaling_syst]);
-        fprintf(out, "%-6s ", SIGNALING_SYSTEM[ch->tx_signaling_syst]);
-        fprintf(out, "%c  ", "+-"[ch->display_pttid_dis]);
+        outbuf_printf(out, "%-6s ", SIGNALING_SYSTEM[ch->rx_signaling_syst]);
+        outbuf_printf(out, "%-6s ", SIGNALING_SYSTEM[ch->tx_signaling_syst]);
+        outbuf_printf(out, "%c  ", "+-"[ch->display_pttid_dis]);
 #endif
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
     }
 }
 
@@ -1058,23 +1107,25 @@ static int have_messages()
 //
 // Print full information about the device configuration.
 //
-static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
+static void md380_print_config(radio_device_t *radio, FILE *file, int verbose)
 {
+    outbuf_t ob, *out = &ob;
     int i;
 
-    fprintf(out, "Radio: %s\n", radio->name);
+    fprintf(file, "Radio: %s\n", radio->name);
     if (verbose)
-        md380_print_version(radio, out);
+        md380_print_version(radio, file);
+    outbuf_init(&ob, file);
 
     //
     // Channels.
     //
     if (have_channels(MODE_DIGITAL)) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         print_digital_channels(out, verbose);
     }
     if (have_channels(MODE_ANALOG)) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         print_analog_channels(out, verbose);
     }
 
@@ -1082,15 +1133,15 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Zones.
     //
     if (have_zones()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of channel zones.\n");
-            fprintf(out, "# 1) Zone number: 1-%d\n", NZONES);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) List of channels: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of channel zones.\n");
+            outbuf_printf(out, "# 1) Zone number: 1-%d\n", NZONES);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) List of channels: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Zone    Name             Channels\n");
+        outbuf_printf(out, "Zone    Name             Channels\n");
         for (i=0; i<NZONES; i++) {
             zone_t *z = GET_ZONE(i);
 
@@ -1099,15 +1150,15 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%4d    ", i + 1);
-            print_unicode(out, z->name, 16, 1);
-            fprintf(out, " ");
+            outbuf_printf(out, "%4d    ", i + 1);
+            outbuf_unicode(out, z->name, 16, 1);
+            outbuf_printf(out, " ");
             if (z->member[0]) {
                 print_chanlist(out, z->member, 16);
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
@@ -1115,22 +1166,22 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Scan lists.
     //
     if (have_scanlists()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of scan lists.\n");
-            fprintf(out, "# 1) Scan list number: 1-%d\n", NSCANL);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) Priority channel 1 (50%% of scans): -, Sel or index\n");
-            fprintf(out, "# 4) Priority channel 2 (25%% of scans): -, Sel or index\n");
-            fprintf(out, "# 5) Designated transmit channel: Last, Sel or index\n");
-            fprintf(out, "# 6) List of channels: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of scan lists.\n");
+            outbuf_printf(out, "# 1) Scan list number: 1-%d\n", NSCANL);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) Priority channel 1 (50%% of scans): -, Sel or index\n");
+            outbuf_printf(out, "# 4) Priority channel 2 (25%% of scans): -, Sel or index\n");
+            outbuf_printf(out, "# 5) Designated transmit channel: Last, Sel or index\n");
+            outbuf_printf(out, "# 6) List of channels: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Scanlist Name             PCh1 PCh2 TxCh ");
+        outbuf_printf(out, "Scanlist Name             PCh1 PCh2 TxCh ");
 #ifdef PRINT_RARE_PARAMS
-        fprintf(out, "Hold Smpl ");
+        outbuf_printf(out, "Hold Smpl ");
 #endif
-        fprintf(out, "Channels\n");
+        outbuf_printf(out, "Channels\n");
         for (i=0; i<NSCANL; i++) {
             scanlist_t *sl = GET_SCANLIST(i);
 
@@ -1139,39 +1190,39 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%5d    ", i + 1);
-            print_unicode(out, sl->name, 16, 1);
+            outbuf_printf(out, "%5d    ", i + 1);
+            outbuf_unicode(out, sl->name, 16, 1);
             if (sl->priority_ch1 == 0xffff) {
-                fprintf(out, " -    ");
+                outbuf_printf(out, " -    ");
             } else if (sl->priority_ch1 == 0) {
-                fprintf(out, " Sel  ");
+                outbuf_printf(out, " Sel  ");
             } else {
-                fprintf(out, " %-4d ", sl->priority_ch1);
+                outbuf_printf(out, " %-4d ", sl->priority_ch1);
             }
             if (sl->priority_ch2 == 0xffff) {
-                fprintf(out, "-    ");
+                outbuf_printf(out, "-    ");
             } else if (sl->priority_ch2 == 0) {
-                fprintf(out, "Sel  ");
+                outbuf_printf(out, "Sel  ");
             } else {
-                fprintf(out, "%-4d ", sl->priority_ch2);
+                outbuf_printf(out, "%-4d ", sl->priority_ch2);
             }
             if (sl->tx_designated_ch == 0xffff) {
-                fprintf(out, "Last ");
+                outbuf_printf(out, "Last ");
             } else if (sl->tx_designated_ch == 0) {
-                fprintf(out, "Sel  ");
+                outbuf_printf(out, "Sel  ");
             } else {
-                fprintf(out, "%-4d ", sl->tx_designated_ch);
+                outbuf_printf(out, "%-4d ", sl->tx_designated_ch);
             }
             if (sl->member[0]) {
                 print_chanlist(out, sl->member, 31);
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
 #ifdef PRINT_RARE_PARAMS
-            fprintf(out, "%-4d %-4d ",
+            outbuf_printf(out, "%-4d %-4d ",
                 sl->sign_hold_time * 25, sl->prio_sample_time * 250);
 #endif
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
@@ -1179,17 +1230,17 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Contacts.
     //
     if (have_contacts()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of contacts.\n");
-            fprintf(out, "# 1) Contact number: 1-%d\n", NCONTACTS);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) Call type: Group, Private, All\n");
-            fprintf(out, "# 4) Call ID: 1...16777215\n");
-            fprintf(out, "# 5) Call receive tone: -, +\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of contacts.\n");
+            outbuf_printf(out, "# 1) Contact number: 1-%d\n", NCONTACTS);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) Call type: Group, Private, All\n");
+            outbuf_printf(out, "# 4) Call ID: 1...16777215\n");
+            outbuf_printf(out, "# 5) Call receive tone: -, +\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Contact Name             Type    ID       RxTone\n");
+        outbuf_printf(out, "Contact Name             Type    ID       RxTone\n");
         for (i=0; i<NCONTACTS; i++) {
             contact_t *ct = GET_CONTACT(i);
 
@@ -1198,10 +1249,14 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%5d   ", i+1);
-            print_unicode(out, ct->name, 16, 1);
-            fprintf(out, " %-7s %-8d %s\n",
-                CONTACT_TYPE[ct->type & 3], CONTACT_ID(ct), ct->receive_tone ? "+" : "-");
+            outbuf_uint(out, i+1, 5);
+            outbuf_puts(out, "   ");
+            outbuf_unicode(out, ct->name, 16, 1);
+            outbuf_putc(out, ' ');
+            outbuf_str(out, CONTACT_TYPE[ct->type & 3], -7);
+            outbuf_putc(out, ' ');
+            outbuf_uint(out, CONTACT_ID(ct), -8);
+            outbuf_puts(out, ct->receive_tone ? " +\n" : " -\n");
         }
     }
 
@@ -1209,15 +1264,15 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Group lists.
     //
     if (have_grouplists()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of group lists.\n");
-            fprintf(out, "# 1) Group list number: 1-%d\n", NGLISTS);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) List of contacts: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of group lists.\n");
+            outbuf_printf(out, "# 1) Group list number: 1-%d\n", NGLISTS);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) List of contacts: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Grouplist Name             Contacts\n");
+        outbuf_printf(out, "Grouplist Name             Contacts\n");
         for (i=0; i<NGLISTS; i++) {
             grouplist_t *gl = GET_GROUPLIST(i);
 
@@ -1226,15 +1281,15 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%5d     ", i + 1);
-            print_unicode(out, gl->name, 16, 1);
-            fprintf(out, " ");
+            outbuf_printf(out, "%5d     ", i + 1);
+            outbuf_unicode(out, gl->name, 16, 1);
+            outbuf_printf(out, " ");
             if (gl->member[0]) {
                 print_chanlist(out, gl->member, 32);
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
@@ -1242,14 +1297,14 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Text messages.
     //
     if (have_messages()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of text messages.\n");
-            fprintf(out, "# 1) Message number: 1-%d\n", NMESSAGES);
-            fprintf(out, "# 2) Text: up to 144 characters\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of text messages.\n");
+            outbuf_printf(out, "# 1) Message number: 1-%d\n", NMESSAGES);
+            outbuf_printf(out, "# 2) Text: up to 144 characters\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Message Text\n");
+        outbuf_printf(out, "Message Text\n");
         for (i=0; i<NMESSAGES; i++) {
             uint16_t *msg = GET_MESSAGE(i);
 
@@ -1258,15 +1313,17 @@ static void md380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%5d   ", i+1);
-            print_unicode(out, msg, 144, 0);
-            fprintf(out, "\n");
+            outbuf_printf(out, "%5d   ", i+1);
+            outbuf_unicode(out, msg, 144, 0);
+            outbuf_printf(out, "\n");
         }
     }
 
     // General settings.
     print_id(out, verbose);
     print_intro(out, verbose);
+
+    outbuf_flush(&ob);
 }
 
 //
@@ -1418,7 +1475,7 @@ static int parse_digital_channel(radio_device_t *radio, int first_row, char *lin
     char slot_str[256], grouplist_str[256], contact_str[256];
     int num, power, scanlist, tot, rxonly, admit;
     int colorcode, timeslot, grouplist, contact;
-    double rx_mhz, tx_mhz;
+    int rx_hz, tx_hz;
 
     if (sscanf(line, "%s %s %s %s %s %s %s %s %s %s %s %s %s",
         num_str, name_str, rxfreq_str, offset_str,
@@ -1433,18 +1490,18 @@ static int parse_digital_channel(radio_device_t *radio, int first_row, char *lin
         return 0;
     }
 
-    if (sscanf(rxfreq_str, "%lf", &rx_mhz) != 1 ||
-        !is_valid_frequency(rx_mhz)) {
+    if (!parse_mhz(rxfreq_str, &rx_hz) ||
+        !is_valid_frequency(rx_hz / 1000000)) {
         fprintf(stderr, "Bad receive frequency.\n");
         return 0;
     }
-    if (sscanf(offset_str, "%lf", &tx_mhz) != 1) {
+    if (!parse_mhz(offset_str, &tx_hz)) {
 badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         return 0;
     }
     if (offset_str[0] == '-' || offset_str[0] == '+')
-        tx_mhz += rx_mhz;
-    if (! is_valid_frequency(tx_mhz))
+        tx_hz += rx_hz;
+    if (! is_valid_frequency(tx_hz / 1000000))
         goto badtx;
 
     if (strcasecmp("High", power_str) == 0) {
@@ -1532,7 +1589,7 @@ badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         erase_scanlists();
     }
 
-    setup_channel(num-1, MODE_DIGITAL, name_str, rx_mhz, tx_mhz,
+    setup_channel(num-1, MODE_DIGITAL, name_str, rx_hz, tx_hz,
         power, scanlist, SQ_NORMAL, tot, rxonly, admit,
         colorcode, timeslot, grouplist, contact, 0xffff, 0xffff, BW_12_5_KHZ);
 
@@ -1553,7 +1610,7 @@ static int parse_analog_channel(radio_device_t *radio, int first_row, char *line
     char rxtone_str[256], txtone_str[256], width_str[256];
     int num, power, scanlist, squelch, tot, rxonly, admit;
     int rxtone, txtone, width;
-    double rx_mhz, tx_mhz;
+    int rx_hz, tx_hz;
 
     if (sscanf(line, "%s %s %s %s %s %s %s %s %s %s %s %s %s",
         num_str, name_str, rxfreq_str, offset_str,
@@ -1568,18 +1625,18 @@ static int parse_analog_channel(radio_device_t *radio, int first_row, char *line
         return 0;
     }
 
-    if (sscanf(rxfreq_str, "%lf", &rx_mhz) != 1 ||
-        !is_valid_frequency(rx_mhz)) {
+    if (!parse_mhz(rxfreq_str, &rx_hz) ||
+        !is_valid_frequency(rx_hz / 1000000)) {
         fprintf(stderr, "Bad receive frequency.\n");
         return 0;
     }
-    if (sscanf(offset_str, "%lf", &tx_mhz) != 1) {
+    if (!parse_mhz(offset_str, &tx_hz)) {
 badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         return 0;
     }
     if (offset_str[0] == '-' || offset_str[0] == '+')
-        tx_mhz += rx_mhz;
-    if (! is_valid_frequency(tx_mhz))
+        tx_hz += rx_hz;
+    if (! is_valid_frequency(tx_hz / 1000000))
         goto badtx;
 
     if (strcasecmp("High", power_str) == 0) {
@@ -1664,7 +1721,7 @@ badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         erase_channels();
     }
 
-    setup_channel(num-1, MODE_ANALOG, name_str, rx_mhz, tx_mhz,
+    setup_channel(num-1, MODE_ANALOG, name_str, rx_hz, tx_hz,
         power, scanlist, squelch, tot, rxonly, admit,
         1, 1, 0, 0, rxtone, txtone, width);
 
@@ -2246,6 +2303,7 @@ radio_device_t radio_md380 = {
     md380_parse_row,
     md380_update_timestamp,
     //TODO: md380_write_csv,
+    .linktest = md380_linktest,
 };
 
 //
@@ -2266,6 +2324,7 @@ radio_device_t radio_md390 = {
     md380_parse_row,
     md380_update_timestamp,
     //TODO: md380_write_csv,
+    .linktest = md380_linktest,
 };
 
 //
@@ -2285,6 +2344,7 @@ radio_device_t radio_d900 = {
     md380_parse_header,
     md380_parse_row,
     md380_update_timestamp,
+    .linktest = md380_linktest,
 };
 
 //
@@ -2304,6 +2364,7 @@ radio_device_t radio_dp880 = {
     md380_parse_header,
     md380_parse_row,
     md380_update_timestamp,
+    .linktest = md380_linktest,
 };
 
 //
@@ -2323,4 +2384,5 @@ radio_device_t radio_rt27d = {
     md380_parse_header,
     md380_parse_row,
     md380_update_timestamp,
+    .linktest = md380_linktest,
 };
@@ -26,12 +26,19 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <stdio.h>
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <dirent.h>
+#ifndef MINGW32
+#   include <pthread.h>
+#   include <sys/wait.h>
+#   include <signal.h>
+#endif
 #include "radio.h"
 #include "util.h"
 
@@ -64,6 +71,19 @@ unsigned char radio_mem [1024*1024*2];  // Radio memory contents, up to 2 Mbytes
 int radio_progress;                     // Read/write progress counter
 
 static radio_device_t *device;          // Device-dependent interface
+static unsigned mem_ready = ~0;         // Bytes of radio_mem ready for decode
+static unsigned char radio_base [sizeof(radio_mem)]; // Image as downloaded
+static int base_valid;                  // Set when radio_base is loaded
+#define BASE_GRANULE 16                 // Unit of the map of unread bytes
+static unsigned char base_unread [sizeof(radio_mem) / BASE_GRANULE / 8];
+static char cache_path [1024];          // Cached image of the connected radio
+static int cache_hit;                   // Set when the cached image is valid
+static int cache_enable;                // Cached image may replace the download
+static range_t cache_key [2];           // Ranges, which name the cached image
+static int cache_nkey;
+static int clone_fd = -1;               // Pipe to the target radio of clone
+static unsigned clone_sent;             // Bytes of radio_mem sent to the pipe
+static int clone_target;                // Set when radio_mem comes from the pipe
 
 //
 // Close the serial port.
@@ -95,6 +115,8 @@ void radio_connect()
     const char *ident;
     int i;
 
+    usb_serial[0] = 0;
+
     // Try TYT MD family.
     ident = dfu_init(0x0483, 0xdf11);
     if (! ident) {
@@ -159,10 +181,197 @@ void radio_list()
     }
 }
 
+//
+// Get the prefix of cache file names for the connected radio:
+// model and serial number of the USB device.
+// Return 0 when the radio cannot be identified.
+//
+static int cache_prefix(char *path, int size)
+{
+    char dir[900];
+    int len, i;
+
+    if (plan_flag || ! usb_serial[0] || ! cache_dir(dir, sizeof(dir)))
+        return 0;
+
+    // Letters and digits only.
+    len = snprintf(path, size, "%s/", dir);
+    for (i=0; device->name[i] && len < size-1; i++) {
+        char c = device->name[i];
+        path[len++] = isalnum((unsigned char)c) ? c : '_';
+    }
+    if (len < size-1)
+        path[len++] = '-';
+    for (i=0; usb_serial[i] && len < size-1; i++) {
+        char c = usb_serial[i];
+        path[len++] = isalnum((unsigned char)c) ? c : '_';
+    }
+    path[len] = 0;
+    return 1;
+}
+
+//
+// Get the name of the cached image: the prefix, and a hash
+// of the key ranges of radio_mem (radio ID and probe block).
+// Return 0 when not available.
+//
+static int cache_name(char *path, int size)
+{
+    unsigned hash = 2166136261u, a;
+    int i, len;
+
+    if (cache_nkey == 0 || ! cache_prefix(path, size))
+        return 0;
+
+    // 32-bit FNV-1a.
+    for (i=0; i<cache_nkey; i++)
+        for (a=cache_key[i].start; a<cache_key[i].end; a++)
+            hash = (hash ^ radio_mem[a]) * 16777619u;
+
+    len = strlen(path);
+    snprintf(path + len, size - len, "-%08x.img", hash);
+    return 1;
+}
+
+//
+// Check whether the cached image of the radio is still valid.
+// The driver has read a few ranges of memory from the device:
+// the first range is the identity of the radio (name, ID),
+// the second is the probe block with the timestamp,
+// and others are sampled blocks.
+// The cache file is named by the model, the serial number
+// of the USB device, and the hash of the first two ranges.
+// When all ranges match the cached image, it is loaded
+// into radio_mem, and 1 is returned.
+// Radios without a serial number are not cached.
+//
+int radio_cache_lookup(const range_t *tab, int ntab)
+{
+    unsigned char *fresh;
+    int i;
+    FILE *img;
+
+    cache_hit = 0;
+    cache_nkey = (ntab < 2) ? ntab : 2;
+    memcpy(cache_key, tab, cache_nkey * sizeof(range_t));
+    if (! cache_name(cache_path, sizeof(cache_path))) {
+        cache_path[0] = 0;
+        cache_nkey = 0;
+        return 0;
+    }
+    if (! cache_enable)
+        return 0;
+
+    img = fopen(cache_path, "rb");
+    if (! img)
+        return 0;
+
+    // Load the cached image over the fresh ranges, and compare.
+    fresh = malloc(sizeof(radio_mem));
+    if (! fresh) {
+        fclose(img);
+        return 0;
+    }
+    memcpy(fresh, radio_mem, sizeof(radio_mem));
+    device->read_image(device, img);
+    fclose(img);
+
+    cache_hit = 1;
+    for (i=0; i<ntab; i++) {
+        if (memcmp(&fresh[tab[i].start], &radio_mem[tab[i].start],
+                   tab[i].end - tab[i].start) != 0) {
+            cache_hit = 0;
+            break;
+        }
+    }
+    if (! cache_hit)
+        memcpy(radio_mem, fresh, sizeof(radio_mem));
+    free(fresh);
+
+    if (cache_hit)
+        fprintf(stderr, "cached image '%s' is up to date,", cache_path);
+    return cache_hit;
+}
+
+//
+// Remove all cached images of the connected radio,
+// before its memory is overwritten.
+//
+static void cache_invalidate()
+{
+    char prefix[1024], *name, *path;
+    struct dirent *ent;
+    int len;
+    DIR *dir;
+
+    if (! cache_prefix(prefix, sizeof(prefix)))
+        return;
+    name = strrchr(prefix, '/') + 1;
+    len = strlen(name);
+    name[-1] = 0;
+    dir = opendir(prefix);
+    if (! dir)
+        return;
+    path = malloc(sizeof(prefix) + 256);
+    while ((ent = readdir(dir)) != 0) {
+        if (strncmp(ent->d_name, name, len) == 0 && ent->d_name[len] == '-' &&
+            strstr(ent->d_name, ".img")) {
+            sprintf(path, "%s/%s", prefix, ent->d_name);
+            unlink(path);
+        }
+    }
+    free(path);
+    closedir(dir);
+    cache_path[0] = 0;
+}
+
+//
+// Get the name of the snapshot of contacts database,
+// which was written to the connected radio: model and serial
+// number of the USB device.
+// Return 0 when not available.
+//
+int radio_csv_snapshot(char *path, int size)
+{
+    int len;
+
+    if (! cache_prefix(path, size))
+        return 0;
+    len = strlen(path);
+    snprintf(path + len, size - len, ".ids");
+    return 1;
+}
+
+//
+// Store the image of the connected radio into the cache.
+// The name is found again, as the key ranges could change.
+//
+static void cache_store()
+{
+    char path[sizeof(cache_path)];
+    FILE *img;
+
+    if (! cache_name(path, sizeof(path)))
+        return;
+    if (cache_path[0] && strcmp(path, cache_path) != 0)
+        unlink(cache_path);
+    strcpy(cache_path, path);
+    img = fopen(cache_path, "wb");
+    if (! img) {
+        perror(cache_path);
+        return;
+    }
+    device->save_image(device, img);
+    fclose(img);
+}
+
 //
 // Read firmware image from the device.
+// When cache_flag is set, a valid cached image of the radio
+// can be taken instead.  Such an image is never used as a base
+// for the delta upload.
 //
-void radio_download()
+void radio_download(int cache_flag)
 {
     radio_progress = 0;
     if (! trace_flag) {
@@ -170,19 +379,141 @@ void radio_download()
         fflush(stderr);
     }
 
+    // Random samples for validation of the cached image.
+    srand(now_usec());
+    cache_path[0] = 0;
+    cache_hit = 0;
+    cache_nkey = 0;
+    cache_enable = cache_flag;
+    memset(base_unread, 0, sizeof(base_unread));
+
+    progress_start("download", device->name);
     device->download(device);
+    progress_end();
+
+    // Whole image is ready.
+    radio_mem_ready(~0);
+
+    if (cache_hit) {
+        // Contents of the radio is not known exactly.
+        base_valid = 0;
+    } else {
+        // Remember the image, to skip the next download.
+        cache_store();
+
+        // Keep a copy, to upload only the changes.
+        memcpy(radio_base, radio_mem, sizeof(radio_mem));
+        base_valid = 1;
+    }
 
     if (! trace_flag)
         fprintf(stderr, " done.\n");
 }
 
+//
+// Publish the number of bytes of radio_mem, which are downloaded.
+// Single writer, many readers: no lock is needed.
+//
+void radio_mem_ready(unsigned nbytes)
+{
+    __atomic_store_n(&mem_ready, nbytes, __ATOMIC_RELEASE);
+
+    if (clone_fd >= 0 && nbytes != ~0u && nbytes > clone_sent) {
+        // Stream the new bytes to the target radio.
+        radio_mem_publish(clone_sent, nbytes);
+        clone_sent = nbytes;
+    }
+}
+
+//
+// Wait until the given number of bytes of radio_mem is downloaded.
+//
+void radio_mem_wait(unsigned nbytes)
+{
+    while (__atomic_load_n(&mem_ready, __ATOMIC_ACQUIRE) < nbytes)
+        mdelay(1);
+}
+
+//
+// Mark bytes of radio_mem, which the download filled in
+// instead of reading from the device.  Their contents on the radio
+// are not known, so they always count as changed.
+//
+void radio_mem_unread(unsigned start, unsigned nbytes)
+{
+    unsigned first = start / BASE_GRANULE;
+    unsigned last = (start + nbytes + BASE_GRANULE - 1) / BASE_GRANULE;
+
+    if (nbytes > 0)
+        bitmap_set_range(base_unread, first, last - first);
+}
+
+//
+// Check whether the given bytes of radio_mem differ
+// from the downloaded image.
+//
+int radio_mem_changed(unsigned start, unsigned nbytes)
+{
+    unsigned last;
+
+    if (! base_valid)
+        return 1;
+    if (nbytes == 0)
+        return 0;
+
+    // Bytes, which were not read, are unknown.
+    // Scan only the granules of this range.
+    last = (start + nbytes - 1) / BASE_GRANULE;
+    if (bitmap_next_set(base_unread, last + 1, start / BASE_GRANULE) >= 0)
+        return 1;
+    return memcmp(&radio_mem[start], &radio_base[start], nbytes) != 0;
+}
+
+//
+// Build an ordered list of changed spans in range start...finish-1.
+// Granule is the unit of write: spans are aligned to it,
+// and adjacent spans are merged.  When the table is full,
+// the last span is extended, which only costs extra writes.
+// Return the number of spans.
+//
+int radio_dirty_ranges(unsigned start, unsigned finish, unsigned granule,
+                       range_t *tab, int maxtab)
+{
+    unsigned addr, n;
+    int ntab = 0;
+
+    for (addr=start; addr<finish; addr+=n) {
+        n = granule - addr % granule;
+        if (n > finish - addr)
+            n = finish - addr;
+        if (! radio_mem_changed(addr, n))
+            continue;
+
+        if (ntab > 0 && (tab[ntab-1].end == addr || ntab == maxtab)) {
+            // Merge with previous span.
+            tab[ntab-1].end = addr + n;
+        } else {
+            tab[ntab].start = addr;
+            tab[ntab].end = addr + n;
+            ntab++;
+        }
+    }
+    return ntab;
+}
+
 //
 // Write firmware image to the device.
 //
 void radio_upload(int cont_flag)
 {
-    // Check for compatibility.
-    if (! device->is_compatible(device)) {
+    if (! device->upload) {
+        fprintf(stderr, "%s does not support upload.\n", device->name);
+        exit(-1);
+    }
+
+    // Check for compatibility.  For clone, the image is still
+    // being received: the model of the source radio is checked instead.
+    if (! clone_target && ! device->is_compatible(device)) {
         fprintf(stderr, "Incompatible image - cannot upload.\n");
         exit(-1);
     }
@@ -191,7 +522,16 @@ void radio_upload(int cont_flag)
         fprintf(stderr, "Write device: ");
         fflush(stderr);
     }
+    // Cached images are stale from now on.
+    cache_invalidate();
+
+    progress_start("upload", device->name);
     device->upload(device, cont_flag);
+    progress_end();
+
+    // The radio now holds this image, when all of it is received.
+    radio_mem_wait(~0u);
+    cache_store();
 
     if (! trace_flag)
         fprintf(stderr, " done.\n");
@@ -297,57 +637,35 @@ void radio_save_image(const char *filename)
 
 
 //
-// Loop over all known radios and see if the config file can be parsed.
+// Find radio by name, as printed in the Radio: line of configuration.
 //
-void radio_validate_config(const char *filename) {
-  int i = 0;
-  FILE *conf;
-  char line[256];
-
-  conf = fopen(filename, "r");
-  if (! conf) {
-    perror(filename);
-    exit(-1);
-  }
+static radio_device_t *find_radio(const char *name)
+{
+    int i;
 
-  // First, find out which radio it is.
-  while (fgets(line, sizeof(line), conf)) {
-    if (strstr(line, "Radio:")) {
-      for (i = 0; radio_tab[i].ident; i++) {
-        if (strstr(line, radio_tab[i].ident)) goto found;
-      }
+    for (i=0; radio_tab[i].ident; i++) {
+        if (strcasecmp(name, radio_tab[i].device->name) == 0)
+            return radio_tab[i].device;
     }
-  }
-  fprintf(stderr, "Couldn't idenfity radio type from config file\n");
-  exit(-1);
-
- found:
-
-  fprintf(stderr, "Identified radio from config file as: %s\n", radio_tab[i].ident);
-  fclose(conf);
-  device = radio_tab[i].device;
-  radio_parse_config(filename);
-  fprintf(stderr, "Configuration validated successfully for %s\n", radio_tab[i].ident);
-  exit(0);
+    for (i=0; radio_tab[i].ident; i++) {
+        if (strstr(name, radio_tab[i].ident))
+            return radio_tab[i].device;
+    }
+    return 0;
 }
 
 //
-// Read the configuration from text file, and modify the firmware.
+// Parse the configuration text, and modify the firmware.
+// When device is not known, it is identified from the Radio: line,
+// which must precede all other parameters and tables.
 //
-void radio_parse_config(const char *filename)
+static void parse_config(FILE *conf)
 {
-    FILE *conf;
     char line [256], *p, *v;
     int table_id = 0, table_dirty = 0;
 
-    fprintf(stderr, "Read configuration from file '%s'.\n", filename);
-    conf = fopen(filename, "r");
-    if (! conf) {
-        perror(filename);
-        exit(-1);
-    }
-
-    device->channel_count = 0;
+    if (device)
+        device->channel_count = 0;
     while (fgets(line, sizeof(line), conf)) {
         line[sizeof(line)-1] = 0;
 
@@ -374,6 +692,8 @@ void radio_parse_config(const char *filename)
             v = strchr(p, ':');
             if (! v) {
                 // Table header: get table type.
+                if (! device)
+                    goto noradio;
                 table_id = device->parse_header(device, p);
                 if (! table_id) {
 badline:            fprintf(stderr, "Invalid line: '%s'\n", line);
@@ -390,6 +710,18 @@ badline:            fprintf(stderr, "Invalid line: '%s'\n", line);
             while (*v == ' ' || *v == '\t')
                 v++;
 
+            if (! device) {
+                // Validation: identify radio by the first Radio: line.
+                if (strcasecmp(p, "Radio") != 0)
+                    goto noradio;
+                device = find_radio(v);
+                if (! device) {
+                    fprintf(stderr, "Unrecognized radio '%s'.\n", v);
+                    exit(-1);
+                }
+                fprintf(stderr, "Identified radio from config file as: %s\n", device->name);
+                device->channel_count = 0;
+            }
             device->parse_parameter(device, p, v);
 
         } else {
@@ -410,10 +742,333 @@ badline:            fprintf(stderr, "Invalid line: '%s'\n", line);
             table_dirty = 1;
         }
     }
-    fclose(conf);
+    if (! device) {
+noradio:
+        fprintf(stderr, "Couldn't identify radio type from config file\n");
+        exit(-1);
+    }
     device->update_timestamp(device);
 }
 
+//
+// Read the configuration from text file, and modify the firmware.
+//
+void radio_parse_config(const char *filename)
+{
+    FILE *conf;
+
+    fprintf(stderr, "Read configuration from file '%s'.\n", filename);
+    conf = fopen(filename, "r");
+    if (! conf) {
+        perror(filename);
+        exit(-1);
+    }
+    parse_config(conf);
+    fclose(conf);
+}
+
+//
+// Check that the config file can be parsed successfully for any radio.
+// The radio type is identified from the first Radio: line.
+//
+void radio_validate_config(const char *filename)
+{
+    device = 0;
+    radio_parse_config(filename);
+    fprintf(stderr, "Configuration validated successfully for %s\n", device->name);
+}
+
+//
+// Job of bulk validation: one config file.
+//
+typedef struct {
+    char *filename;
+    int pid;                    // Worker process, or 0
+    FILE *log;                  // Messages of the worker, while it runs
+    char *message;              // Last message of the worker
+    unsigned long long start;   // Start time, usec
+    unsigned usec;              // Elapsed time
+    int ok;                     // Validated successfully
+} validate_job_t;
+
+//
+// Append config file names to the list of jobs.
+// Directories are scanned for *.conf files.
+//
+static int add_validate_jobs(const char *name, validate_job_t **jobs, int njobs)
+{
+    DIR *dir;
+    struct dirent *ent;
+
+    dir = opendir(name);
+    if (! dir) {
+        *jobs = realloc(*jobs, (njobs + 1) * sizeof(**jobs));
+        memset(&(*jobs)[njobs], 0, sizeof(**jobs));
+        (*jobs)[njobs].filename = strdup(name);
+        return njobs + 1;
+    }
+    while ((ent = readdir(dir)) != 0) {
+        int len = strlen(ent->d_name);
+
+        if (len <= 5 || strcmp(ent->d_name + len - 5, ".conf") != 0)
+            continue;
+
+        char *path = malloc(strlen(name) + len + 2);
+        sprintf(path, "%s/%s", name, ent->d_name);
+        njobs = add_validate_jobs(path, jobs, njobs);
+        free(path);
+    }
+    closedir(dir);
+    return njobs;
+}
+
+//
+// Compare jobs by file name, for qsort().
+//
+static int compare_jobs(const void *pa, const void *pb)
+{
+    const validate_job_t *a = pa, *b = pb;
+
+    return strcmp(a->filename, b->filename);
+}
+
+#ifndef MINGW32
+//
+// Get the last line of worker messages, for the report.
+//
+static void last_message(FILE *log, char *buf, int size)
+{
+    char line[256];
+
+    buf[0] = 0;
+    if (! log)
+        return;
+    rewind(log);
+    while (fgets(line, sizeof(line), log)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0])
+            snprintf(buf, size, "%s", line);
+    }
+}
+#endif
+
+//
+// Validate a list of config files or directories.
+// Every file is checked by a separate worker process with its own
+// memory image, up to one worker per processor core.
+// Print aggregated report, and return the number of failed files.
+//
+int radio_validate_configs(int nnames, char **names)
+{
+    validate_job_t *jobs = 0;
+    int njobs = 0, nfailed = 0, i;
+    unsigned long long start = now_usec();
+
+    for (i=0; i<nnames; i++)
+        njobs = add_validate_jobs(names[i], &jobs, njobs);
+    qsort(jobs, njobs, sizeof(*jobs), compare_jobs);
+
+#ifdef MINGW32
+    // No fork(): validate one by one. Errors terminate the program.
+    for (i=0; i<njobs; i++) {
+        jobs[i].start = now_usec();
+        radio_validate_config(jobs[i].filename);
+        jobs[i].usec = now_usec() - jobs[i].start;
+        jobs[i].ok = 1;
+    }
+#else
+    int nworkers = parallel_nchunks(njobs, 1), nrunning = 0, next = 0;
+
+    fflush(stdout);
+    fflush(stderr);
+    while (next < njobs || nrunning > 0) {
+        // Start workers.
+        while (next < njobs && nrunning < nworkers) {
+            validate_job_t *job = &jobs[next++];
+
+            job->log = tmpfile();
+            job->start = now_usec();
+            job->pid = fork();
+            if (job->pid < 0) {
+                perror("fork");
+                exit(-1);
+            }
+            if (job->pid == 0) {
+                // Worker: redirect messages, and validate.
+                int null = open("/dev/null", O_WRONLY);
+
+                if (null < 0 || dup2(null, 1) < 0)
+                    _exit(-1);
+                if (job->log)
+                    dup2(fileno(job->log), 2);
+                radio_validate_config(job->filename);
+                fflush(stderr);
+                _exit(0);
+            }
+            nrunning++;
+        }
+
+        // Wait for any worker to finish.
+        int status, pid = wait(&status);
+        if (pid < 0) {
+            perror("wait");
+            exit(-1);
+        }
+        for (i=0; i<njobs; i++) {
+            if (jobs[i].pid == pid) {
+                jobs[i].usec = now_usec() - jobs[i].start;
+                jobs[i].ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                jobs[i].pid = 0;
+                nrunning--;
+
+                // Keep only the message: a large batch
+                // would run out of file descriptors.
+                if (jobs[i].log) {
+                    char msg[256];
+
+                    last_message(jobs[i].log, msg, sizeof(msg));
+                    jobs[i].message = strdup(msg);
+                    fclose(jobs[i].log);
+                    jobs[i].log = 0;
+                }
+                break;
+            }
+        }
+    }
+#endif
+
+    // Report.
+    for (i=0; i<njobs; i++) {
+        const char *message = jobs[i].message;
+
+        printf("%-4s %4u.%03u sec  %s", jobs[i].ok ? "OK" : "FAIL",
+            jobs[i].usec / 1000000, jobs[i].usec / 1000 % 1000, jobs[i].filename);
+        if (! jobs[i].ok)
+            printf(": %s", (message && message[0]) ? message : "Crashed");
+        printf("\n");
+        if (! jobs[i].ok)
+            nfailed++;
+        free(jobs[i].message);
+        free(jobs[i].filename);
+    }
+    unsigned usec = now_usec() - start;
+    printf("Validated %d files: %d passed, %d failed, %u.%03u sec total.\n",
+        njobs, njobs - nfailed, nfailed, usec / 1000000, usec / 1000 % 1000);
+    free(jobs);
+    return nfailed;
+}
+
+//
+// Make file name from serial number or port name:
+// replace all characters except letters and digits by underscore.
+//
+static void stamp_filename(char *name, int size, const char *serial, const char *suffix)
+{
+    const char *p;
+    int n = 0;
+
+    for (p=serial; *p && n < size - 16; p++)
+        name[n++] = isalnum((unsigned char)*p) ? *p : '_';
+    strcpy(name + n, suffix);
+}
+
+//
+// Save the list of ranges, patched over the base image.
+//
+static void save_ranges(const char *filename, const range_t *tab, int ntab)
+{
+    FILE *out;
+    int i;
+
+    out = fopen(filename, "w");
+    if (! out) {
+        perror(filename);
+        exit(-1);
+    }
+    fprintf(out, "# Ranges patched over the base image: start end (exclusive), hex.\n");
+    for (i=0; i<ntab; i++)
+        fprintf(out, "%#07x %#07x\n", tab[i].start, tab[i].end);
+    fclose(out);
+}
+
+//
+// Produce per-radio images from the current image, which is the base.
+// Every line of the CSV file contains: serial or port, Radio ID, Name,
+// and optionally Intro Line 1 and Intro Line 2.
+// Only these fields are patched, through the parse_parameter routine
+// of the driver.  For every radio, two files are created:
+// <serial>.img with the image, and <serial>.ranges with the list
+// of byte ranges, which differ from the base image.
+//
+void radio_stamp_images(const char *filename)
+{
+    static const char *param[] = { "ID", "Name", "Intro Line 1", "Intro Line 2" };
+    FILE *csv;
+    char line[256], name[256], *field[5], *p;
+    range_t tab[64];
+    int lineno = 0, nfields, ntab, count = 0, i;
+
+    fprintf(stderr, "Read radio list from file '%s'.\n", filename);
+    csv = fopen(filename, "r");
+    if (! csv) {
+        perror(filename);
+        exit(-1);
+    }
+
+    // The base image is compiled only once.
+    memcpy(radio_base, radio_mem, sizeof(radio_mem));
+    memset(base_unread, 0, sizeof(base_unread));
+    base_valid = 1;
+
+    while (fgets(line, sizeof(line), csv)) {
+        lineno++;
+
+        // Split by commas, and strip spaces.
+        nfields = 0;
+        for (p=line; nfields < 5; ) {
+            char *end;
+
+            while (*p == ' ' || *p == '\t')
+                p++;
+            field[nfields++] = p;
+            end = p + strcspn(p, ",\r\n");
+            p = (*end == ',') ? end + 1 : 0;
+            while (end > field[nfields-1] && (end[-1] == ' ' || end[-1] == '\t'))
+                end--;
+            *end = 0;
+            if (! p)
+                break;
+        }
+
+        // Ignore comments, empty lines and the header.
+        if (field[0][0] == '#' || field[0][0] == 0)
+            continue;
+        if (nfields < 3) {
+            fprintf(stderr, "%s:%d: Need serial, ID and name.\n", filename, lineno);
+            exit(-1);
+        }
+        if (field[1][0] < '0' || field[1][0] > '9')
+            continue;
+
+        // Start from the base image, and patch per-radio fields.
+        memcpy(radio_mem, radio_base, sizeof(radio_mem));
+        for (i=1; i<nfields; i++) {
+            if (field[i][0] != 0)
+                device->parse_parameter(device, (char*)param[i-1], field[i]);
+        }
+
+        stamp_filename(name, sizeof(name), field[0], ".img");
+        radio_save_image(name);
+
+        ntab = radio_dirty_ranges(0, sizeof(radio_mem), 16, tab, 64);
+        stamp_filename(name, sizeof(name), field[0], ".ranges");
+        save_ranges(name, tab, ntab);
+        count++;
+    }
+    fclose(csv);
+    fprintf(stderr, "Stamped %d images.\n", count);
+}
+
 //
 // Print full information about the device configuration.
 //
@@ -436,6 +1091,48 @@ void radio_print_config(FILE *out, int verbose)
     device->print_config(device, out, verbose);
 }
 
+#ifndef MINGW32
+static pthread_t print_thread;
+static FILE *print_out;
+static int print_verbose;
+
+static void *print_config_thread(void *arg)
+{
+    radio_print_config(print_out, print_verbose);
+    return 0;
+}
+#endif
+
+//
+// Start printing the configuration in a separate thread,
+// while the image is being downloaded.
+// Return 0 when the device does not support streaming decode.
+//
+int radio_print_config_async(FILE *out, int verbose)
+{
+#ifndef MINGW32
+    if (device->stream_decode) {
+        print_out = out;
+        print_verbose = verbose;
+        radio_mem_ready(0);
+        if (pthread_create(&print_thread, 0, print_config_thread, 0) == 0)
+            return 1;
+        radio_mem_ready(~0);
+    }
+#endif
+    return 0;
+}
+
+//
+// Wait until the configuration is printed by radio_print_config_async().
+//
+void radio_print_config_wait()
+{
+#ifndef MINGW32
+    pthread_join(print_thread, 0);
+#endif
+}
+
 //
 // Check the configuration is correct.
 //
@@ -447,6 +1144,17 @@ void radio_verify_config()
     }
 }
 
+//
+// Terminate when the device cannot update contacts database.
+//
+void radio_check_csv()
+{
+    if (!device->write_csv) {
+        fprintf(stderr, "%s does not support CSV database.\n", device->name);
+        exit(-1);
+    }
+}
+
 //
 // Update contacts database on the device.
 //
@@ -454,22 +1162,289 @@ void radio_write_csv(const char *filename)
 {
     FILE *csv;
 
-    if (!device->write_csv) {
+    radio_check_csv();
+    csv = fopen(filename, "r");
+    if (! csv) {
+        perror(filename);
+        exit(-1);
+    }
+    fprintf(stderr, "Read file '%s'.\n", filename);
+
+    progress_start("write_csv", device->name);
+    device->write_csv(device, csv);
+    progress_end();
+    fclose(csv);
+}
+
+//
+// Export contacts database from the device.
+//
+void radio_read_csv(const char *filename)
+{
+    FILE *csv;
+
+    if (!device->read_csv) {
         fprintf(stderr, "%s does not support CSV database.\n", device->name);
         return;
     }
 
-    csv = fopen(filename, "r");
+    csv = fopen(filename, "w");
     if (! csv) {
         perror(filename);
         return;
     }
-    fprintf(stderr, "Read file '%s'.\n", filename);
+    fprintf(stderr, "Write file '%s'.\n", filename);
 
-    device->write_csv(device, csv);
+    progress_start("read_csv", device->name);
+    device->read_csv(device, csv);
+    progress_end();
     fclose(csv);
 }
 
+//
+// Probe the address space of the radio, and write the map of live memory.
+//
+void radio_discover_map(const char *filename)
+{
+    FILE *out;
+
+    if (!device->discover_map) {
+        fprintf(stderr, "%s does not support memory discovery.\n", device->name);
+        return;
+    }
+
+    out = fopen(filename, "w");
+    if (! out) {
+        perror(filename);
+        return;
+    }
+    fprintf(stderr, "Write file '%s'.\n", filename);
+
+    progress_start("discover", device->name);
+    device->discover_map(device, out);
+    progress_end();
+    fclose(out);
+}
+
+//
+// Benchmark the link to the radio, and save the best parameters.
+//
+void radio_linktest()
+{
+    if (!device->linktest) {
+        fprintf(stderr, "%s does not support link test.\n", device->name);
+        return;
+    }
+    progress_start("linktest", device->name);
+    device->linktest(device);
+    progress_end();
+}
+
+#ifndef MINGW32
+//
+// Write or read all the bytes through the pipe.
+// Return 0 on success, -1 on error or end of file.
+//
+static int pipe_write(int fd, const void *data, unsigned nbytes)
+{
+    const char *p = data;
+
+    while (nbytes > 0) {
+        int n = write(fd, p, nbytes);
+        if (n <= 0)
+            return -1;
+        p += n;
+        nbytes -= n;
+    }
+    return 0;
+}
+
+static int pipe_read(int fd, void *data, unsigned nbytes)
+{
+    char *p = data;
+
+    while (nbytes > 0) {
+        int n = read(fd, p, nbytes);
+        if (n <= 0)
+            return -1;
+        p += n;
+        nbytes -= n;
+    }
+    return 0;
+}
+#endif
+
+//
+// Send a range of radio_mem to the target radio of clone.
+// Downloads call it for the parts, which the upload needs
+// ahead of the sequential data, like bitmaps of valid items.
+// Without clone, nothing is done.
+//
+void radio_mem_publish(unsigned start, unsigned end)
+{
+#ifndef MINGW32
+    unsigned hdr[2] = { start, end };
+
+    if (clone_fd < 0)
+        return;
+    if (pipe_write(clone_fd, hdr, sizeof(hdr)) < 0 ||
+        pipe_write(clone_fd, &radio_mem[start], end - start) < 0) {
+        fprintf(stderr, "\nTarget radio failed.\n");
+        exit(-1);
+    }
+#endif
+}
+
+#ifndef MINGW32
+//
+// Receive the image from the source radio into radio_mem,
+// and publish the contiguous part, which is ready for upload.
+//
+static void *clone_receive(void *arg)
+{
+    int fd = *(int*) arg;
+    unsigned hdr[2], ready = 0;
+
+    for (;;) {
+        if (pipe_read(fd, hdr, sizeof(hdr)) < 0) {
+            fprintf(stderr, "\nSource radio failed.\n");
+            exit(-1);
+        }
+        if (hdr[0] == ~0u) {
+            // End of image.
+            break;
+        }
+        if (hdr[0] > hdr[1] || hdr[1] > sizeof(radio_mem) ||
+            pipe_read(fd, &radio_mem[hdr[0]], hdr[1] - hdr[0]) < 0) {
+            fprintf(stderr, "\nSource radio failed.\n");
+            exit(-1);
+        }
+        if (hdr[0] <= ready && hdr[1] > ready) {
+            ready = hdr[1];
+            radio_mem_ready(ready);
+        }
+    }
+    radio_mem_ready(~0);
+    return 0;
+}
+#endif
+
+//
+// Copy the codeplug from one radio to another radio of the same model.
+// The source radio is a separate process, which streams every
+// block through a pipe as soon as it is read: the upload to the target
+// radio waits for each block, so both transfers overlap.
+// Radios are enumerated once, and each process connects to its
+// radio by USB location.
+//
+void radio_clone(int source_unit)
+{
+#ifdef MINGW32
+    fprintf(stderr, "Clone is not supported on Windows.\n");
+    exit(-1);
+#else
+    // VID:PID of USB devices, tried by radio_connect().
+    static const unsigned usb_ids[] = {
+        0x0483df11, 0x15a20073, 0x28e9018a, 0x10c4ea60,
+        0x1a867523, 0x067b2303, 0x04036001, 0,
+    };
+    char location[8][32];
+    char name[64];
+    int fd[2], status, nloc;
+    pthread_t receiver;
+    pid_t pid;
+    unsigned end[2] = { ~0u, ~0u };
+
+    nloc = usb_find_locations(usb_ids, location, 8);
+    if (nloc != 2) {
+        fprintf(stderr, "Need two radios attached for clone, found %d.\n", nloc);
+        exit(-1);
+    }
+    fprintf(stderr, "Clone from USB %s to USB %s.\n",
+        location[source_unit], location[!source_unit]);
+
+    if (pipe(fd) < 0) {
+        perror("pipe");
+        exit(-1);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(-1);
+    }
+    if (pid == 0) {
+        // Source: read the radio, and stream the image.
+        close(fd[0]);
+        usb_location = location[source_unit];
+        radio_connect();
+        if (! device->upload) {
+            // Both radios are of the same model.
+            fprintf(stderr, "%s does not support upload.\n", device->name);
+            exit(-1);
+        }
+
+        memset(name, 0, sizeof(name));
+        strncpy(name, device->name, sizeof(name) - 1);
+        if (pipe_write(fd[1], name, sizeof(name)) < 0)
+            exit(-1);
+
+        clone_fd = fd[1];
+        clone_sent = 0;
+        radio_download(0);
+
+        // Send the rest of the image: skip the tail,
+        // which is still zero on both sides.
+        unsigned nbytes = sizeof(radio_mem);
+        while (nbytes > clone_sent && radio_mem[nbytes-1] == 0)
+            nbytes--;
+        if (nbytes > clone_sent)
+            radio_mem_publish(clone_sent, nbytes);
+        if (pipe_write(fd[1], end, sizeof(end)) < 0)
+            exit(-1);
+        radio_disconnect();
+        fflush(stderr);
+        _exit(0);
+    }
+
+    // Target: write the image while it is being received.
+    close(fd[1]);
+    usb_location = location[!source_unit];
+    radio_connect();
+    if (pipe_read(fd[0], name, sizeof(name)) < 0) {
+        fprintf(stderr, "Cannot connect to the source radio.\n");
+        kill(pid, SIGTERM);
+        exit(-1);
+    }
+    if (strcmp(name, device->name) != 0) {
+        fprintf(stderr, "Cannot clone %s to %s.\n", name, device->name);
+        kill(pid, SIGTERM);
+        exit(-1);
+    }
+
+    radio_mem_ready(0);
+    if (pthread_create(&receiver, 0, clone_receive, &fd[0]) != 0) {
+        perror("pthread_create");
+        kill(pid, SIGTERM);
+        exit(-1);
+    }
+    clone_target = 1;
+    radio_upload(0);
+    clone_target = 0;
+    pthread_join(receiver, 0);
+    close(fd[0]);
+
+    if (waitpid(pid, &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Source radio failed.\n");
+        exit(-1);
+    }
+    radio_disconnect();
+    fprintf(stderr, "Cloned %s.\n", device->name);
+#endif
+}
+
 //
 // Check for compatible radio model.
 //
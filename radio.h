@@ -39,8 +39,9 @@ void radio_disconnect(void);
 
 //
 // Read firmware image from the device.
+// When cache_flag is set, a valid cached image can be taken instead.
 //
-void radio_download(void);
+void radio_download(int cache_flag);
 
 //
 // Write firmware image to the device.
@@ -57,6 +58,57 @@ void radio_print_version(FILE *out);
 //
 void radio_print_config(FILE *out, int verbose);
 
+//
+// Start printing the configuration in a separate thread,
+// while the image is being downloaded.
+// Return 0 when the device does not support streaming decode.
+//
+int radio_print_config_async(FILE *out, int verbose);
+
+//
+// Wait until the configuration is printed by radio_print_config_async().
+//
+void radio_print_config_wait(void);
+
+//
+// Streaming decode: download publishes the number of bytes
+// of radio_mem, which are ready; print_config waits for them.
+//
+void radio_mem_ready(unsigned nbytes);
+void radio_mem_wait(unsigned nbytes);
+
+//
+// Send a range of radio_mem to the target radio of clone,
+// ahead of the sequential data.
+//
+void radio_mem_publish(unsigned start, unsigned end);
+
+//
+// Get the name of the snapshot of contacts database,
+// which was written to the connected radio.
+// Return 0 when not available.
+//
+int radio_csv_snapshot(char *path, int size);
+
+//
+// Compare radio_mem with the image, downloaded from the device.
+// Without a downloaded image, all memory is considered changed,
+// and so are the bytes, which the download skipped.
+//
+struct range_t;
+void radio_mem_unread(unsigned start, unsigned nbytes);
+int radio_mem_changed(unsigned start, unsigned nbytes);
+int radio_dirty_ranges(unsigned start, unsigned finish, unsigned granule,
+                       struct range_t *tab, int maxtab);
+
+//
+// Check whether the cached image of the radio matches the ranges,
+// just read from the device; the first range is the identity
+// of the radio, the second is the probe block.
+// On success, load the cached image and return 1.
+//
+int radio_cache_lookup(const struct range_t *tab, int ntab);
+
 //
 // Read firmware image from the binary file.
 //
@@ -77,16 +129,57 @@ void radio_parse_config(const char *filename);
 //
 void radio_validate_config(const char *filename);
 
+//
+// Validate many config files or directories in parallel.
+// Print a report, and return the number of failed files.
+//
+int radio_validate_configs(int nnames, char **names);
+
 //
 // Check the configuration.
 //
 void radio_verify_config(void);
 
+//
+// Produce per-radio images from the base image and a CSV list
+// of serial numbers, IDs and names.
+//
+void radio_stamp_images(const char *filename);
+
+//
+// Build or update the index of archived images, and query it.
+//
+int radio_index_images(const char *filename, int nnames, char **names);
+int radio_query_index(const char *filename, const char *query);
+
 //
 // Update CSV contacts database.
+// Terminate when the device does not support it.
 //
+void radio_check_csv(void);
 void radio_write_csv(const char *filename);
 
+//
+// Export contacts database from the radio to CSV file.
+//
+void radio_read_csv(const char *filename);
+
+//
+// Probe the address space of the radio, and write the map of live memory.
+//
+void radio_discover_map(const char *filename);
+
+//
+// Benchmark the link to the radio with harmless reads.
+//
+void radio_linktest(void);
+
+//
+// Copy the codeplug from the radio with given USB unit
+// to another radio of the same model, in one pass.
+//
+void radio_clone(int source_unit);
+
 //
 // List all supported radios.
 //
@@ -116,7 +209,11 @@ struct _radio_device_t {
     int (*parse_row)(radio_device_t *radio, int table_id, int first_row, char *line);
     void (*update_timestamp)(radio_device_t *radio);
     void (*write_csv)(radio_device_t *radio, FILE *csv);
+    void (*read_csv)(radio_device_t *radio, FILE *csv);
+    int stream_decode;              // Can print_config while downloading
     int channel_count;
+    void (*discover_map)(radio_device_t *radio, FILE *out);
+    void (*linktest)(radio_device_t *radio);
 };
 
 extern radio_device_t radio_md380;      // TYT MD-380
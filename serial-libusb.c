@@ -0,0 +1,639 @@
+/*
+ * Direct USB transport for serial radios, via libusb-1.0.
+ * Bypasses the tty layer for CDC ACM, CP210x and CH340 bridges.
+ *
+ * Copyright (C) 2018 Serge Vakulenko, KK6ABQ
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. The name of the author may not be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <libusb.h>
+#include "util.h"
+
+#define NXFER_IN        4                   // receive transfers in flight
+#define NXFER_OUT       4                   // transmit transfers in flight
+#define XFER_SIZE       1024                // buffer size of one transfer
+#define RING_SIZE       65536               // receive ring buffer, power of 2
+#define MAX_IFACES      4                   // interfaces to claim
+
+enum {
+    BRIDGE_CDC_ACM,                         // USB CDC ACM, e.g. Anytone 28e9:018a
+    BRIDGE_CP210X,                          // Silicon Labs CP210x
+    BRIDGE_CH340,                           // QinHeng CH340/CH341
+};
+
+static libusb_context *ctx = NULL;          // libusb context
+static libusb_device_handle *dev;           // libusb device
+static int bridge;                          // type of USB-serial bridge
+static int comm_iface;                      // control interface of CDC ACM
+static int ifaces[MAX_IFACES];              // claimed interfaces
+static int detached[MAX_IFACES];            // kernel driver was detached
+static int nifaces;                         // number of claimed interfaces
+static unsigned char ep_in, ep_out;         // bulk endpoints
+
+static struct libusb_transfer *xfer_in[NXFER_IN];
+static struct libusb_transfer *xfer_out[NXFER_OUT];
+static unsigned char buf_in[NXFER_IN][XFER_SIZE];
+static unsigned char buf_out[NXFER_OUT][XFER_SIZE];
+static volatile int busy_out[NXFER_OUT];    // transmit transfer submitted
+static volatile int pending_in;             // receive transfers submitted
+static volatile int pending_out;            // transmit transfers submitted
+static volatile int closing;                // do not resubmit on completion
+static volatile int usb_error;              // fatal transfer status
+
+static unsigned char ring[RING_SIZE];       // received data
+static volatile unsigned ring_head;         // write index
+static volatile unsigned ring_tail;         // read index
+
+//
+// Callback for receive transfers.
+// Append data to the ring buffer and resubmit.
+//
+static void read_callback(struct libusb_transfer *t)
+{
+    int i;
+
+    switch (t->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+        for (i=0; i<t->actual_length; i++) {
+            if (ring_head - ring_tail >= RING_SIZE) {
+                fprintf(stderr, "USB serial: receive buffer overflow\n");
+                break;
+            }
+            ring[ring_head++ & (RING_SIZE-1)] = t->buffer[i];
+        }
+        break;
+
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        break;
+
+    case LIBUSB_TRANSFER_CANCELLED:
+        pending_in--;
+        return;
+
+    default:
+        usb_error = t->status;
+        pending_in--;
+        return;
+    }
+
+    if (closing || libusb_submit_transfer(t) < 0)
+        pending_in--;
+}
+
+//
+// Callback for transmit transfers.
+// Release the buffer.
+//
+static void write_callback(struct libusb_transfer *t)
+{
+    int slot = (int)(long) t->user_data;
+
+    if (t->status != LIBUSB_TRANSFER_COMPLETED &&
+        t->status != LIBUSB_TRANSFER_CANCELLED) {
+        usb_error = t->status;
+    } else if (t->status == LIBUSB_TRANSFER_COMPLETED &&
+               t->actual_length != t->length) {
+        fprintf(stderr, "USB serial: short write %d bytes instead of %d\n",
+            t->actual_length, t->length);
+        usb_error = LIBUSB_TRANSFER_ERROR;
+    }
+    busy_out[slot] = 0;
+    pending_out--;
+}
+
+//
+// Process USB events for at most msec milliseconds.
+// Return -1 on fatal error.
+//
+static int handle_events(int msec)
+{
+    struct timeval tv;
+    int result;
+
+    tv.tv_sec = msec / 1000;
+    tv.tv_usec = msec % 1000 * 1000;
+    result = libusb_handle_events_timeout(ctx, &tv);
+    if (result < 0 && result != LIBUSB_ERROR_INTERRUPTED &&
+        result != LIBUSB_ERROR_TIMEOUT) {
+        fprintf(stderr, "USB serial: event error %d: %s\n",
+            result, libusb_strerror(result));
+        return -1;
+    }
+    if (usb_error) {
+        fprintf(stderr, "USB serial: transfer failed, status %d\n", usb_error);
+        return -1;
+    }
+    return 0;
+}
+
+//
+// Milliseconds elapsed since the given moment.
+//
+static int msec_since(const struct timeval *t0)
+{
+    struct timeval now;
+
+    gettimeofday(&now, 0);
+    return (now.tv_sec - t0->tv_sec) * 1000 + (now.tv_usec - t0->tv_usec) / 1000;
+}
+
+//
+// Send vendor or class request to the bridge.
+//
+static int control_out(int type, int request, int value, int index,
+    unsigned char *data, int len)
+{
+    int error = libusb_control_transfer(dev, type | LIBUSB_ENDPOINT_OUT,
+        request, value, index, data, len, 1000);
+
+    if (error < 0 && trace_flag > 0) {
+        fprintf(stderr, "USB serial: request %#x failed: %d: %s\n",
+            request, error, libusb_strerror(error));
+    }
+    return error;
+}
+
+//
+// Set line parameters: baud rate, 8n1.
+// Return -1 on error.
+//
+static int set_line(int baud_rate)
+{
+    unsigned char data[7];
+
+    switch (bridge) {
+    case BRIDGE_CP210X:
+        // IFC_ENABLE, SET_LINE_CTL=8n1, SET_BAUDRATE.
+        data[0] = baud_rate;
+        data[1] = baud_rate >> 8;
+        data[2] = baud_rate >> 16;
+        data[3] = baud_rate >> 24;
+        if (control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
+                0x00, 0x0001, ifaces[0], 0, 0) < 0 ||
+            control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
+                0x03, 0x0800, ifaces[0], 0, 0) < 0 ||
+            control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
+                0x1e, 0, ifaces[0], data, 4) < 0)
+            return -1;
+        return 0;
+
+    case BRIDGE_CH340: {
+        // Serial init, then baud rate divisor and LCR=8n1 with rx/tx enabled.
+        unsigned factor = 1532620800 / baud_rate;
+        unsigned divisor = 3;
+
+        while (factor > 0xfff0 && divisor > 0) {
+            factor >>= 3;
+            divisor--;
+        }
+        if (factor > 0xfff0)
+            return -1;
+        factor = 0x10000 - factor;
+
+        if (control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
+                0xa1, 0, 0, 0, 0) < 0 ||
+            control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
+                0x9a, 0x1312, (factor & 0xff00) | divisor, 0, 0) < 0 ||
+            control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
+                0x9a, 0x0f2c, factor & 0xff, 0, 0) < 0 ||
+            control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
+                0x9a, 0x2518, 0x00c3, 0, 0) < 0)
+            return -1;
+        return 0;
+    }
+
+    default:
+        // CDC SET_LINE_CODING: rate, 1 stop bit, no parity, 8 data bits.
+        data[0] = baud_rate;
+        data[1] = baud_rate >> 8;
+        data[2] = baud_rate >> 16;
+        data[3] = baud_rate >> 24;
+        data[4] = 0;
+        data[5] = 0;
+        data[6] = 8;
+        if (control_out(LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
+                0x20, 0, comm_iface, data, 7) < 0)
+            return -1;
+        return 0;
+    }
+}
+
+//
+// Set DTR and RTS modem control lines.
+//
+void serial_usb_set_lines(int dtr, int rts)
+{
+    if (! ctx)
+        return;
+
+    switch (bridge) {
+    case BRIDGE_CP210X:
+        // SET_MHS: values in bits 0-1, write masks in bits 8-9.
+        control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
+            0x07, 0x0300 | (dtr ? 1 : 0) | (rts ? 2 : 0), ifaces[0], 0, 0);
+        break;
+
+    case BRIDGE_CH340:
+        // Modem control lines are active low.
+        control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
+            0xa4, ~((dtr ? 0x20 : 0) | (rts ? 0x40 : 0)) & 0xffff, 0, 0, 0);
+        break;
+
+    default:
+        // CDC SET_CONTROL_LINE_STATE.
+        control_out(LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
+            0x22, (dtr ? 1 : 0) | (rts ? 2 : 0), comm_iface, 0, 0);
+        break;
+    }
+}
+
+//
+// Find bulk endpoints and the interfaces to claim.
+// Return -1 when the device has no suitable interface.
+//
+static int find_endpoints()
+{
+    struct libusb_config_descriptor *config;
+    int i, a, e;
+
+    if (libusb_get_active_config_descriptor(libusb_get_device(dev), &config) < 0)
+        return -1;
+
+    ep_in = ep_out = 0;
+    nifaces = 0;
+    comm_iface = -1;
+    for (i=0; i<config->bNumInterfaces && nifaces < MAX_IFACES; i++) {
+        const struct libusb_interface *iface = &config->interface[i];
+
+        for (a=0; a<iface->num_altsetting; a++) {
+            const struct libusb_interface_descriptor *alt = &iface->altsetting[a];
+            unsigned char in = 0, out = 0;
+
+            if (alt->bInterfaceClass == LIBUSB_CLASS_COMM) {
+                // CDC control interface.
+                comm_iface = alt->bInterfaceNumber;
+                ifaces[nifaces++] = alt->bInterfaceNumber;
+                break;
+            }
+            for (e=0; e<alt->bNumEndpoints; e++) {
+                const struct libusb_endpoint_descriptor *ep = &alt->endpoint[e];
+
+                if ((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_BULK)
+                    continue;
+                if (ep->bEndpointAddress & LIBUSB_ENDPOINT_IN)
+                    in = ep->bEndpointAddress;
+                else
+                    out = ep->bEndpointAddress;
+            }
+            if (in && out && ! ep_in) {
+                ep_in = in;
+                ep_out = out;
+                ifaces[nifaces++] = alt->bInterfaceNumber;
+                break;
+            }
+        }
+    }
+    libusb_free_config_descriptor(config);
+
+    if (! ep_in)
+        return -1;
+    if (bridge == BRIDGE_CDC_ACM && comm_iface < 0)
+        return -1;
+    return 0;
+}
+
+//
+// Release all resources.
+// Give the interfaces back to the kernel driver.
+//
+static void usb_cleanup()
+{
+    int i;
+
+    for (i=0; i<NXFER_IN; i++) {
+        if (xfer_in[i]) {
+            libusb_free_transfer(xfer_in[i]);
+            xfer_in[i] = 0;
+        }
+    }
+    for (i=0; i<NXFER_OUT; i++) {
+        if (xfer_out[i]) {
+            libusb_free_transfer(xfer_out[i]);
+            xfer_out[i] = 0;
+        }
+    }
+    for (i=nifaces-1; i>=0; i--) {
+        libusb_release_interface(dev, ifaces[i]);
+        if (detached[i])
+            libusb_attach_kernel_driver(dev, ifaces[i]);
+        detached[i] = 0;
+    }
+    nifaces = 0;
+    libusb_close(dev);
+    libusb_exit(ctx);
+    ctx = 0;
+}
+
+//
+// Get the location of the device: bus and port numbers,
+// as named in sysfs, like "1-1.4".  Return 0 when not known.
+//
+static int get_location(libusb_device *device, char *name, int size)
+{
+    uint8_t ports[8];
+    int nports, len, k;
+
+    nports = libusb_get_port_numbers(device, ports, sizeof(ports));
+    if (nports <= 0)
+        return 0;
+    len = snprintf(name, size, "%d", libusb_get_bus_number(device));
+    for (k=0; k<nports && len < size; k++)
+        len += snprintf(name + len, size - len, "%c%d", k ? '.' : '-', ports[k]);
+    return 1;
+}
+
+//
+// Find the device with given VID:PID at the given location.
+//
+static libusb_device_handle *open_location(int vid, int pid, const char *location)
+{
+    libusb_device **list, *found = 0;
+    libusb_device_handle *handle = 0;
+    struct libusb_device_descriptor desc;
+    char name[32];
+    ssize_t n, i;
+
+    n = libusb_get_device_list(ctx, &list);
+    if (n < 0)
+        return 0;
+    for (i=0; i<n; i++) {
+        if (libusb_get_device_descriptor(list[i], &desc) == 0 &&
+            desc.idVendor == vid && desc.idProduct == pid &&
+            get_location(list[i], name, sizeof(name)) &&
+            strcmp(name, location) == 0) {
+            found = list[i];
+            break;
+        }
+    }
+    if (found && libusb_open(found, &handle) < 0)
+        handle = 0;
+    libusb_free_device_list(list, 1);
+    return handle;
+}
+
+//
+// Open the USB-serial bridge directly, bypassing the tty driver.
+// Used only when the kernel driver can be detached.
+// The bridge is the one at the location of the selected tty device.
+// Return -1 when not possible: the caller falls back to the tty device.
+//
+int serial_usb_open(int vid, int pid, const char *location, int baud_rate)
+{
+    int i, error;
+
+    if (vid == 0x10c4 && pid == 0xea60) {
+        bridge = BRIDGE_CP210X;
+    } else if (vid == 0x1a86 && pid == 0x7523) {
+        bridge = BRIDGE_CH340;
+    } else if (vid == 0x28e9 && pid == 0x018a) {
+        bridge = BRIDGE_CDC_ACM;
+    } else {
+        // FTDI and PL2303 have their own framing: use the tty driver.
+        return -1;
+    }
+    if (! location) {
+        // Location of the tty device is not known.
+        return -1;
+    }
+
+    if (libusb_init(&ctx) < 0) {
+        ctx = 0;
+        return -1;
+    }
+    dev = open_location(vid, pid, location);
+    if (! dev) {
+        libusb_exit(ctx);
+        ctx = 0;
+        return -1;
+    }
+    if (find_endpoints() < 0) {
+        nifaces = 0;
+        usb_cleanup();
+        return -1;
+    }
+
+    // Take the interfaces from the kernel driver.
+    for (i=0; i<nifaces; i++) {
+        detached[i] = 0;
+        if (libusb_kernel_driver_active(dev, ifaces[i]) == 1) {
+            if (libusb_detach_kernel_driver(dev, ifaces[i]) < 0) {
+                if (trace_flag > 0)
+                    fprintf(stderr, "USB serial: cannot detach kernel driver\n");
+                nifaces = i;
+                usb_cleanup();
+                return -1;
+            }
+            detached[i] = 1;
+        }
+        error = libusb_claim_interface(dev, ifaces[i]);
+        if (error < 0) {
+            if (detached[i])
+                libusb_attach_kernel_driver(dev, ifaces[i]);
+            detached[i] = 0;
+            nifaces = i;
+            usb_cleanup();
+            return -1;
+        }
+    }
+
+    if (set_line(baud_rate) < 0) {
+        usb_cleanup();
+        return -1;
+    }
+
+    // Start receiving.
+    closing = 0;
+    usb_error = 0;
+    pending_in = 0;
+    pending_out = 0;
+    ring_head = ring_tail = 0;
+
+    // Allocate all transfers before submitting any.
+    for (i=0; i<NXFER_OUT; i++) {
+        xfer_out[i] = libusb_alloc_transfer(0);
+        busy_out[i] = 0;
+        if (! xfer_out[i]) {
+            usb_cleanup();
+            return -1;
+        }
+    }
+    for (i=0; i<NXFER_IN; i++) {
+        xfer_in[i] = libusb_alloc_transfer(0);
+        if (! xfer_in[i]) {
+            usb_cleanup();
+            return -1;
+        }
+    }
+    for (i=0; i<NXFER_IN; i++) {
+        libusb_fill_bulk_transfer(xfer_in[i], dev, ep_in,
+            buf_in[i], XFER_SIZE, read_callback, 0, 0);
+        if (libusb_submit_transfer(xfer_in[i]) == 0)
+            pending_in++;
+    }
+    if (pending_in == 0) {
+        usb_cleanup();
+        return -1;
+    }
+
+    if (trace_flag > 0) {
+        fprintf(stderr, "USB serial: direct bulk transport, endpoints %02x/%02x, %d baud\n",
+            ep_in, ep_out, baud_rate);
+    }
+    return 0;
+}
+
+//
+// Send data to device.
+// Up to NXFER_OUT transfers can be in flight.
+// Return number of bytes, or -1 on error.
+//
+int serial_usb_write(const unsigned char *data, int len)
+{
+    int n, i, chunk;
+
+    for (n=0; n<len; n+=chunk) {
+        chunk = (len - n > XFER_SIZE) ? XFER_SIZE : len - n;
+
+        // Find a free transmit buffer.
+        for (;;) {
+            for (i=0; i<NXFER_OUT; i++)
+                if (! busy_out[i])
+                    break;
+            if (i < NXFER_OUT)
+                break;
+            if (handle_events(100) < 0)
+                return -1;
+        }
+
+        memcpy(buf_out[i], data + n, chunk);
+        libusb_fill_bulk_transfer(xfer_out[i], dev, ep_out,
+            buf_out[i], chunk, write_callback, (void*)(long) i, 1000);
+        busy_out[i] = 1;
+        pending_out++;
+        if (libusb_submit_transfer(xfer_out[i]) < 0) {
+            busy_out[i] = 0;
+            pending_out--;
+            return -1;
+        }
+    }
+    return len;
+}
+
+//
+// Receive data from device.
+// Return number of bytes, 0 on timeout.
+//
+int serial_usb_read(unsigned char *data, int len, int timeout_msec)
+{
+    struct timeval t0;
+    int got;
+
+    gettimeofday(&t0, 0);
+    while (ring_head == ring_tail) {
+        int remaining = timeout_msec - msec_since(&t0);
+
+        if (remaining <= 0)
+            return 0;
+        if (handle_events(remaining) < 0) {
+            fprintf(stderr, "serial_read: read error\n");
+            exit(-1);
+        }
+    }
+
+    for (got=0; got<len && ring_tail != ring_head; got++)
+        data[got] = ring[ring_tail++ & (RING_SIZE-1)];
+    return got;
+}
+
+//
+// Discard received data.
+//
+void serial_usb_flush()
+{
+    handle_events(0);
+    ring_tail = ring_head;
+}
+
+//
+// Stop the transfers and close the device.
+//
+void serial_usb_close()
+{
+    int i;
+
+    if (! ctx)
+        return;
+
+    // Let pending writes complete, then cancel the reads.
+    for (i=0; i<10 && pending_out > 0; i++) {
+        if (handle_events(100) < 0)
+            break;
+    }
+    closing = 1;
+    for (i=0; i<NXFER_IN; i++) {
+        if (xfer_in[i])
+            libusb_cancel_transfer(xfer_in[i]);
+    }
+    for (i=0; i<NXFER_OUT; i++) {
+        if (busy_out[i])
+            libusb_cancel_transfer(xfer_out[i]);
+    }
+
+    // A transfer can be freed only when its callback is called.
+    while (pending_in > 0 || pending_out > 0) {
+        struct timeval tv = { 0, 100000 };
+        int result = libusb_handle_events_timeout(ctx, &tv);
+
+        if (result < 0 && result != LIBUSB_ERROR_INTERRUPTED &&
+            result != LIBUSB_ERROR_TIMEOUT) {
+            // Transfers are still owned by libusb: leave them allocated.
+            fprintf(stderr, "USB serial: event error %d: %s\n",
+                result, libusb_strerror(result));
+            memset(xfer_in, 0, sizeof(xfer_in));
+            memset(xfer_out, 0, sizeof(xfer_out));
+            break;
+        }
+    }
+
+    if (bridge == BRIDGE_CP210X) {
+        // IFC_ENABLE=0.
+        control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
+            0x00, 0, ifaces[0], 0, 0);
+    }
+    usb_cleanup();
+}
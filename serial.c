@@ -50,6 +50,7 @@
 
 #ifdef __linux__
 #   include <libudev.h>
+#   include <linux/serial.h>
 #endif
 
 #ifdef __APPLE__
@@ -62,6 +63,29 @@ static char *dev_path;
 static int last_vid = 0;
 static int last_pid = 0;
 
+// Reply timeout: adapted to round-trip time, but never below 1 sec.
+// A reply after a shorter timeout would shift the stream of replies.
+static rtt_t rtt = RTT_INIT("Serial", 1000, 1000, 2000, 3);
+
+//
+// Requests in flight for bulk reads, tuned by the link test.
+//
+#define PIPELINE_DEPTH  8
+
+static int pipeline_depth = PIPELINE_DEPTH;
+static unsigned pipeline_breaks;        // Bulk reads, which fell back to single reads
+
+#ifdef __linux__
+    // USB-serial bridge found by find_path(), and its original latency settings.
+    static char *dev_driver;                // kernel driver: ftdi_sio, cp210x, ch341, cdc_acm...
+    static char *dev_latency_path;          // sysfs latency_timer attribute, when present
+    static int saved_latency_timer = -1;    // original latency_timer value, msec
+    static int saved_serial_flags = -1;     // original serial_struct flags
+    static int dev_vid, dev_pid;            // USB identifiers of the bridge
+    static char *dev_location;              // USB bus and ports of the bridge, like "1-1.4"
+    static int usb_mode;                    // direct USB transport is active
+#endif
+
 static const unsigned char CMD_PRG[]   = "PROGRAM";
 static const unsigned char CMD_PRG2[]  = "\2";
 static const unsigned char CMD_QX[]    = "QX\6";
@@ -184,6 +208,10 @@ static int baud_encode(int bps)
 //
 int serial_write(const unsigned char *data, int len)
 {
+#ifdef __linux__
+    if (usb_mode)
+        return serial_usb_write(data, len);
+#endif
 #if defined(__WIN32__) || defined(WIN32)
     DWORD written;
 
@@ -201,6 +229,15 @@ int serial_write(const unsigned char *data, int len)
 //
 int serial_read(unsigned char *data, int len, int timeout_msec)
 {
+#ifdef __linux__
+    if (usb_mode) {
+        int got = serial_usb_read(data, len, timeout_msec);
+
+        if (got == 0 && trace_flag > 0)
+            printf("serial_read: no characters to read\n");
+        return got;
+    }
+#endif
 #if defined(__WIN32__) || defined(WIN32)
     DWORD got;
     COMMTIMEOUTS ctmo;
@@ -260,6 +297,112 @@ again:
     return got;
 }
 
+#ifdef __linux__
+//
+// Read a small integer value from sysfs attribute.
+// Return -1 on error.
+//
+static int sysfs_read_int(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    int value;
+
+    if (! f)
+        return -1;
+    if (fscanf(f, "%d", &value) != 1)
+        value = -1;
+    fclose(f);
+    return value;
+}
+
+//
+// Write an integer value to sysfs attribute.
+// Return -1 on error.
+//
+static int sysfs_write_int(const char *path, int value)
+{
+    FILE *f = fopen(path, "w");
+
+    if (! f)
+        return -1;
+    fprintf(f, "%d\n", value);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+//
+// Reduce receive latency of the USB-serial bridge.
+// Lock-step protocols wait for every short reply, so the bridge must
+// not hold received bytes in its buffer. FTDI chips have a latency timer
+// (16 msec by default), adjustable via sysfs. For other drivers,
+// request ASYNC_LOW_LATENCY mode of the tty layer.
+// Original settings are restored by low_latency_restore().
+//
+static void low_latency_enable()
+{
+    struct serial_struct ss;
+
+    // When the port is reopened, keep the settings saved on first open.
+    if (dev_latency_path) {
+        int latency = sysfs_read_int(dev_latency_path);
+
+        if (latency > 1) {
+            if (sysfs_write_int(dev_latency_path, 1) == 0) {
+                if (saved_latency_timer < 0)
+                    saved_latency_timer = latency;
+            } else if (trace_flag > 0) {
+                fprintf(stderr, "Cannot set %s: %s\n",
+                    dev_latency_path, strerror(errno));
+            }
+        }
+        if (trace_flag > 0)
+            fprintf(stderr, "Bridge %s: latency timer %d msec -> %d msec\n",
+                dev_driver ? dev_driver : "unknown", latency,
+                sysfs_read_int(dev_latency_path));
+    }
+
+    if (ioctl(fd, TIOCGSERIAL, &ss) < 0) {
+        if (trace_flag > 0)
+            fprintf(stderr, "Bridge %s: no serial flags\n",
+                dev_driver ? dev_driver : "unknown");
+        return;
+    }
+    if (! (ss.flags & ASYNC_LOW_LATENCY)) {
+        int flags = ss.flags;
+
+        ss.flags |= ASYNC_LOW_LATENCY;
+        if (ioctl(fd, TIOCSSERIAL, &ss) == 0 && saved_serial_flags < 0)
+            saved_serial_flags = flags;
+    }
+    if (trace_flag > 0)
+        fprintf(stderr, "Bridge %s: low latency mode %s\n",
+            dev_driver ? dev_driver : "unknown",
+            (saved_serial_flags >= 0 || (ss.flags & ASYNC_LOW_LATENCY)) ? "on" : "off");
+}
+
+//
+// Restore latency settings changed by low_latency_enable().
+//
+static void low_latency_restore()
+{
+    if (saved_serial_flags >= 0) {
+        struct serial_struct ss;
+
+        if (ioctl(fd, TIOCGSERIAL, &ss) == 0) {
+            ss.flags = saved_serial_flags;
+            ioctl(fd, TIOCSSERIAL, &ss);
+        }
+        saved_serial_flags = -1;
+    }
+    if (saved_latency_timer >= 0) {
+        sysfs_write_int(dev_latency_path, saved_latency_timer);
+        if (trace_flag > 0)
+            fprintf(stderr, "Bridge %s: latency timer restored to %d msec\n",
+                dev_driver ? dev_driver : "unknown", saved_latency_timer);
+        saved_latency_timer = -1;
+    }
+}
+#endif
+
 //
 // Open the serial port.
 // Return -1 on error.
@@ -324,6 +467,18 @@ int serial_open(const char *devname, int baud_rate)
         return -1;
     }
 #else
+#ifdef __linux__
+    // Prefer direct USB transfers when the kernel driver can be detached.
+    if (serial_usb_open(dev_vid, dev_pid, dev_location, baud_rate) == 0) {
+        usb_mode = 1;
+        if (pulse_on_open) {
+            serial_usb_set_lines(0, 0);
+            usleep(100000);
+        }
+        serial_usb_set_lines(1, 1);
+        return 0;
+    }
+#endif
     // Encode baud rate.
     int baud_code = baud_encode(baud_rate);
     if (baud_code < 0) {
@@ -371,6 +526,9 @@ int serial_open(const char *devname, int baud_rate)
         mcs |= (TIOCM_DTR | TIOCM_RTS);
         ioctl(fd, TIOCMSET, &mcs);
     }
+#ifdef __linux__
+    low_latency_enable();
+#endif
 #endif
     return 0;
 }
@@ -393,6 +551,16 @@ int serial_pulse_rts_dtr(void)
     // Not implemented on Windows here; return success.
     return 0;
 #else
+#ifdef __linux__
+    if (usb_mode) {
+        serial_usb_set_lines(1, 1);
+        usleep(100000);
+        serial_usb_set_lines(0, 0);
+        usleep(100000);
+        serial_usb_set_lines(1, 1);
+        return 0;
+    }
+#endif
     if (fd < 0)
         return -1;
     int flags;
@@ -478,6 +646,25 @@ static char *find_path(int vid, int pid)
                 continue;
             }
         }
+        if (usb_location) {
+            const char *name = udev_device_get_sysname(parent);
+
+            if (! name || strcmp(name, usb_location) != 0) {
+                // Another radio of the same type.
+                continue;
+            }
+        }
+        dev_vid = vendor_id;
+        dev_pid = product_id;
+
+        // Serial number identifies the radio.
+        const char *serial = udev_device_get_sysattr_value(parent, "serial");
+        snprintf(usb_serial, sizeof(usb_serial), "%s", serial ? serial : "");
+
+        // Location of the bridge, for the direct USB transport.
+        const char *location = udev_device_get_sysname(parent);
+        free(dev_location);
+        dev_location = location ? strdup(location) : 0;
 
         // Print names of vendor and product.
         //const char *vendor  = udev_device_get_sysattr_value(parent, "manufacturer");
@@ -485,6 +672,30 @@ static char *find_path(int vid, int pid)
         //printf("vendor = %s\n", vendor);
         //printf("product = %s\n", product);
 
+        // Remember the bridge driver and its latency timer attribute.
+        // The tty device's parent is the usb-serial port or the
+        // CDC ACM interface.
+        struct udev_device *port = udev_device_get_parent(comport);
+        free(dev_driver);
+        free(dev_latency_path);
+        dev_driver = 0;
+        dev_latency_path = 0;
+        if (port) {
+            const char *driver = udev_device_get_driver(port);
+
+            if (driver)
+                dev_driver = strdup(driver);
+            if (udev_device_get_sysattr_value(port, "latency_timer")) {
+                const char *portpath = udev_device_get_syspath(port);
+
+                dev_latency_path = malloc(strlen(portpath) + sizeof("/latency_timer"));
+                if (dev_latency_path) {
+                    strcpy(dev_latency_path, portpath);
+                    strcat(dev_latency_path, "/latency_timer");
+                }
+            }
+        }
+
         // Return result.
         udev_device_unref(parent);
         result = strdup(devpath);
@@ -669,6 +880,12 @@ static char *find_path(int vid, int pid)
 //
 int serial_init(int vid, int pid)
 {
+    link_param_t link;
+
+    // Depth of pipeline, found by the link test.
+    if (link_load("Serial", &link))
+        pipeline_depth = link.depth;
+
     last_vid = vid;
     last_pid = pid;
     dev_path = find_path(vid, pid);
@@ -688,8 +905,8 @@ int serial_init(int vid, int pid)
 //
 // Send the command sequence and get back a response.
 //
-static int send_recv(const unsigned char *cmd, int cmdlen,
-    unsigned char *response, int reply_len)
+static int send_recv_timeout(const unsigned char *cmd, int cmdlen,
+    unsigned char *response, int reply_len, unsigned timeout_msec)
 {
     unsigned char *p;
     int len, i, got;
@@ -715,7 +932,7 @@ static int send_recv(const unsigned char *cmd, int cmdlen,
     p = response;
     len = 0;
     while (len < reply_len) {
-        got = serial_read(p, reply_len - len, 1000);
+        got = serial_read(p, reply_len - len, timeout_msec);
         if (! got)
             return 0;
 
@@ -732,11 +949,76 @@ static int send_recv(const unsigned char *cmd, int cmdlen,
     return 1;
 }
 
+//
+// Send command and receive reply, with adaptive timeout.
+// Return 0 on timeout.
+//
+static int send_recv(const unsigned char *cmd, int cmdlen,
+    unsigned char *response, int reply_len)
+{
+    unsigned long long start = now_usec();
+
+    if (! send_recv_timeout(cmd, cmdlen, response, reply_len, rtt_timeout(&rtt, 0)))
+        return 0;
+    rtt_sample(&rtt, start);
+    return 1;
+}
+
+//
+// Discard any pending input.
+//
+static void flush_input()
+{
+#if defined(__WIN32__) || defined(WIN32)
+    PurgeComm(fd, PURGE_RXCLEAR);
+#else
+#ifdef __linux__
+    if (usb_mode) {
+        serial_usb_flush();
+        return;
+    }
+#endif
+    tcflush(fd, TCIFLUSH);
+#endif
+}
+
+//
+// Send command and receive reply.
+// On timeout, discard partial reply and repeat with growing timeout,
+// at most a few times.  Terminate when the radio does not respond.
+//
+static void send_recv_retry(const unsigned char *cmd, int cmdlen,
+    unsigned char *response, int reply_len)
+{
+    unsigned attempt = 0;
+
+    for (;;) {
+        unsigned long long start = now_usec();
+
+        if (send_recv_timeout(cmd, cmdlen, response, reply_len, rtt_timeout(&rtt, attempt))) {
+            // Only unambiguous replies are measured (Karn's algorithm).
+            if (attempt == 0)
+                rtt_sample(&rtt, start);
+            return;
+        }
+        if (! rtt_retry(&rtt, attempt++)) {
+            fprintf(stderr, "%s: no response from radio\n", dev_path);
+            exit(-1);
+        }
+        flush_input();
+    }
+}
+
+
 //
 // Close the serial port.
 //
 void serial_close()
 {
+    if (trace_flag)
+        rtt_print_stats(&rtt);
+    rtt_save(&rtt);
+
 #if defined(__WIN32__) || defined(WIN32)
     if (fd != INVALID_HANDLE_VALUE) {
         unsigned char ack[1];
@@ -748,11 +1030,25 @@ void serial_close()
         fd = INVALID_HANDLE_VALUE;
     }
 #else
+#ifdef __linux__
+    if (usb_mode) {
+        unsigned char ack[1];
+
+        send_recv(CMD_END, 3, ack, 1);
+
+        serial_usb_close();
+        usb_mode = 0;
+        return;
+    }
+#endif
     if (fd >= 0) {
         unsigned char ack[1];
 
         send_recv(CMD_END, 3, ack, 1);
 
+#ifdef __linux__
+        low_latency_restore();
+#endif
         tcsetattr(fd, TCSANOW, &saved_mode);
         close(fd);
         fd = -1;
@@ -859,6 +1155,11 @@ again:
 #if defined(__WIN32__) || defined(WIN32)
     //TODO: flush pending input and output buffers.
 #else
+#ifdef __linux__
+    if (usb_mode)
+        serial_usb_flush();
+    else
+#endif
     tcflush(fd, TCIOFLUSH);
 #endif
     // Only attempt PROGRAM fallback for Anytone VID/PID. Skip for others (e.g., DM-32 on CH340/CP210x).
@@ -904,6 +1205,12 @@ void serial_read_region(int addr, unsigned char *data, int nbytes)
     unsigned char cmd[6], reply[8 + DATASZ];
     int n, i, retry = 0;
 
+    if (plan_flag) {
+        // The data stay intact.
+        n = (nbytes + DATASZ - 1) / DATASZ;
+        plan_account("Serial read", n, n, n * DATASZ);
+        return;
+    }
     for (n=0; n<nbytes; n+=DATASZ) {
         // Read command: 52 aa aa aa aa 10
         cmd[0] = CMD_READ[0];
@@ -913,7 +1220,7 @@ void serial_read_region(int addr, unsigned char *data, int nbytes)
         cmd[4] = addr + n;
         cmd[5] = DATASZ;
 again:
-        send_recv(cmd, 6, reply, sizeof(reply));
+        send_recv_retry(cmd, 6, reply, sizeof(reply));
         if (reply[0] != CMD_WRITE[0] || reply[7+DATASZ] != CMD_ACK[0]) {
             fprintf(stderr, "%s: Wrong read reply %02x-...-%02x, expected %02x-...-%02x\n",
                 __func__, reply[0], reply[7+DATASZ], CMD_WRITE[0], CMD_ACK[0]);
@@ -936,6 +1243,80 @@ again:
     }
 }
 
+//
+// Read a large region, keeping several requests in flight.
+// Replies arrive in order of requests, so the latency of the link
+// is paid once per window, instead of once per 64 bytes.
+// On any error, drop the pipeline and read the rest one by one.
+// The size need not be a multiple of 64 bytes.
+//
+void serial_read_bulk(int addr, unsigned char *data, int nbytes)
+{
+    static const int DATASZ = 64;
+    unsigned char cmd[6], reply[8 + DATASZ], tmp[DATASZ];
+    int sent = 0, done = 0, i, len;
+
+    if (plan_flag) {
+        // Latency is paid once per window of requests.
+        i = (nbytes + DATASZ - 1) / DATASZ;
+        plan_account("Serial bulk read", i, (i + pipeline_depth - 1) / pipeline_depth, i * DATASZ);
+        return;
+    }
+    while (done < nbytes) {
+        // Fill the pipeline.
+        while (sent < nbytes && sent - done < pipeline_depth * DATASZ) {
+            cmd[0] = CMD_READ[0];
+            cmd[1] = (addr + sent) >> 24;
+            cmd[2] = (addr + sent) >> 16;
+            cmd[3] = (addr + sent) >> 8;
+            cmd[4] = addr + sent;
+            cmd[5] = DATASZ;
+            if (serial_write(cmd, 6) < 0) {
+                fprintf(stderr, "%s: write error\n", dev_path);
+                exit(-1);
+            }
+            sent += DATASZ;
+        }
+
+        // Receive the oldest reply: 57 aa aa aa aa 40 [data...] ss 06
+        for (len = 0; len < (int)sizeof(reply); len += i) {
+            i = serial_read(reply + len, sizeof(reply) - len, rtt_timeout(&rtt, 0));
+            if (i <= 0)
+                break;
+        }
+        unsigned char sum = reply[1];
+        for (i=2; i<6+DATASZ; i++)
+            sum += reply[i];
+        if (len < (int)sizeof(reply) || reply[0] != CMD_WRITE[0] ||
+            reply[1] != (unsigned char)((addr + done) >> 24) ||
+            reply[2] != (unsigned char)((addr + done) >> 16) ||
+            reply[3] != (unsigned char)((addr + done) >> 8) ||
+            reply[4] != (unsigned char)(addr + done) ||
+            reply[6+DATASZ] != sum || reply[7+DATASZ] != CMD_ACK[0]) {
+            if (trace_flag)
+                fprintf(stderr, "%s: pipeline broken at %#x\n", __func__, addr + done);
+            rtt_retry(&rtt, 0);
+            pipeline_breaks++;
+            break;
+        }
+        len = (nbytes - done < DATASZ) ? nbytes - done : DATASZ;
+        memcpy(data + done, reply + 6, len);
+        done += len;
+    }
+    if (done >= nbytes)
+        return;
+
+    // Let pending replies arrive, and discard them.
+    mdelay(rtt_timeout(&rtt, 0));
+    flush_input();
+
+    for (; done < nbytes; done += DATASZ) {
+        len = (nbytes - done < DATASZ) ? nbytes - done : DATASZ;
+        serial_read_region(addr + done, tmp, DATASZ);
+        memcpy(data + done, tmp, len);
+    }
+}
+
 // Variant with adjustable chunk size for radios that require 16-byte reads (e.g., DM-32)
 void serial_read_region_n(int addr, unsigned char *data, int nbytes, int chunk)
 {
@@ -945,6 +1326,11 @@ void serial_read_region_n(int addr, unsigned char *data, int nbytes, int chunk)
     unsigned char reply[8 + 256];
     int n, i, retry = 0;
 
+    if (plan_flag) {
+        n = (nbytes + DATASZ - 1) / DATASZ;
+        plan_account("Serial read", n, n, nbytes);
+        return;
+    }
     for (n = 0; n < nbytes; n += DATASZ) {
         int this_sz = (nbytes - n) < DATASZ ? (nbytes - n) : DATASZ;
         // Read command: 52 aa aa aa aa nn
@@ -956,11 +1342,7 @@ void serial_read_region_n(int addr, unsigned char *data, int nbytes, int chunk)
         cmd[5] = this_sz;
 again_n:
         // Expect reply: 57 aa aa aa aa nn [data...] ss 06
-        if (!send_recv(cmd, 6, reply, 8 + this_sz)) {
-            if (retry++ < 3) goto again_n;
-            fprintf(stderr, "%s: timeout waiting for reply\n", __func__);
-            exit(-1);
-        }
+        send_recv_retry(cmd, 6, reply, 8 + this_sz);
         if (reply[0] != CMD_WRITE[0] || reply[7 + this_sz] != CMD_ACK[0]) {
             fprintf(stderr, "%s: Wrong read reply %02x-...-%02x, expected %02x-...-%02x\n",
                 __func__, reply[0], reply[7 + this_sz], CMD_WRITE[0], CMD_ACK[0]);
@@ -990,6 +1372,11 @@ void serial_write_region(int addr, unsigned char *data, int nbytes)
     unsigned char ack, cmd[8 + DATASZ];
     int n, i;
 
+    if (plan_flag) {
+        n = (nbytes + DATASZ - 1) / DATASZ;
+        plan_account("Serial write", n, n, n * DATASZ);
+        return;
+    }
     for (n=0; n<nbytes; n+=DATASZ) {
         // Write command: 57 aa aa aa aa 10 .. .. ss nn
         cmd[0] = CMD_WRITE[0];
@@ -1008,7 +1395,7 @@ void serial_write_region(int addr, unsigned char *data, int nbytes)
         cmd[6 + DATASZ] = sum;
         cmd[7 + DATASZ] = CMD_ACK[0];
 
-        send_recv(cmd, 8 + DATASZ, &ack, 1);
+        send_recv_retry(cmd, 8 + DATASZ, &ack, 1);
         if (ack != CMD_ACK[0]) {
             fprintf(stderr, "%s: Wrong acknowledge %#x, expected %#x\n",
                 __func__, ack, CMD_ACK[0]);
@@ -1017,6 +1404,41 @@ void serial_write_region(int addr, unsigned char *data, int nbytes)
     }
 }
 
+//
+// Read callback for the link test: one window of requests.
+//
+static int link_read(unsigned addr, unsigned char *data, const link_param_t *param)
+{
+    if (param->depth > 1) {
+        unsigned nbreaks = pipeline_breaks;
+
+        pipeline_depth = param->depth;
+        serial_read_bulk(addr, data, param->size * param->depth);
+
+        // Fallback to single reads is an error of this setting.
+        if (pipeline_breaks != nbreaks)
+            return -1;
+    } else {
+        serial_read_region_n(addr, data, param->size, param->size);
+    }
+    return 0;
+}
+
+//
+// Benchmark the link with reads of a span of memory:
+// single requests of 16 and 64 bytes, then pipelined
+// bulk reads of increasing depth.
+//
+void serial_linktest(unsigned addr, unsigned span)
+{
+    static const link_param_t tab[] = {
+        { 16, 1 }, { 64, 1 }, { 64, 2 }, { 64, 4 }, { 64, 8 }, { 64, 16 },
+    };
+    int best = linktest_run("Serial", link_read, tab, 6, addr, span);
+
+    pipeline_depth = (best >= 0) ? tab[best].depth : PIPELINE_DEPTH;
+}
+
 // Intentionally no generic program-mode entry for DM-32 here; the DM-32 driver
 // performs the CPS-style entry sequence safely within its download routine.
 
@@ -0,0 +1,250 @@
+/*
+ * Tests for BCD codec: scalar and array versions.
+ *
+ * Copyright (C) 2018 Serge Vakulenko, KK6ABQ
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. The name of the author may not be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "../util.h"
+
+int trace_flag;
+
+static int nfailed;
+
+#define CHECK(cond, ...) do { \
+        if (! (cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            nfailed++; \
+        } \
+    } while (0)
+
+//
+// Reference encoder: one digit at a time.
+//
+static unsigned ref_encode(unsigned bin)
+{
+    unsigned bcd = 0;
+    int i;
+
+    for (i=0; i<8; i++) {
+        bcd |= (bin % 10) << (i * 4);
+        bin /= 10;
+    }
+    return bcd;
+}
+
+//
+// Add one to BCD value, digit by digit with carry.
+//
+static unsigned ref_increment(unsigned bcd)
+{
+    unsigned digit = 1;
+
+    while (digit != 0 && (bcd & (0xf * digit)) == 9 * digit) {
+        bcd &= ~(0xf * digit);
+        digit <<= 4;
+    }
+    return bcd + digit;
+}
+
+//
+// Values at digit boundaries, and invalid ones.
+//
+static const unsigned edge[] = {
+    0, 1, 9, 10, 99, 100, 999, 1000, 9999, 10000, 99999, 100000,
+    999999, 1000000, 9999999, 10000000, 12345678, 87654321, 99999999,
+};
+
+static const unsigned invalid_bcd[] = {
+    0xffffffff, 0x0000000a, 0x000000f0, 0xa0000000, 0x99999999 + 1,
+};
+
+//
+// Decimal to BCD and back, for the edge values and
+// for every value of the range 0...99999999.
+//
+static void test_scalar()
+{
+    unsigned i, v, ref;
+
+    for (i=0; i<sizeof(edge)/sizeof(edge[0]); i++) {
+        v = bcd_encode(edge[i]);
+        CHECK(v == ref_encode(edge[i]), "bcd_encode(%u) = %#x", edge[i], v);
+        CHECK(bcd_valid(v), "bcd_valid(%#x)", v);
+        CHECK(bcd_decode(v) == edge[i], "bcd_decode(%#x) = %u", v, bcd_decode(v));
+    }
+    for (v=0, ref=0; v<=99999999; v++, ref=ref_increment(ref)) {
+        unsigned bcd = bcd_encode(v);
+
+        if (bcd != ref || bcd_decode(bcd) != v) {
+            CHECK(0, "round trip of %u: %#x", v, bcd);
+            break;
+        }
+    }
+    for (i=0; i<sizeof(invalid_bcd)/sizeof(invalid_bcd[0]); i++)
+        CHECK(! bcd_valid(invalid_bcd[i]), "bcd_valid(%#x)", invalid_bcd[i]);
+}
+
+//
+// Array kernels against the scalar version, for all lengths
+// up to 40 (tails of SIMD loops), and for values out of range.
+//
+static void test_array()
+{
+    unsigned src[64], dst[64], n, i;
+
+    for (n=0; n<=40; n++) {
+        for (i=0; i<n; i++)
+            src[i] = edge[(i + n) % (sizeof(edge)/sizeof(edge[0]))];
+        dst[n] = 0x5a5a5a5a;
+        bcd_encode_array(dst, src, n);
+        for (i=0; i<n; i++)
+            CHECK(dst[i] == bcd_encode(src[i]), "encode_array[%u] of %u = %#x", i, src[i], dst[i]);
+        CHECK(dst[n] == 0x5a5a5a5a, "encode_array(%u) overruns", n);
+
+        bcd_decode_array(src, dst, n);
+        for (i=0; i<n; i++)
+            CHECK(src[i] == bcd_decode(dst[i]), "decode_array[%u] of %#x = %u", i, dst[i], src[i]);
+    }
+
+    // Invalid values: the array version must agree with the scalar one.
+    for (i=0; i<16; i++) {
+        src[i] = (i & 1) ? 0xffffffff : 99999999;
+        dst[i] = invalid_bcd[i % (sizeof(invalid_bcd)/sizeof(invalid_bcd[0]))];
+    }
+    bcd_encode_array(src + 16, src, 16);
+    for (i=0; i<16; i++)
+        CHECK(src[16+i] == bcd_encode(src[i]), "encode_array of %#x = %#x", src[i], src[16+i]);
+    bcd_decode_array(dst + 16, dst, 16);
+    for (i=0; i<16; i++)
+        CHECK(dst[16+i] == bcd_decode(dst[i]), "decode_array of %#x = %#x", dst[i], dst[16+i]);
+
+    // In place.
+    for (i=0; i<40; i++)
+        src[i] = i * 2499999;
+    bcd_encode_array(src, src, 40);
+    bcd_decode_array(src, src, 40);
+    for (i=0; i<40; i++)
+        CHECK(src[i] == i * 2499999, "in place round trip of %u = %u", i * 2499999, src[i]);
+}
+
+//
+// Array kernels over the whole range 0...99999999,
+// to BCD and back.
+//
+static void test_array_range()
+{
+    static unsigned src[4096], bcd[4096], bin[4096];
+    unsigned base, i, ref = 0;
+
+    for (base=0; base<=99999999; base+=4096) {
+        unsigned n = (99999999 - base + 1 < 4096) ? 99999999 - base + 1 : 4096;
+
+        for (i=0; i<n; i++)
+            src[i] = base + i;
+        bcd_encode_array(bcd, src, n);
+        bcd_decode_array(bin, bcd, n);
+        for (i=0; i<n; i++, ref=ref_increment(ref)) {
+            if (bcd[i] != ref || bin[i] != src[i]) {
+                CHECK(0, "array round trip of %u: %#x, %u", src[i], bcd[i], bin[i]);
+                return;
+            }
+        }
+    }
+}
+
+//
+// Bytes in memory, most significant first.
+//
+static void test_bytes()
+{
+    unsigned char buf[4];
+
+    put_bcd(buf, 3114542);
+    CHECK(buf[0] == 0x03 && buf[1] == 0x11 && buf[2] == 0x45 && buf[3] == 0x42,
+        "put_bcd = %02x %02x %02x %02x", buf[0], buf[1], buf[2], buf[3]);
+    CHECK(get_bcd(buf) == 3114542, "get_bcd = %u", get_bcd(buf));
+
+    put_bcd(buf, 99999999);
+    CHECK(get_bcd(buf) == 99999999, "get_bcd = %u", get_bcd(buf));
+}
+
+//
+// Frequencies in MHz to integer Hz, up to the limit of BCD format.
+//
+static void test_mhz()
+{
+    static const struct {
+        const char *str;
+        int ok, hz;
+    } tab[] = {
+        { "146.52",      1, 146520000 },
+        { "+0.6",        1, 600000 },
+        { "-5",          1, -5000000 },
+        { "439.0000005", 1, 439000001 },
+        { "999.99999",   1, 999999990 },
+        { "999.999995",  0, 0 },
+        { "1000",        0, 0 },
+        { "4700.0",      0, 0 },
+        { "100000",      0, 0 },
+        { "",            0, 0 },
+        { ".",           0, 0 },
+    };
+    unsigned i;
+
+    for (i=0; i<sizeof(tab)/sizeof(tab[0]); i++) {
+        int hz = 0, ok = parse_mhz(tab[i].str, &hz);
+
+        CHECK(ok == tab[i].ok, "parse_mhz(\"%s\") returns %d", tab[i].str, ok);
+        if (ok && tab[i].ok)
+            CHECK(hz == tab[i].hz, "parse_mhz(\"%s\") = %d", tab[i].str, hz);
+    }
+}
+
+int main()
+{
+    test_scalar();
+
+    // Both SIMD kernels, when the processor has them.
+    if (bcd_select_avx2(1)) {
+        test_array();
+        test_array_range();
+    }
+    bcd_select_avx2(0);
+    test_array();
+    test_array_range();
+    bcd_select_avx2(1);
+
+    test_bytes();
+    test_mhz();
+    if (nfailed > 0) {
+        fprintf(stderr, "BCD test: %d checks failed.\n", nfailed);
+        return 1;
+    }
+    printf("BCD test passed.\n");
+    return 0;
+}
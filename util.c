@@ -27,15 +27,17 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
+#include <sys/stat.h>
 #ifdef MINGW32
 #   include <windows.h>
 #else
-#   include <sys/stat.h>
+#   include <pthread.h>
 #endif
 #include "util.h"
 
@@ -171,14 +173,592 @@ void mdelay(unsigned msec)
 }
 
 //
-// Round double value to integer.
+// Monotonic time in microseconds.
 //
-static int iround(double x)
+unsigned long long now_usec()
 {
-    if (x >= 0)
-        return (int)(x + 0.5);
+#ifdef MINGW32
+    return GetTickCount64() * 1000ULL;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#endif
+}
+
+//
+// Get timeout in milliseconds for a given attempt, starting from 0.
+// Before the first sample, use the initial value.
+//
+unsigned rtt_timeout(const rtt_t *rtt, unsigned attempt)
+{
+    unsigned msec = rtt->init_msec;
+
+    if (rtt->nsamples > 0) {
+        // RTO = SRTT + max(G, 4*RTTVAR), with 1 msec granularity.
+        unsigned var = 4 * rtt->rttvar;
+
+        msec = (rtt->srtt + (var > 1000 ? var : 1000) + 999) / 1000;
+    }
+    while (attempt-- > 0 && msec < rtt->max_msec)
+        msec *= 2;
+
+    if (msec < rtt->min_msec)
+        msec = rtt->min_msec;
+    if (msec > rtt->max_msec)
+        msec = rtt->max_msec;
+    return msec;
+}
+
+//
+// Update the estimate with a transaction, started at given time.
+//
+void rtt_sample(rtt_t *rtt, unsigned long long start_usec)
+{
+    unsigned long long delta = now_usec() - start_usec;
+    unsigned r = (delta > 60000000) ? 60000000 : (unsigned) delta;
+
+    if (rtt->nsamples++ == 0) {
+        rtt->srtt = r;
+        rtt->rttvar = r / 2;
+    } else {
+        unsigned err = (r > rtt->srtt) ? r - rtt->srtt : rtt->srtt - r;
+
+        // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|
+        // SRTT = 7/8 SRTT + 1/8 R
+        rtt->rttvar = (3 * rtt->rttvar + err) / 4;
+        rtt->srtt = (7 * rtt->srtt + r) / 8;
+    }
+}
+
+static unsigned total_retries;          // Retries of all transports
+
+const char *usb_location;               // USB bus and ports of the radio, or 0
+char usb_serial[64];                    // Serial number of the connected device
+
+//
+// Get the number of retries of all transports.
+//
+unsigned rtt_total_retries()
+{
+    return total_retries;
+}
+
+//
+// Account a timeout of given attempt.
+// Return 1 when the transaction should be repeated,
+// or 0 when the retry limit is exhausted.
+//
+int rtt_retry(rtt_t *rtt, unsigned attempt)
+{
+    if (attempt >= rtt->max_retries) {
+        rtt->nfailures++;
+        progress_error(rtt->name, "timeout");
+        return 0;
+    }
+    rtt->nretries++;
+    total_retries++;
+    progress_retry(rtt->name, attempt + 1, rtt_timeout(rtt, attempt));
+    if (trace_flag) {
+        fprintf(stderr, "%s: timeout %u msec, retry %u\n", rtt->name,
+            rtt_timeout(rtt, attempt), attempt + 1);
+    }
+    return 1;
+}
+
+//
+// Remember the measured round-trip time of the transport,
+// as a latency model for dry runs of the same cable.
+//
+void rtt_save(const rtt_t *rtt)
+{
+    char path[1024];
+    FILE *f;
+    int len;
+
+    if (rtt->nsamples < RTT_SAVE_SAMPLES || plan_flag)
+        return;
+    if (! cache_dir(path, sizeof(path) - 32))
+        return;
+    len = strlen(path);
+    snprintf(path + len, sizeof(path) - len, "/%s.rtt", rtt->name);
+
+    f = fopen(path, "w");
+    if (! f)
+        return;
+    fprintf(f, "%u %u %u\n", rtt->srtt, rtt->rttvar, rtt->nsamples);
+    fclose(f);
+}
+
+//
+// Print statistics of the transport.
+//
+void rtt_print_stats(const rtt_t *rtt)
+{
+    if (rtt->nsamples == 0 && rtt->nretries == 0)
+        return;
+    fprintf(stderr, "%s: %u transactions, RTT %u.%03u msec +/- %u.%03u, timeout %u msec, %u retries, %u failures\n",
+        rtt->name, rtt->nsamples, rtt->srtt / 1000, rtt->srtt % 1000,
+        rtt->rttvar / 1000, rtt->rttvar % 1000, rtt_timeout(rtt, 0),
+        rtt->nretries, rtt->nfailures);
+}
+
+static int progress_fd = -1;            // Descriptor for events, or -1
+static unsigned long long progress_t0;  // Time of progress_open()
+
+static struct {
+    const char *phase;                  // Current phase, or 0
+    unsigned long long start_usec;      // Start of the phase
+    unsigned long long last_usec;       // Last emitted update
+    unsigned last_done;                 // Bytes at the last update
+    unsigned done, total;               // Bytes of the phase
+} progress;
+
+//
+// Write one event: time, event name, phase, and optional fields
+// in JSON syntax. The line goes out with a single write(),
+// so events stay whole when the descriptor is shared.
+//
+static void progress_emit(const char *event, const char *fmt, ...)
+{
+    unsigned long long t = now_usec() - progress_t0;
+    char line[512];
+    int n;
+
+    n = snprintf(line, sizeof(line), "{\"time\":%llu.%03llu,\"event\":\"%s\"",
+        t / 1000000, t / 1000 % 1000, event);
+    if (progress.phase)
+        n += snprintf(line + n, sizeof(line) - n, ",\"phase\":\"%s\"", progress.phase);
+    if (fmt) {
+        va_list ap;
+
+        line[n++] = ',';
+        va_start(ap, fmt);
+        n += vsnprintf(line + n, sizeof(line) - n, fmt, ap);
+        va_end(ap);
+    }
+    if (n > (int)sizeof(line) - 3)
+        n = sizeof(line) - 3;
+    line[n++] = '}';
+    line[n++] = '\n';
+    if (write(progress_fd, line, n) != n) {
+        // Orchestrator is gone: stop reporting.
+        progress_fd = -1;
+    }
+}
+
+//
+// Bytes per second from a given time.
+//
+static unsigned progress_rate(unsigned nbytes, unsigned long long since)
+{
+    unsigned long long usec = now_usec() - since;
+
+    if (usec == 0)
+        return 0;
+    return nbytes * 1000000ULL / usec;
+}
+
+//
+// Report a phase, which did not finish.
+//
+static void progress_atexit(void)
+{
+    if (progress_fd >= 0 && progress.phase)
+        progress_emit("error", "\"message\":\"aborted\",\"done\":%u,\"total\":%u",
+            progress.done, progress.total);
+}
+
+//
+// Enable progress events on a given file descriptor.
+//
+void progress_open(int fd)
+{
+    progress_fd = fd;
+    progress_t0 = now_usec();
+    atexit(progress_atexit);
+}
+
+//
+// Start a phase of work with the radio.
+// Radio name is copied without quotes and backslashes.
+//
+void progress_start(const char *phase, const char *radio)
+{
+    char name[64];
+    int i, n = 0;
+
+    memset(&progress, 0, sizeof(progress));
+    if (progress_fd < 0)
+        return;
+
+    for (i=0; radio[i] && n < (int)sizeof(name) - 1; i++) {
+        if (radio[i] != '"' && radio[i] != '\\' && radio[i] >= ' ')
+            name[n++] = radio[i];
+    }
+    name[n] = 0;
+
+    progress.phase = phase;
+    progress.start_usec = now_usec();
+    progress.last_usec = progress.start_usec;
+    progress_emit("start", "\"radio\":\"%s\"", name);
+}
+
+//
+// Account bytes done out of total for the current phase.
+// Throughput is measured since the previous emitted update.
+//
+void progress_update(unsigned done, unsigned total)
+{
+    unsigned long long now;
+
+    progress.done = done;
+    progress.total = total;
+    if (progress_fd < 0 || !progress.phase)
+        return;
+
+    now = now_usec();
+    if (done < total && now - progress.last_usec < PROGRESS_INTERVAL_MSEC * 1000ULL)
+        return;
+
+    if (done < progress.last_done)
+        progress.last_done = 0;
+    progress_emit("progress", "\"done\":%u,\"total\":%u,\"rate\":%u",
+        done, total, progress_rate(done - progress.last_done, progress.last_usec));
+    progress.last_usec = now;
+    progress.last_done = done;
+}
+
+//
+// Report a retransmission by the transport.
+//
+void progress_retry(const char *transport, unsigned attempt, unsigned timeout_msec)
+{
+    if (progress_fd < 0)
+        return;
+    progress_emit("retry", "\"transport\":\"%s\",\"attempt\":%u,\"timeout_msec\":%u,\"done\":%u",
+        transport, attempt, timeout_msec, progress.done);
+}
+
+//
+// Report an error of the transport.
+//
+void progress_error(const char *transport, const char *message)
+{
+    if (progress_fd < 0)
+        return;
+    progress_emit("error", "\"transport\":\"%s\",\"message\":\"%s\",\"done\":%u",
+        transport, message, progress.done);
+}
+
+//
+// Finish the current phase, with average throughput.
+//
+void progress_end()
+{
+    unsigned long long usec;
+
+    if (progress_fd < 0 || !progress.phase)
+        return;
+
+    usec = now_usec() - progress.start_usec;
+    progress_emit("end", "\"done\":%u,\"total\":%u,\"elapsed\":%llu.%03llu,\"rate\":%u",
+        progress.done, progress.total, usec / 1000000, usec / 1000 % 1000,
+        progress_rate(progress.done, progress.start_usec));
+    progress.phase = 0;
+}
+
+int plan_flag;                          // Dry run, see plan_account()
+
+//
+// Default cost of transports, without a measurement.
+// The longest matching prefix of the transaction kind is used.
+//
+static const struct {
+    const char *name;
+    unsigned rtt_usec;                  // Latency of a round trip
+    unsigned bytes_per_sec;             // Payload throughput
+} plan_model[] = {
+    { "HID",        2000,    32000 },   // 32 bytes per 64-byte report, 1 msec frames
+    { "DFU",        2000,   500000 },   // Control transfers, full speed USB
+    { "DFU erase",  250000, 0 },        // Erase of 64-kbyte flash sector
+    { "Serial",     2000,   200000 },   // USB CDC of Anytone
+    { 0,            2000,   100000 },   // Anything else
+};
+
+static struct {
+    const char *what;                   // Kind of transaction
+    unsigned frames;                    // Requests sent
+    unsigned round_trips;               // Waits for the reply
+    unsigned nbytes;                    // Payload
+} plan_tab[16];
+
+//
+// Account transactions of a given kind.
+// With -t, every call is listed.
+//
+void plan_account(const char *what, unsigned frames, unsigned round_trips, unsigned nbytes)
+{
+    int i;
+
+    if (trace_flag)
+        printf("--- Plan %s: %u frames, %u bytes\n", what, frames, nbytes);
+
+    for (i=0; i<16 && plan_tab[i].what; i++) {
+        if (strcmp(plan_tab[i].what, what) == 0)
+            break;
+    }
+    if (i == 16) {
+        fprintf(stderr, "%s: too many kinds of transactions\n", __func__);
+        exit(-1);
+    }
+    plan_tab[i].what = what;
+    plan_tab[i].frames += frames;
+    plan_tab[i].round_trips += round_trips;
+    plan_tab[i].nbytes += nbytes;
+}
+
+//
+// Get cost of a transaction kind: from the measured
+// round-trip time of the transport, or from the default model.
+// Return 1 when measured.
+//
+static int plan_cost(const char *what, unsigned *rtt_usec, unsigned *bytes_per_sec)
+{
+    int i, best = -1, len, best_len = 0;
+    char path[1024];
+    unsigned srtt;
+    FILE *f;
+
+    for (i=0; plan_model[i].name; i++) {
+        len = strlen(plan_model[i].name);
+        if (strncmp(what, plan_model[i].name, len) == 0 &&
+            (what[len] == 0 || what[len] == ' ') && len > best_len) {
+            best = i;
+            best_len = len;
+        }
+    }
+    if (best < 0)
+        best = i;
+    *rtt_usec = plan_model[best].rtt_usec;
+    *bytes_per_sec = plan_model[best].bytes_per_sec;
+    if (best == i || ! cache_dir(path, sizeof(path) - 32))
+        return 0;
+
+    // Measured RTT covers the payload of the usual transaction.
+    len = strlen(path);
+    snprintf(path + len, sizeof(path) - len, "/%s.rtt", plan_model[best].name);
+    f = fopen(path, "r");
+    if (! f)
+        return 0;
+    i = fscanf(f, "%u", &srtt);
+    fclose(f);
+    if (i != 1 || srtt == 0)
+        return 0;
+    *rtt_usec = srtt;
+
+    // Throughput, measured by the link test, when available.
+    len = strlen(path) - 4;
+    strcpy(path + len, ".link");
+    f = fopen(path, "r");
+    if (f) {
+        unsigned size, depth, rate;
+
+        if (fscanf(f, "size %u depth %u rate %u", &size, &depth, &rate) == 3 && rate > 0)
+            *bytes_per_sec = rate;
+        fclose(f);
+    }
+    return 1;
+}
+
+//
+// Print the accounted transactions, and estimated time.
+//
+void plan_print(FILE *out)
+{
+    unsigned long long usec, total_usec = 0;
+    unsigned frames = 0, nbytes = 0, rtt_usec, rate, payload;
+    int i, measured, any_measured = 0;
+
+    fprintf(out, "Transactions        Frames  Round trips      Bytes   RTT msec     Time sec\n");
+    for (i=0; i<16 && plan_tab[i].what; i++) {
+        measured = plan_cost(plan_tab[i].what, &rtt_usec, &rate);
+        usec = (unsigned long long) plan_tab[i].round_trips * rtt_usec;
+        payload = plan_tab[i].nbytes;
+        if (measured) {
+            // Measured RTT covers the payload of one frame per round trip:
+            // other frames of a pipelined window add their wire time.
+            payload = (plan_tab[i].frames > plan_tab[i].round_trips) ?
+                payload - (unsigned long long) payload * plan_tab[i].round_trips / plan_tab[i].frames : 0;
+        }
+        if (rate > 0)
+            usec += payload * 1000000ULL / rate;
+
+        fprintf(out, "%-16s %9u %12u %10u %6u.%03u%c %8llu.%01llu\n",
+            plan_tab[i].what, plan_tab[i].frames, plan_tab[i].round_trips,
+            plan_tab[i].nbytes, rtt_usec / 1000, rtt_usec % 1000,
+            measured ? '*' : ' ', usec / 1000000, usec / 100000 % 10);
+        frames += plan_tab[i].frames;
+        nbytes += plan_tab[i].nbytes;
+        total_usec += usec;
+        any_measured |= measured;
+    }
+    fprintf(out, "Total %u bytes in %u frames, estimated %llu.%01llu seconds.\n",
+        nbytes, frames, total_usec / 1000000, total_usec / 100000 % 10);
+    if (any_measured)
+        fprintf(out, "(*) RTT measured on this computer, with the payload of one frame per round trip.\n");
+}
+
+static int compare_unsigned(const void *pa, const void *pb)
+{
+    unsigned a = *(const unsigned*) pa;
+    unsigned b = *(const unsigned*) pb;
+
+    return (a > b) - (a < b);
+}
+
+//
+// Get the name of file with link parameters of the transport.
+// Return 0 when the cache is not available.
+//
+static int link_path(char *path, int size, const char *transport)
+{
+    int len;
+
+    if (! cache_dir(path, size - 32))
+        return 0;
+    len = strlen(path);
+    snprintf(path + len, size - len, "/%s.link", transport);
+    return 1;
+}
+
+//
+// Run reads with every setting from the table, over span bytes
+// starting at addr, and print latency of calls, throughput,
+// errors and retries. The fastest setting without errors
+// is saved for the transport. Return its index, or -1.
+//
+int linktest_run(const char *transport, link_read_t read,
+    const link_param_t *tab, int ntab, unsigned addr, unsigned span)
+{
+    static unsigned lat[LINKTEST_CALLS];
+    unsigned long long t0, t, usec;
+    unsigned rate, best_rate = 0, chunk, ncalls, nerrors, nretries, k;
+    unsigned char *data;
+    int i, best = -1;
+    char path[1024];
+    FILE *f;
+
+    printf("%s link test at 0x%x, %u bytes per setting:\n", transport, addr, LINKTEST_BYTES);
+    printf("%6s%6s%7s%10s%8s%8s%9s%12s%8s%8s\n", "Size", "Depth", "Calls",
+        "Min msec", "Median", "90%", "Max", "Kbytes/sec", "Errors", "Retries");
+    for (i=0; i<ntab; i++) {
+        chunk = tab[i].size * tab[i].depth;
+        if (chunk > span)
+            continue;
+        data = malloc(chunk);
+        if (! data) {
+            fprintf(stderr, "Out of memory!\n");
+            exit(-1);
+        }
+        ncalls = LINKTEST_BYTES / chunk;
+        if (ncalls < 1)
+            ncalls = 1;
+        if (ncalls > LINKTEST_CALLS)
+            ncalls = LINKTEST_CALLS;
+
+        nerrors = 0;
+        nretries = total_retries;
+        t0 = now_usec();
+        for (k=0; k<ncalls; k++) {
+            t = now_usec();
+            if (read(addr + k * chunk % (span / chunk * chunk), data, &tab[i]) < 0)
+                nerrors++;
+            lat[k] = now_usec() - t;
+        }
+        usec = now_usec() - t0;
+        nretries = total_retries - nretries;
+        free(data);
+
+        qsort(lat, ncalls, sizeof(lat[0]), compare_unsigned);
+        rate = (ncalls - nerrors) * (unsigned long long) chunk * 1000000 / (usec ? usec : 1);
+        printf("%6u%6u%7u%10.3f%8.3f%8.3f%9.3f%12.1f%8u%8u\n",
+            tab[i].size, tab[i].depth, ncalls, lat[0] / 1000.0,
+            lat[ncalls/2] / 1000.0, lat[ncalls*9/10] / 1000.0,
+            lat[ncalls-1] / 1000.0, rate / 1024.0, nerrors, nretries);
+
+        if (nerrors == 0 && rate > best_rate) {
+            best = i;
+            best_rate = rate;
+        }
+    }
+    if (best < 0) {
+        printf("No setting without errors.\n");
+        return -1;
+    }
+    printf("Best: size %u, depth %u.\n", tab[best].size, tab[best].depth);
+
+    if (ntab > 1 && link_path(path, sizeof(path), transport)) {
+        f = fopen(path, "w");
+        if (f) {
+            fprintf(f, "size %u\ndepth %u\nrate %u\n",
+                tab[best].size, tab[best].depth, best_rate);
+            fclose(f);
+            printf("Saved to '%s'.\n", path);
+        }
+    }
+    return best;
+}
+
+//
+// Load the link parameters, saved by the link test.
+// Return 1 on success.
+//
+int link_load(const char *transport, link_param_t *param)
+{
+    char path[1024];
+    link_param_t p;
+    FILE *f;
+    int n;
+
+    if (! link_path(path, sizeof(path), transport))
+        return 0;
+    f = fopen(path, "r");
+    if (! f)
+        return 0;
+    n = fscanf(f, "size %u depth %u", &p.size, &p.depth);
+    fclose(f);
+    if (n != 2 || p.size == 0 || p.depth == 0)
+        return 0;
+    *param = p;
+    return 1;
+}
+
+//
+// Make a directory for the cache: $HOME/.cache/dmrconfig.
+// Return 0 when not available.
+//
+int cache_dir(char *path, int size)
+{
+    const char *home = getenv("HOME");
+    struct stat st;
 
-    return -(int)(-x + 0.5);
+    if (! home || ! *home)
+        return 0;
+    snprintf(path, size, "%s/.cache", home);
+#ifdef MINGW32
+    mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+    snprintf(path, size, "%s/.cache/dmrconfig", home);
+#ifdef MINGW32
+    mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
 }
 
 //
@@ -279,16 +859,145 @@ void putc_utf8(unsigned short ch, FILE *out)
 }
 
 //
-// Print utf16 text as utf8.
+// Start collecting output for a given file.
+//
+void outbuf_init(outbuf_t *ob, FILE *out)
+{
+    ob->out = out;
+    ob->len = 0;
+}
+
+//
+// Write collected data to the file.
+//
+void outbuf_flush(outbuf_t *ob)
+{
+    if (ob->len > 0) {
+        fwrite(ob->data, 1, ob->len, ob->out);
+        ob->len = 0;
+    }
+}
+
+void outbuf_write(outbuf_t *ob, const char *str, unsigned nbytes)
+{
+    if (ob->len + nbytes > sizeof(ob->data)) {
+        outbuf_flush(ob);
+        if (nbytes > sizeof(ob->data)) {
+            fwrite(str, 1, nbytes, ob->out);
+            return;
+        }
+    }
+    memcpy(&ob->data[ob->len], str, nbytes);
+    ob->len += nbytes;
+}
+
+void outbuf_puts(outbuf_t *ob, const char *str)
+{
+    outbuf_write(ob, str, strlen(str));
+}
+
+//
+// Append formatted text, like fprintf().
+//
+void outbuf_printf(outbuf_t *ob, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(&ob->data[ob->len], sizeof(ob->data) - ob->len, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if (ob->len + n < sizeof(ob->data)) {
+        ob->len += n;
+        return;
+    }
+
+    // Does not fit: flush and format again.
+    outbuf_flush(ob);
+    va_start(ap, fmt);
+    if (n < sizeof(ob->data)) {
+        vsnprintf(ob->data, sizeof(ob->data), fmt, ap);
+        ob->len = n;
+    } else {
+        vfprintf(ob->out, fmt, ap);
+    }
+    va_end(ap);
+}
+
+void outbuf_pad(outbuf_t *ob, int ch, int count)
+{
+    while (count-- > 0)
+        outbuf_putc(ob, ch);
+}
+
+//
+// Append Unicode symbol in UTF-8 encoding.
+//
+void outbuf_utf8(outbuf_t *ob, unsigned short ch)
+{
+    if (ch < 0x80) {
+        outbuf_putc(ob, ch);
+
+    } else if (ch < 0x800) {
+        outbuf_putc(ob, ch >> 6 | 0xc0);
+        outbuf_putc(ob, (ch & 0x3f) | 0x80);
+
+    } else {
+        outbuf_putc(ob, ch >> 12 | 0xe0);
+        outbuf_putc(ob, ((ch >> 6) & 0x3f) | 0x80);
+        outbuf_putc(ob, (ch & 0x3f) | 0x80);
+    }
+}
+
+//
+// Append decimal value, padded with spaces to width.
+// Negative width means left justify.
+//
+void outbuf_uint(outbuf_t *ob, unsigned value, int width)
+{
+    char buf[16], *p = &buf[sizeof(buf)];
+    int n;
+
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    n = &buf[sizeof(buf)] - p;
+    if (width > 0)
+        outbuf_pad(ob, ' ', width - n);
+    outbuf_write(ob, p, n);
+    if (width < 0)
+        outbuf_pad(ob, ' ', -width - n);
+}
+
+//
+// Append string, padded with spaces to width.
+// Negative width means left justify.
+//
+void outbuf_str(outbuf_t *ob, const char *str, int width)
+{
+    int n = strlen(str);
+
+    if (width > 0)
+        outbuf_pad(ob, ' ', width - n);
+    outbuf_write(ob, str, n);
+    if (width < 0)
+        outbuf_pad(ob, ' ', -width - n);
+}
+
+//
+// Append utf16 text as utf8.
 // For short texts, replace space with underscore.
 //
-void print_unicode(FILE *out, const unsigned short *text, unsigned nchars, int fill_flag)
+void outbuf_unicode(outbuf_t *ob, const unsigned short *text, unsigned nchars, int fill_flag)
 {
     unsigned i, ch;
 
     if ((*text == 0xff || *text == 0) && fill_flag) {
         // When text is empty, still print something.
-        unsigned short underscore[2] = { '_', 0 };
+        static const unsigned short underscore[2] = { '_', 0 };
         text = underscore;
     }
     for (i=0; i<nchars && *text; i++) {
@@ -297,20 +1006,17 @@ void print_unicode(FILE *out, const unsigned short *text, unsigned nchars, int f
             ch = ' ';
         if (nchars <= 16 && ch == ' ')
             ch = '_';
-        putc_utf8(ch, out);
-    }
-    if (fill_flag) {
-        for (; i<nchars; i++) {
-            putc(' ', out);
-        }
+        outbuf_utf8(ob, ch);
     }
+    if (fill_flag)
+        outbuf_pad(ob, ' ', nchars - i);
 }
 
 //
-// Print ASCII text until 0xff.
+// Append ASCII text until 0xff.
 // For short texts, replace space with underscore.
 //
-void print_ascii(FILE *out, const unsigned char *text, unsigned nchars, int fill_flag)
+void outbuf_ascii(outbuf_t *ob, const unsigned char *text, unsigned nchars, int fill_flag)
 {
     unsigned i, ch;
 
@@ -324,13 +1030,36 @@ void print_ascii(FILE *out, const unsigned char *text, unsigned nchars, int fill
             ch = ' ';
         if (fill_flag && ch == ' ')
             ch = '_';
-        putc(ch, out);
-    }
-    if (fill_flag) {
-        for (; i<nchars; i++) {
-            putc(' ', out);
-        }
+        outbuf_putc(ob, ch);
     }
+    if (fill_flag)
+        outbuf_pad(ob, ' ', nchars - i);
+}
+
+//
+// Print utf16 text as utf8.
+// For short texts, replace space with underscore.
+//
+void print_unicode(FILE *out, const unsigned short *text, unsigned nchars, int fill_flag)
+{
+    outbuf_t ob;
+
+    outbuf_init(&ob, out);
+    outbuf_unicode(&ob, text, nchars, fill_flag);
+    outbuf_flush(&ob);
+}
+
+//
+// Print ASCII text until 0xff.
+// For short texts, replace space with underscore.
+//
+void print_ascii(FILE *out, const unsigned char *text, unsigned nchars, int fill_flag)
+{
+    outbuf_t ob;
+
+    outbuf_init(&ob, out);
+    outbuf_ascii(&ob, text, nchars, fill_flag);
+    outbuf_flush(&ob);
 }
 
 //
@@ -524,64 +1253,117 @@ int encode_tone(char *str)
 }
 
 //
-// Print frequency (BCD value).
+// Append frequency (BCD value).
 //
-void print_freq(FILE *out, unsigned data)
+void outbuf_freq(outbuf_t *ob, unsigned data)
 {
-    fprintf(out, "%d%d%d.%d%d%d", (data >> 28) & 15, (data >> 24) & 15,
-        (data >> 20) & 15, (data >> 16) & 15,
-        (data >> 12) & 15, (data >> 8) & 15);
+    char buf[32];
+
+    if (!bcd_valid(data)) {
+        // Garbage in memory: print each nibble as a number.
+        int n = snprintf(buf, sizeof(buf), "%d%d%d.%d%d%d",
+            (data >> 28) & 15, (data >> 24) & 15, (data >> 20) & 15,
+            (data >> 16) & 15, (data >> 12) & 15, (data >> 8) & 15);
+        if ((data & 0xff) == 0)
+            n += snprintf(buf + n, sizeof(buf) - n, "  ");
+        else if ((data & 0x0f) == 0)
+            n += snprintf(buf + n, sizeof(buf) - n, "%d ", (data >> 4) & 15);
+        else
+            n += snprintf(buf + n, sizeof(buf) - n, "%d%d", (data >> 4) & 15, data & 15);
+        outbuf_write(ob, buf, n);
+        return;
+    }
+
+    buf[0] = '0' + ((data >> 28) & 15);
+    buf[1] = '0' + ((data >> 24) & 15);
+    buf[2] = '0' + ((data >> 20) & 15);
+    buf[3] = '.';
+    buf[4] = '0' + ((data >> 16) & 15);
+    buf[5] = '0' + ((data >> 12) & 15);
+    buf[6] = '0' + ((data >> 8) & 15);
 
     if ((data & 0xff) == 0) {
-        fputs("  ", out);
+        buf[7] = ' ';
+        buf[8] = ' ';
     } else {
-        fprintf(out, "%d", (data >> 4) & 15);
+        buf[7] = '0' + ((data >> 4) & 15);
         if ((data & 0x0f) == 0) {
-            fputs(" ", out);
+            buf[8] = ' ';
         } else {
-            fprintf(out, "%d", data & 15);
+            buf[8] = '0' + (data & 15);
         }
     }
+    outbuf_write(ob, buf, 9);
 }
 
 //
-// Convert frequency in MHz from floating point to
-// a binary coded decimal format (8 digits).
-// Format: abcdefgh
+// Print frequency (BCD value).
 //
-unsigned mhz_to_abcdefgh(double mhz)
+void print_freq(FILE *out, unsigned data)
 {
-    unsigned hz = iround(mhz * 1000000.0);
-    unsigned a  = (hz / 100000000) % 10;
-    unsigned b  = (hz / 10000000)  % 10;
-    unsigned c  = (hz / 1000000)   % 10;
-    unsigned d  = (hz / 100000)    % 10;
-    unsigned e  = (hz / 10000)     % 10;
-    unsigned f  = (hz / 1000)      % 10;
-    unsigned g  = (hz / 100)       % 10;
-    unsigned h  = (hz / 10)        % 10;
+    outbuf_t ob;
 
-    return a << 28 | b << 24 | c << 20 | d << 16 | e << 12 | f << 8 | g << 4 | h;
+    outbuf_init(&ob, out);
+    outbuf_freq(&ob, data);
+    outbuf_flush(&ob);
 }
 
 //
-// Convert frequency in MHz from floating point to
-// a binary coded decimal format (8 digits).
+// Convert frequency in Hz to a binary coded decimal format
+// (8 digits, in 10 Hz units).
+// Format: abcdefgh
+//
+unsigned hz_to_abcdefgh(unsigned hz)
+{
+    return bcd_encode(hz / 10 % 100000000);
+}
+
+//
+// Convert frequency in Hz to a binary coded decimal format
+// (8 digits, in 10 Hz units).
 // Format: ghefcdab
 //
-unsigned mhz_to_ghefcdab(double mhz)
+unsigned hz_to_ghefcdab(unsigned hz)
 {
-    unsigned hz = iround(mhz * 1000000.0);
-    unsigned a  = (hz / 100000000) % 10;
-    unsigned b  = (hz / 10000000)  % 10;
-    unsigned c  = (hz / 1000000)   % 10;
-    unsigned d  = (hz / 100000)    % 10;
-    unsigned e  = (hz / 10000)     % 10;
-    unsigned f  = (hz / 1000)      % 10;
-    unsigned g  = (hz / 100)       % 10;
-    unsigned h  = (hz / 10)        % 10;
+    return __builtin_bswap32(hz_to_abcdefgh(hz));
+}
 
-    return g << 28 | h << 24 | e << 20 | f << 16 | c << 12 | d << 8 | a << 4 | b;
+//
+// Parse frequency in MHz, like "146.52" or "+0.6", into integer Hz.
+// Digits beyond 1 Hz are rounded.
+// Return 1 on success, 0 when no number found, or when the value
+// exceeds 999.99999 MHz, the limit of the BCD format.
+//
+int parse_mhz(const char *str, int *hz)
+{
+    int negative = 0, ndigits = 0, nfrac = 0;
+    long long value = 0;
+
+    if (*str == '+' || *str == '-')
+        negative = (*str++ == '-');
+
+    for (; *str >= '0' && *str <= '9'; str++, ndigits++) {
+        value = value * 10 + (*str - '0');
+        if (value > 999)
+            return 0;
+    }
+    value *= 1000000;
+    if (*str == '.') {
+        int scale = 100000;
+
+        for (str++; *str >= '0' && *str <= '9'; str++, ndigits++, nfrac++) {
+            if (nfrac < 6)
+                value += (*str - '0') * scale;
+            else if (nfrac == 6 && *str >= '5')
+                value++;
+            scale /= 10;
+        }
+    }
+    if (ndigits == 0 || value > 999999990)
+        return 0;
+
+    *hz = negative ? -value : value;
+    return 1;
 }
 
 //
@@ -590,16 +1372,65 @@ unsigned mhz_to_ghefcdab(double mhz)
 //
 int freq_to_hz(unsigned bcd)
 {
-    int a = (bcd >> 28) & 15;
-    int b = (bcd >> 24) & 15;
-    int c = (bcd >> 20) & 15;
-    int d = (bcd >> 16) & 15;
-    int e = (bcd >> 12) & 15;
-    int f = (bcd >> 8)  & 15;
-    int g = (bcd >> 4)  & 15;
-    int h =  bcd        & 15;
+    return bcd_decode(bcd) * 10;
+}
+
+//
+// Store binary value 0...99999999 as 4 bytes of BCD, most significant first.
+//
+void put_bcd(unsigned char *p, unsigned bin)
+{
+    unsigned bcd = bcd_encode(bin);
 
-    return (((((((a*10 + b) * 10 + c) * 10 + d) * 10 + e) * 10 + f) * 10 + g) * 10 + h) * 10;
+    p[0] = bcd >> 24;
+    p[1] = bcd >> 16;
+    p[2] = bcd >> 8;
+    p[3] = bcd;
+}
+
+//
+// Get binary value from 4 bytes of BCD, most significant first.
+//
+unsigned get_bcd(const unsigned char *p)
+{
+    return bcd_decode(p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]);
+}
+
+//
+// Append frequency as MHz, with as few decimals as needed.
+// Left justified, padded to 8 characters.
+//
+void outbuf_mhz(outbuf_t *ob, unsigned hz)
+{
+    unsigned mhz = hz / 1000000;
+    unsigned frac = hz % 1000000;
+    int ndigits = 6, i;
+    char buf[16];
+
+    if (frac == 0) {
+        outbuf_uint(ob, mhz, -8);
+        return;
+    }
+    if (frac % 10 != 0) {
+        // Needs rounding: use the library.
+        int n = snprintf(buf, sizeof(buf), "%-8.5f", hz / 1000000.0);
+        outbuf_write(ob, buf, n);
+        return;
+    }
+    while (frac % 10 == 0) {
+        frac /= 10;
+        ndigits--;
+    }
+    buf[0] = '.';
+    for (i = ndigits; i > 0; i--) {
+        buf[i] = '0' + frac % 10;
+        frac /= 10;
+    }
+    for (i = 1; mhz >= 10; mhz /= 10)
+        i++;
+    outbuf_uint(ob, hz / 1000000, 0);
+    outbuf_write(ob, buf, ndigits + 1);
+    outbuf_pad(ob, ' ', 8 - (i + ndigits + 1));
 }
 
 //
@@ -607,43 +1438,48 @@ int freq_to_hz(unsigned bcd)
 //
 void print_mhz(FILE *out, unsigned hz)
 {
-    if (hz % 1000000 == 0)
-        fprintf(out, "%-8u", hz / 1000000);
-    else if (hz % 100000 == 0)
-        fprintf(out, "%-8.1f", hz / 1000000.0);
-    else if (hz % 10000 == 0)
-        fprintf(out, "%-8.2f", hz / 1000000.0);
-    else if (hz % 1000 == 0)
-        fprintf(out, "%-8.3f", hz / 1000000.0);
-    else if (hz % 100 == 0)
-        fprintf(out, "%-8.4f", hz / 1000000.0);
-    else
-        fprintf(out, "%-8.5f", hz / 1000000.0);
+    outbuf_t ob;
+
+    outbuf_init(&ob, out);
+    outbuf_mhz(&ob, hz);
+    outbuf_flush(&ob);
 }
 
 //
-// Print the transmit offset or frequency.
+// Append the transmit offset or frequency.
 //
-void print_offset(FILE *out, unsigned rx_bcd, unsigned tx_bcd)
+void outbuf_offset(outbuf_t *ob, unsigned rx_bcd, unsigned tx_bcd)
 {
     int rx_hz = freq_to_hz(rx_bcd);
     int tx_hz = freq_to_hz(tx_bcd);
     int delta = tx_hz - rx_hz;
 
     if (delta == 0) {
-        fprintf(out, "+0       ");
+        outbuf_puts(ob, "+0       ");
     } else if (delta > 0 && delta/50000 <= 255) {
-        fprintf(out, "+");
-        print_mhz(out, delta);
+        outbuf_putc(ob, '+');
+        outbuf_mhz(ob, delta);
     } else if (delta < 0 && -delta/50000 <= 255) {
-        fprintf(out, "-");
-        print_mhz(out, -delta);
+        outbuf_putc(ob, '-');
+        outbuf_mhz(ob, -delta);
     } else {
-        fprintf(out, " ");
-        print_mhz(out, tx_hz);
+        outbuf_putc(ob, ' ');
+        outbuf_mhz(ob, tx_hz);
     }
 }
 
+//
+// Print the transmit offset or frequency.
+//
+void print_offset(FILE *out, unsigned rx_bcd, unsigned tx_bcd)
+{
+    outbuf_t ob;
+
+    outbuf_init(&ob, out);
+    outbuf_offset(&ob, rx_bcd, tx_bcd);
+    outbuf_flush(&ob);
+}
+
 //
 // Compare channel index for qsort().
 // Treat 0 as empty element.
@@ -705,12 +1541,14 @@ int compare_index_ffffffff(const void *pa, const void *pb)
 }
 
 //
-// Print CTSS or DCS tone.
+// Append CTSS or DCS tone.
 //
-void print_tone(FILE *out, unsigned data)
+void outbuf_tone(outbuf_t *ob, unsigned data)
 {
+    char buf[16];
+
     if (data == 0xffff) {
-        fprintf(out, "-    ");
+        outbuf_write(ob, "-    ", 5);
         return;
     }
 
@@ -720,23 +1558,179 @@ void print_tone(FILE *out, unsigned data)
     unsigned c = (data >> 4) & 15;
     unsigned d = data & 15;
 
+    if (b > 9 || c > 9 || d > 9) {
+        // Garbage in memory: print each nibble as a number.
+        int n;
+
+        if (tag < 2)
+            n = (a == 0) ? snprintf(buf, sizeof(buf), "%d%d.%d ", b, c, d) :
+                           snprintf(buf, sizeof(buf), "%d%d%d.%d", a, b, c, d);
+        else
+            n = snprintf(buf, sizeof(buf), "D%d%d%d%c", b, c, d, (tag == 2) ? 'N' : 'I');
+        outbuf_write(ob, buf, n);
+        return;
+    }
+
     switch (tag) {
     default:
         // CTCSS
-        if (a == 0)
-            fprintf(out, "%d%d.%d ", b, c, d);
-        else
-            fprintf(out, "%d%d%d.%d", a, b, c, d);
+        if (a == 0) {
+            buf[0] = '0' + b;
+            buf[1] = '0' + c;
+            buf[2] = '.';
+            buf[3] = '0' + d;
+            buf[4] = ' ';
+        } else {
+            buf[0] = '0' + a;
+            buf[1] = '0' + b;
+            buf[2] = '0' + c;
+            buf[3] = '.';
+            buf[4] = '0' + d;
+        }
         break;
     case 2:
-        // DCS-N
-        fprintf(out, "D%d%d%dN", b, c, d);
-        break;
     case 3:
-        // DCS-I
-        fprintf(out, "D%d%d%dI", b, c, d);
+        // DCS-N or DCS-I
+        buf[0] = 'D';
+        buf[1] = '0' + b;
+        buf[2] = '0' + c;
+        buf[3] = '0' + d;
+        buf[4] = (tag == 2) ? 'N' : 'I';
         break;
     }
+    outbuf_write(ob, buf, 5);
+}
+
+//
+// Print CTSS or DCS tone.
+//
+void print_tone(FILE *out, unsigned data)
+{
+    outbuf_t ob;
+
+    outbuf_init(&ob, out);
+    outbuf_tone(&ob, data);
+    outbuf_flush(&ob);
+}
+
+//
+// Fetch 64 bits of the bitmap, starting from given byte.
+// Bytes past the end of bitmap are read as zeros.
+//
+static uint64_t bitmap_word(const unsigned char *map, int nbytes, int offset)
+{
+    uint64_t word = 0;
+    int n = nbytes - offset;
+
+    if (n >= 8) {
+        memcpy(&word, map + offset, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+    } else {
+        while (--n >= 0)
+            word = word << 8 | map[offset + n];
+    }
+    return word;
+}
+
+//
+// Find next set or clear bit, starting from a given position.
+// Return -1 when not found.
+//
+static int bitmap_find(const unsigned char *map, int nbits, int start, uint64_t invert)
+{
+    int nbytes = (nbits + 7) / 8;
+    int offset;
+    uint64_t word;
+
+    if (start < 0)
+        start = 0;
+    if (start >= nbits)
+        return -1;
+    offset = start / 64 * 8;
+
+    // First word: ignore bits below the start position.
+    word = (bitmap_word(map, nbytes, offset) ^ invert) & (~(uint64_t)0 << (start & 63));
+    for (;;) {
+        if (word != 0) {
+            int i = offset*8 + __builtin_ctzll(word);
+
+            return (i < nbits) ? i : -1;
+        }
+        offset += 8;
+        if (offset >= nbytes)
+            return -1;
+        word = bitmap_word(map, nbytes, offset) ^ invert;
+    }
+}
+
+int bitmap_next_set(const unsigned char *map, int nbits, int start)
+{
+    return bitmap_find(map, nbits, start, 0);
+}
+
+int bitmap_next_clear(const unsigned char *map, int nbits, int start)
+{
+    return bitmap_find(map, nbits, start, ~(uint64_t)0);
+}
+
+//
+// Count set bits in the bitmap.
+//
+int bitmap_count(const unsigned char *map, int nbits)
+{
+    int nbytes = nbits / 8;
+    int offset, count = 0;
+
+    for (offset=0; offset<nbytes; offset+=8) {
+        uint64_t word = bitmap_word(map, nbytes, offset);
+
+        count += __builtin_popcountll(word);
+    }
+
+    // Last partial byte.
+    if (nbits & 7)
+        count += __builtin_popcount(map[nbytes] & ((1 << (nbits & 7)) - 1));
+    return count;
+}
+
+//
+// Set or clear a range of bits.
+// Partial bytes at the ends are updated bit by bit.
+//
+static void bitmap_fill(unsigned char *map, int first, int count, int value)
+{
+    int last = first + count;
+
+    while (first < last && (first & 7)) {
+        if (value)
+            bitmap_set(map, first);
+        else
+            bitmap_clear(map, first);
+        first++;
+    }
+    if (last - first >= 8) {
+        memset(map + first/8, value ? 0xff : 0, (last - first) / 8);
+        first += (last - first) & ~7;
+    }
+    while (first < last) {
+        if (value)
+            bitmap_set(map, first);
+        else
+            bitmap_clear(map, first);
+        first++;
+    }
+}
+
+void bitmap_set_range(unsigned char *map, int first, int count)
+{
+    bitmap_fill(map, first, count, 1);
+}
+
+void bitmap_clear_range(unsigned char *map, int first, int count)
+{
+    bitmap_fill(map, first, count, 0);
 }
 
 //
@@ -795,19 +1789,13 @@ int csv_init(FILE *csv)
 }
 
 //
-// Parse one line of CSV file.
-// Return 1 on success, 0 on EOF.
+// Split a line of CSV file into fields, in place.
+// Return 1 on success, 0 on bad format, -1 when line must be skipped.
+// Reentrant: can be called for different lines in parallel.
 //
-int csv_read(FILE *csv, char **radioid, char **callsign, char **name,
+static int csv_parse(char *line, char **radioid, char **callsign, char **name,
     char **city, char **state, char **country, char **remarks)
 {
-    static char line[256];
-
-again:
-    if (!fgets(line, sizeof(line), csv))
-        return 0;
-    //printf("Line: '%s'\n", line);
-
     // Replace non-ASCII characters with '?'.
     char *p;
     for (p=line; *p; p++) {
@@ -843,11 +1831,9 @@ again:
             *p = 0;
 
         if (*name2) {
-            static char fullname[256];
-            strcpy(fullname, *name);
-            strcat(fullname, " ");
-            strcat(fullname, name2);
-            *name = fullname;
+            // Last name follows the first name:
+            // join them in place, with a space.
+            name2[-1] = ' ';
         }
     }
     *radioid  = trim_spaces(trim_quotes(*radioid),  100);
@@ -860,6 +1846,564 @@ again:
     //printf("%s,%s,%s,%s,%s,%s,%s\n", *radioid, *callsign, *name, *city, *state, *country, *remarks);
 
     if (**radioid < '1' || **radioid > '9')
-        goto again;
+        return -1;
     return 1;
 }
+
+//
+// Parse one line of CSV file.
+// Return 1 on success, 0 on EOF.
+//
+int csv_read(FILE *csv, char **radioid, char **callsign, char **name,
+    char **city, char **state, char **country, char **remarks)
+{
+    static char line[256];
+    int status;
+
+    do {
+        if (!fgets(line, sizeof(line), csv))
+            return 0;
+        //printf("Line: '%s'\n", line);
+
+        status = csv_parse(line, radioid, callsign, name, city, state, country, remarks);
+    } while (status < 0);
+    return status;
+}
+
+//
+// Read the rest of CSV file into memory and parse it,
+// using all processor cores.
+// Lines are read exactly as csv_read() would do,
+// and parsing stops at the first line of bad format.
+// Return number of records, or -1 when out of memory.
+// Free the result by csv_free().
+//
+typedef struct {
+    char        **line;
+    csv_record_t *rec;
+    int          *status;
+    int           nlines;
+    int           nchunks;
+} csv_job_t;
+
+static void csv_parse_chunk(void *arg, int chunk)
+{
+    csv_job_t *job = arg;
+    int first = (int64_t)job->nlines * chunk / job->nchunks;
+    int last  = (int64_t)job->nlines * (chunk + 1) / job->nchunks;
+    int i;
+
+    for (i=first; i<last; i++) {
+        csv_record_t *r = &job->rec[i];
+
+        job->status[i] = csv_parse(job->line[i], &r->radioid, &r->callsign,
+            &r->name, &r->city, &r->state, &r->country, &r->remarks);
+    }
+}
+
+int csv_load(FILE *csv, csv_record_t **result)
+{
+    char *text = 0, line[256];
+    unsigned *start = 0;
+    unsigned textsz = 0, textmax = 0;
+    int nlines = 0, maxlines = 0, i, n;
+    csv_job_t job;
+
+    *result = 0;
+
+    // Read lines into one block of text.
+    while (fgets(line, sizeof(line), csv)) {
+        unsigned len = strlen(line) + 1;
+
+        if (textsz + len > textmax) {
+            textmax = (textmax + len) * 2;
+            text = realloc(text, textmax);
+            if (!text)
+                goto nomem;
+        }
+        if (nlines >= maxlines) {
+            maxlines = (maxlines + 1024) * 2;
+            start = realloc(start, maxlines * sizeof(start[0]));
+            if (!start)
+                goto nomem;
+        }
+        memcpy(&text[textsz], line, len);
+        start[nlines++] = textsz;
+        textsz += len;
+    }
+
+    if (nlines == 0)
+        return 0;
+
+    // Line pointers and status are allocated together with the records.
+    job.nlines = nlines;
+    job.nchunks = parallel_nchunks(nlines, 1000);
+    job.rec = malloc(nlines * sizeof(csv_record_t) + nlines * (sizeof(char*) + sizeof(int)));
+    if (!job.rec)
+        goto nomem;
+    job.line = (char**) &job.rec[nlines];
+    job.status = (int*) &job.line[nlines];
+    for (i=0; i<nlines; i++)
+        job.line[i] = &text[start[i]];
+    free(start);
+
+    parallel_for(job.nchunks, csv_parse_chunk, &job);
+
+    // Compact the result.
+    n = 0;
+    for (i=0; i<nlines; i++) {
+        if (job.status[i] == 0)
+            break;
+        if (job.status[i] > 0)
+            job.rec[n++] = job.rec[i];
+    }
+    if (n == 0) {
+        free(text);
+        free(job.rec);
+        return 0;
+    }
+
+    // Text block is owned by the first record.
+    job.rec[0].text = text;
+    *result = job.rec;
+    return n;
+
+nomem:
+    fprintf(stderr, "Out of memory!\n");
+    free(text);
+    free(start);
+    return -1;
+}
+
+//
+// Free records, allocated by csv_load().
+//
+void csv_free(csv_record_t *records)
+{
+    if (records) {
+        free(records[0].text);
+        free(records);
+    }
+}
+
+//
+// Hash of record fields, except the ID: 32-bit FNV-1a.
+//
+static unsigned csv_hash(const csv_record_t *r)
+{
+    const char *field[6] = { r->callsign, r->name, r->city,
+                             r->state, r->country, r->remarks };
+    unsigned hash = 2166136261u;
+    const char *p;
+    int i;
+
+    for (i=0; i<6; i++) {
+        // Zero byte separates fields.
+        for (p=field[i]; ; p++) {
+            hash = (hash ^ (uint8_t)*p) * 16777619u;
+            if (*p == 0)
+                break;
+        }
+    }
+    return hash;
+}
+
+//
+// Sort keys by ID: radix sort, 8 bits per pass, least significant first.
+// Passes are stable, so records with the same ID stay in order of the file.
+// A pass is skipped when all keys have the same digit.
+//
+static int csv_sort_keys(csv_key_t *keys, int nkeys)
+{
+    csv_key_t *tmp, *src = keys, *dst;
+    int shift, i;
+
+    if (nkeys < 2)
+        return 0;
+    tmp = malloc(nkeys * sizeof(csv_key_t));
+    if (!tmp)
+        return -1;
+    dst = tmp;
+
+    for (shift=0; shift<32; shift+=8) {
+        unsigned count[257];
+        csv_key_t *swap;
+
+        memset(count, 0, sizeof(count));
+        for (i=0; i<nkeys; i++)
+            count[(src[i].id >> shift & 0xff) + 1]++;
+        if (count[(src[0].id >> shift & 0xff) + 1] == (unsigned)nkeys)
+            continue;
+
+        for (i=1; i<256; i++)
+            count[i] += count[i-1];
+        for (i=0; i<nkeys; i++)
+            dst[count[src[i].id >> shift & 0xff]++] = src[i];
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != keys)
+        memcpy(keys, src, nkeys * sizeof(csv_key_t));
+    free(tmp);
+    return 0;
+}
+
+int csv_keys(const csv_record_t *records, int nrecords, csv_key_t **result)
+{
+    csv_key_t *keys;
+    int i;
+
+    *result = 0;
+    keys = malloc((nrecords > 0 ? nrecords : 1) * sizeof(csv_key_t));
+    if (!keys)
+        goto nomem;
+
+    for (i=0; i<nrecords; i++) {
+        keys[i].id = strtoul(records[i].radioid, 0, 10);
+        keys[i].hash = csv_hash(&records[i]);
+        keys[i].index = i;
+    }
+    if (csv_sort_keys(keys, nrecords) < 0)
+        goto nomem;
+    *result = keys;
+    return nrecords;
+
+nomem:
+    fprintf(stderr, "Out of memory!\n");
+    free(keys);
+    return -1;
+}
+
+//
+// Binary snapshot: signature, number of keys, and the keys.
+//
+static const char CSV_KEYS_MAGIC[8] = "DMRIDS1\n";
+
+unsigned long long csv_digest(unsigned long long digest, const void *data, unsigned nbytes)
+{
+    const unsigned char *p = data;
+
+    while (nbytes-- > 0)
+        digest = (digest ^ *p++) * 0x100000001b3ULL;
+    return digest;
+}
+
+int csv_keys_load(const char *filename, csv_key_t **result, csv_region_t *region)
+{
+    char magic[sizeof(CSV_KEYS_MAGIC)];
+    csv_key_t *keys;
+    csv_record_t *rec;
+    unsigned nkeys;
+    int n;
+    FILE *f;
+
+    *result = 0;
+    if (region)
+        memset(region, 0, sizeof(*region));
+    f = fopen(filename, "rb");
+    if (!f)
+        return -1;
+
+    if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+        memcmp(magic, CSV_KEYS_MAGIC, sizeof(magic)) != 0) {
+        // Not a snapshot: parse the CSV file.
+        rewind(f);
+        if (csv_init(f) < 0) {
+            fclose(f);
+            return -1;
+        }
+        n = csv_load(f, &rec);
+        fclose(f);
+        if (n < 0)
+            return -1;
+        n = csv_keys(rec, n, result);
+        csv_free(rec);
+        return n;
+    }
+
+    if (fread(&nkeys, sizeof(nkeys), 1, f) != 1 || nkeys > 0x1000000) {
+        fclose(f);
+        return -1;
+    }
+    keys = malloc((nkeys > 0 ? nkeys : 1) * sizeof(csv_key_t));
+    if (!keys) {
+        fprintf(stderr, "Out of memory!\n");
+        fclose(f);
+        return -1;
+    }
+    if (fread(keys, sizeof(csv_key_t), nkeys, f) != nkeys) {
+        free(keys);
+        fclose(f);
+        return -1;
+    }
+
+    // Region follows the keys, when known.
+    if (region && fread(region, sizeof(*region), 1, f) != 1)
+        memset(region, 0, sizeof(*region));
+    fclose(f);
+    *result = keys;
+    return nkeys;
+}
+
+int csv_keys_save(const char *filename, const csv_key_t *keys, int nkeys,
+    const csv_region_t *region)
+{
+    unsigned n = nkeys;
+    FILE *f;
+
+    f = fopen(filename, "wb");
+    if (!f) {
+        perror(filename);
+        return -1;
+    }
+    if (fwrite(CSV_KEYS_MAGIC, 1, sizeof(CSV_KEYS_MAGIC), f) != sizeof(CSV_KEYS_MAGIC) ||
+        fwrite(&n, sizeof(n), 1, f) != 1 ||
+        fwrite(keys, sizeof(csv_key_t), n, f) != n ||
+        (region && fwrite(region, sizeof(*region), 1, f) != 1)) {
+        perror(filename);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+void csv_delta(const csv_key_t *prev, int nprev, const csv_key_t *cur, int ncur,
+    csv_delta_t *delta, void (*func)(void *arg, const csv_key_t *prev,
+    const csv_key_t *cur), void *arg)
+{
+    int i = 0, k = 0;
+
+    memset(delta, 0, sizeof(*delta));
+    while (i < nprev || k < ncur) {
+        if (k >= ncur || (i < nprev && prev[i].id < cur[k].id)) {
+            delta->removed++;
+            if (func)
+                func(arg, &prev[i], 0);
+            i++;
+        } else if (i >= nprev || cur[k].id < prev[i].id) {
+            delta->added++;
+            if (func)
+                func(arg, 0, &cur[k]);
+            k++;
+        } else {
+            // Same ID: records with duplicate IDs are paired in order.
+            if (prev[i].hash != cur[k].hash)
+                delta->modified++;
+            else if (prev[i].index != cur[k].index)
+                delta->moved++;
+            else
+                delta->unchanged++;
+
+            if (func && (prev[i].hash != cur[k].hash ||
+                         prev[i].index != cur[k].index))
+                func(arg, &prev[i], &cur[k]);
+            i++;
+            k++;
+        }
+    }
+}
+
+//
+// Print a line for every changed record:
+// '+' added, '-' removed, '*' modified.
+// Moved records are only counted.
+//
+static void print_delta_item(void *arg, const csv_key_t *prev, const csv_key_t *cur)
+{
+    FILE *out = arg;
+
+    if (! prev)
+        fprintf(out, "+ %u\n", cur->id);
+    else if (! cur)
+        fprintf(out, "- %u\n", prev->id);
+    else if (prev->hash != cur->hash)
+        fprintf(out, "* %u\n", cur->id);
+}
+
+int csv_print_delta(FILE *out, const char *prev_name, const char *cur_name)
+{
+    csv_key_t *prev, *cur;
+    csv_delta_t delta;
+    int nprev, ncur;
+
+    nprev = csv_keys_load(prev_name, &prev, 0);
+    if (nprev < 0) {
+        fprintf(stderr, "%s: Cannot read snapshot.\n", prev_name);
+        exit(-1);
+    }
+    ncur = csv_keys_load(cur_name, &cur, 0);
+    if (ncur < 0) {
+        fprintf(stderr, "%s: Cannot read snapshot.\n", cur_name);
+        exit(-1);
+    }
+    csv_delta(prev, nprev, cur, ncur, &delta, print_delta_item, out);
+    fprintf(out, "Total %d records: %d added, %d removed, %d modified, %d moved, %d unchanged.\n",
+        ncur, delta.added, delta.removed, delta.modified, delta.moved, delta.unchanged);
+    free(prev);
+    free(cur);
+    return delta.added + delta.removed + delta.modified + delta.moved != 0;
+}
+
+//
+// Number of chunks to split a job of nitems into:
+// one per processor core, but at least min_items per chunk.
+//
+int parallel_nchunks(int nitems, int min_items)
+{
+    int ncpu = 1;
+
+#ifndef MINGW32
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (ncpu > PARALLEL_MAXTHREADS)
+        ncpu = PARALLEL_MAXTHREADS;
+    if (ncpu > nitems / min_items)
+        ncpu = nitems / min_items;
+    if (ncpu < 1)
+        ncpu = 1;
+    return ncpu;
+}
+
+#ifndef MINGW32
+typedef struct {
+    void (*func)(void *arg, int chunk);
+    void *arg;
+    int chunk;
+} parallel_task_t;
+
+static void *parallel_thread(void *ptr)
+{
+    parallel_task_t *task = ptr;
+
+    task->func(task->arg, task->chunk);
+    return 0;
+}
+#endif
+
+//
+// Call func(arg, chunk) for chunk = 0...nchunks-1, in parallel threads.
+// Return when all calls are finished.
+//
+void parallel_for(int nchunks, void (*func)(void *arg, int chunk), void *arg)
+{
+    int i;
+#ifndef MINGW32
+    pthread_t thread[PARALLEL_MAXTHREADS];
+    parallel_task_t task[PARALLEL_MAXTHREADS];
+    int nthreads = 0;
+
+    // Chunk 0 is processed by the current thread.
+    for (i=1; i<nchunks && i<PARALLEL_MAXTHREADS; i++) {
+        task[i].func = func;
+        task[i].arg = arg;
+        task[i].chunk = i;
+        if (pthread_create(&thread[i], 0, parallel_thread, &task[i]) != 0)
+            break;
+        nthreads = i;
+    }
+    func(arg, 0);
+    for (i=1; i<=nthreads; i++)
+        pthread_join(thread[i], 0);
+
+    // When threads are not available, do the rest here.
+    for (i=nthreads+1; i<nchunks; i++)
+        func(arg, i);
+#else
+    for (i=0; i<nchunks; i++)
+        func(arg, i);
+#endif
+}
+
+//
+// Sort array using all processor cores: chunks are sorted
+// by qsort() in parallel, and then merged pairwise.
+//
+typedef struct {
+    char *src;
+    char *dst;
+    int   size;
+    int   (*compare)(const void*, const void*);
+    int   bound[PARALLEL_MAXTHREADS + 1];
+    int   width;
+} sort_job_t;
+
+static void sort_chunk(void *arg, int chunk)
+{
+    sort_job_t *job = arg;
+    int first = job->bound[chunk];
+
+    qsort(job->src + (size_t)first * job->size, job->bound[chunk+1] - first,
+        job->size, job->compare);
+}
+
+static void merge_chunk(void *arg, int chunk)
+{
+    sort_job_t *job = arg;
+    int nruns = job->width;
+    int lo  = job->bound[chunk * 2 * nruns];
+    int mid = job->bound[chunk * 2 * nruns + nruns];
+    int hi  = job->bound[chunk * 2 * nruns + 2 * nruns];
+    int size = job->size;
+    char *a = job->src + (size_t)lo * size;
+    char *b = job->src + (size_t)mid * size;
+    char *aend = b;
+    char *bend = job->src + (size_t)hi * size;
+    char *d = job->dst + (size_t)lo * size;
+
+    while (a < aend && b < bend) {
+        if (job->compare(b, a) < 0) {
+            memcpy(d, b, size);
+            b += size;
+        } else {
+            memcpy(d, a, size);
+            a += size;
+        }
+        d += size;
+    }
+    memcpy(d, a, aend - a);
+    d += aend - a;
+    memcpy(d, b, bend - b);
+}
+
+void parallel_sort(void *base, int nitems, int size,
+    int (*compare)(const void*, const void*))
+{
+    sort_job_t job;
+    int nchunks, i;
+    char *tmp;
+
+    // Round number of chunks down to power of two.
+    nchunks = parallel_nchunks(nitems, 10000);
+    while (nchunks & (nchunks - 1))
+        nchunks &= nchunks - 1;
+
+    tmp = (nchunks > 1) ? malloc((size_t)nitems * size) : 0;
+    if (!tmp) {
+        qsort(base, nitems, size, compare);
+        return;
+    }
+
+    job.src = base;
+    job.dst = tmp;
+    job.size = size;
+    job.compare = compare;
+    for (i=0; i<=nchunks; i++)
+        job.bound[i] = (int64_t)nitems * i / nchunks;
+
+    parallel_for(nchunks, sort_chunk, &job);
+
+    // Merge pairs of sorted runs, doubling the run width each pass.
+    for (job.width = 1; job.width < nchunks; job.width *= 2) {
+        char *swap;
+
+        parallel_for(nchunks / job.width / 2, merge_chunk, &job);
+        swap = job.src;
+        job.src = job.dst;
+        job.dst = swap;
+    }
+    if (job.src != base)
+        memcpy(base, job.src, (size_t)nitems * size);
+    free(tmp);
+}
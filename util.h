@@ -68,15 +68,148 @@ int csv_init(FILE *csv);
 int csv_read(FILE *csv, char **radioid, char **callsign, char **name,
     char **city, char **state, char **country, char **remarks);
 
+//
+// Record of CSV file, as returned by csv_load().
+// Fields point into a text block, owned by the first record.
+//
+typedef struct {
+    char *radioid;
+    char *callsign;
+    char *name;
+    char *city;
+    char *state;
+    char *country;
+    char *remarks;
+    char *text;
+} csv_record_t;
+
+//
+// Read and parse the rest of CSV file, using all processor cores.
+// Return number of records, or -1 on error.
+//
+int csv_load(FILE *csv, csv_record_t **records);
+void csv_free(csv_record_t *records);
+
+//
+// Key of CSV record: DMR ID, hash of the other fields,
+// and position of the record in the file.
+// A snapshot of the database is an array of keys, sorted by ID.
+//
+typedef struct {
+    unsigned id;
+    unsigned hash;
+    unsigned index;
+} csv_key_t;
+
+//
+// Build a snapshot of CSV records: keys sorted by ID.
+// Return number of keys, or -1 when out of memory.
+// Free the result by free().
+//
+int csv_keys(const csv_record_t *records, int nrecords, csv_key_t **keys);
+
+//
+// Region of the radio memory, which holds the database as written:
+// size in bytes and 64-bit FNV-1a digest of the contents.
+//
+typedef struct {
+    unsigned nbytes;
+    unsigned long long digest;
+} csv_region_t;
+
+#define CSV_DIGEST_INIT 0xcbf29ce484222325ULL
+
+//
+// Continue the digest over the given bytes.
+//
+unsigned long long csv_digest(unsigned long long digest, const void *data, unsigned nbytes);
+
+//
+// Load a snapshot from a CSV file, or from a binary file,
+// saved by csv_keys_save().  Return number of keys, or -1 on error.
+// When region is not 0, it gets the region saved with the snapshot,
+// or zero size when not known.
+//
+int csv_keys_load(const char *filename, csv_key_t **keys, csv_region_t *region);
+int csv_keys_save(const char *filename, const csv_key_t *keys, int nkeys,
+    const csv_region_t *region);
+
+//
+// Difference between two snapshots of the database.
+//
+typedef struct {
+    int added;          // New ID
+    int removed;        // ID is gone
+    int modified;       // Same ID, other fields changed
+    int moved;          // Same record at another position
+    int unchanged;
+} csv_delta_t;
+
+//
+// Compare two snapshots by merge-join on ID.
+// For every record, which is not unchanged, call func(arg, prev, cur):
+// prev is 0 for added records, cur is 0 for removed ones.
+//
+void csv_delta(const csv_key_t *prev, int nprev, const csv_key_t *cur, int ncur,
+    csv_delta_t *delta, void (*func)(void *arg, const csv_key_t *prev,
+    const csv_key_t *cur), void *arg);
+
+//
+// Print the difference between two snapshots of the database,
+// given as CSV or binary files. Return 0 when they are the same.
+//
+int csv_print_delta(FILE *out, const char *prev_name, const char *cur_name);
+
+//
+// Parallel execution: call func(arg, chunk) for chunks 0...nchunks-1
+// in separate threads, and wait for all of them.
+//
+#define PARALLEL_MAXTHREADS 16
+int parallel_nchunks(int nitems, int min_items);
+void parallel_for(int nchunks, void (*func)(void *arg, int chunk), void *arg);
+
+//
+// Sort array using all processor cores.
+//
+void parallel_sort(void *base, int nitems, int size,
+    int (*compare)(const void*, const void*));
+
+//
+// Location of the radio to connect: USB bus and port numbers,
+// as named in sysfs, like "1-1.4".  Any radio when not set.
+//
+extern const char *usb_location;
+
+//
+// Find locations of all attached devices with VID:PID from the list.
+//
+int usb_find_locations(const unsigned *vidpid, char (*location)[32], int maxloc);
+
+//
+// Serial number of the connected USB device,
+// or empty string when not known.
+//
+extern char usb_serial[64];
+
 //
 // DFU functions.
 //
 const char *dfu_init(unsigned vid, unsigned pid);
 void dfu_close(void);
 void dfu_erase(unsigned start, unsigned finish);
-void dfu_read_block(int bno, unsigned char *data, int nbytes);
-void dfu_write_block(int bno, unsigned char *data, int nbytes);
+void dfu_read(unsigned offset, unsigned char *data, unsigned nbytes);
+void dfu_write(unsigned offset, unsigned char *data, unsigned nbytes);
+unsigned dfu_transfer_size(void);
 void dfu_reboot(void);
+void dfu_linktest(unsigned offset, unsigned span);
+
+//
+// Range of addresses: start...end-1.
+//
+typedef struct range_t {
+    unsigned start;
+    unsigned end;
+} range_t;
 
 //
 // HID functions.
@@ -88,7 +221,9 @@ void hid_send_recv(const unsigned char *data, unsigned nbytes, unsigned char *rd
 void hid_read_block(int bno, unsigned char *data, int nbytes);
 void hid_read_finish(void);
 void hid_write_block(int bno, unsigned char *data, int nbytes);
+void hid_write_ranges(const range_t *tab, int ntab, unsigned char *mem);
 void hid_write_finish(void);
+void hid_linktest(unsigned addr, unsigned span);
 
 //
 // Serial functions.
@@ -102,26 +237,148 @@ int serial_read(unsigned char *data, int len, int timeout_msec);
 int serial_open_found(int baud_rate);
 void serial_set_pulse_on_open(int enable);
 void serial_read_region(int addr, unsigned char *data, int nbytes);
+void serial_read_bulk(int addr, unsigned char *data, int nbytes);
+void serial_read_region_n(int addr, unsigned char *data, int nbytes, int chunk);
+void serial_linktest(unsigned addr, unsigned span);
 void serial_write_region(int addr, unsigned char *data, int nbytes);
 // Briefly toggle RTS/DTR to nudge devices into programming mode.
 int serial_pulse_rts_dtr(void);
 
+//
+// Direct USB transport for serial radios (Linux only).
+// Used by serial functions when the kernel driver can be detached.
+// Location is the USB bus and ports of the device, like "1-1.4".
+//
+int serial_usb_open(int vid, int pid, const char *location, int baud_rate);
+void serial_usb_close(void);
+int serial_usb_write(const unsigned char *data, int len);
+int serial_usb_read(unsigned char *data, int len, int timeout_msec);
+void serial_usb_flush(void);
+void serial_usb_set_lines(int dtr, int rts);
+
 //
 // Delay in milliseconds.
 //
 void mdelay(unsigned msec);
 
+//
+// Monotonic time in microseconds.
+//
+unsigned long long now_usec(void);
+
+//
+// Adaptive timeout, derived from measured round-trip time
+// as in TCP (RFC 6298): smoothed RTT plus four variances.
+// Retries are bounded, and the timeout doubles on every retry.
+//
+typedef struct {
+    const char *name;       // Name of transport, for statistics
+    unsigned srtt;          // Smoothed round-trip time, usec
+    unsigned rttvar;        // Round-trip time variation, usec
+    unsigned init_msec;     // Timeout before the first sample
+    unsigned min_msec;      // Lower bound of timeout
+    unsigned max_msec;      // Upper bound of timeout
+    unsigned max_retries;   // Retries before giving up
+    unsigned nsamples;      // Statistics: measured transactions
+    unsigned nretries;      // Statistics: retransmissions
+    unsigned nfailures;     // Statistics: transactions given up
+} rtt_t;
+
+#define RTT_INIT(name, init_msec, min_msec, max_msec, max_retries) \
+    { name, 0, 0, init_msec, min_msec, max_msec, max_retries, 0, 0, 0 }
+
+unsigned rtt_timeout(const rtt_t *rtt, unsigned attempt);
+void rtt_sample(rtt_t *rtt, unsigned long long start_usec);
+int rtt_retry(rtt_t *rtt, unsigned attempt);
+unsigned rtt_total_retries(void);
+void rtt_print_stats(const rtt_t *rtt);
+void rtt_save(const rtt_t *rtt);
+
+#define RTT_SAVE_SAMPLES 32     // Enough samples to remember the estimate
+
+//
+// Progress events for orchestration: one JSON object per line,
+// written to a file descriptor. Phase start and end are always
+// emitted, byte counts at most every PROGRESS_INTERVAL_MSEC.
+//
+#define PROGRESS_INTERVAL_MSEC 250
+
+void progress_open(int fd);
+void progress_start(const char *phase, const char *radio);
+void progress_update(unsigned done, unsigned total);
+void progress_retry(const char *transport, unsigned attempt, unsigned timeout_msec);
+void progress_error(const char *transport, const char *message);
+void progress_end(void);
+
+//
+// Dry run: transports do not talk to the radio, but account the
+// transactions they would issue. Reads leave the data intact.
+// The estimate is round trips times the latency of the link,
+// measured on the same cable before, or else the default latency
+// plus payload at the default throughput.
+//
+extern int plan_flag;
+void plan_account(const char *what, unsigned frames, unsigned round_trips, unsigned nbytes);
+void plan_print(FILE *out);
+
+//
+// Link benchmark: a series of harmless reads with varying size
+// of request and number of requests in flight. The best setting
+// is saved in the cache directory, for later sessions.
+//
+typedef struct {
+    unsigned size;              // Bytes per request
+    unsigned depth;             // Requests in flight
+} link_param_t;
+
+typedef int (*link_read_t)(unsigned addr, unsigned char *data, const link_param_t *param);
+
+#define LINKTEST_BYTES  (32*1024)   // Amount of data per setting
+#define LINKTEST_CALLS  1024        // Limit of calls per setting
+
+int linktest_run(const char *transport, link_read_t read,
+    const link_param_t *tab, int ntab, unsigned addr, unsigned span);
+int link_load(const char *transport, link_param_t *param);
+
 //
 // Check for a regular file.
 //
 int is_file(char *filename);
 
 //
-// Convert frequency in MHz from floating point to
-// a binary coded decimal format (8 digits).
+// Make a directory for the cache: $HOME/.cache/dmrconfig.
+// Return 0 when not available.
+//
+int cache_dir(char *path, int size);
+
+//
+// Convert frequency in Hz to a binary coded decimal format (8 digits).
+//
+unsigned hz_to_abcdefgh(unsigned hz);
+unsigned hz_to_ghefcdab(unsigned hz);
+
+//
+// Parse frequency in MHz into integer Hz.
+// Return 1 on success, 0 on error.
+//
+int parse_mhz(const char *str, int *hz);
+
+//
+// Binary coded decimal: 8 digits in 32-bit word.
+// Array versions use SIMD kernels when available.
+//
+unsigned bcd_encode(unsigned bin);
+unsigned bcd_decode(unsigned bcd);
+int bcd_valid(unsigned bcd);
+void bcd_encode_array(unsigned *dst, const unsigned *src, int n);
+void bcd_decode_array(unsigned *dst, const unsigned *src, int n);
+int bcd_select_avx2(int enable);
+
+//
+// Store or fetch 8-digit BCD value as 4 bytes, most significant first.
 //
-unsigned mhz_to_abcdefgh(double mhz);
-unsigned mhz_to_ghefcdab(double mhz);
+void put_bcd(unsigned char *p, unsigned bin);
+unsigned get_bcd(const unsigned char *p);
 
 //
 // Get a binary value of the parameter: On/Off,
@@ -157,6 +414,49 @@ void print_options(FILE *out, const char **tab, int num, const char *info);
 //
 void print_squelch_tones(FILE *out, int normal_only);
 
+//
+// Output buffer: text is collected in memory
+// and written to the file in large blocks.
+//
+typedef struct {
+    FILE     *out;                  // Destination file
+    unsigned len;                   // Number of bytes collected
+    char     data[4096];
+} outbuf_t;
+
+void outbuf_init(outbuf_t *ob, FILE *out);
+void outbuf_flush(outbuf_t *ob);
+void outbuf_write(outbuf_t *ob, const char *str, unsigned nbytes);
+void outbuf_puts(outbuf_t *ob, const char *str);
+void outbuf_printf(outbuf_t *ob, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void outbuf_pad(outbuf_t *ob, int ch, int count);
+void outbuf_utf8(outbuf_t *ob, unsigned short ch);
+
+//
+// Append decimal value or string, padded with spaces to width,
+// like printf "%5u" or "%-5s": negative width means left justify.
+//
+void outbuf_uint(outbuf_t *ob, unsigned value, int width);
+void outbuf_str(outbuf_t *ob, const char *str, int width);
+
+//
+// Append text, frequency or tone, in the same format as print_xxx() routines.
+//
+void outbuf_unicode(outbuf_t *ob, const unsigned short *text, unsigned nchars, int fill_flag);
+void outbuf_ascii(outbuf_t *ob, const unsigned char *text, unsigned nchars, int fill_flag);
+void outbuf_freq(outbuf_t *ob, unsigned data);
+void outbuf_mhz(outbuf_t *ob, unsigned hz);
+void outbuf_offset(outbuf_t *ob, unsigned rx_bcd, unsigned tx_bcd);
+void outbuf_tone(outbuf_t *ob, unsigned data);
+
+static inline void outbuf_putc(outbuf_t *ob, int ch)
+{
+    if (ob->len >= sizeof(ob->data))
+        outbuf_flush(ob);
+    ob->data[ob->len++] = ch;
+}
+
 //
 // Write Unicode symbol to a file in UTF-8 encoding.
 //
@@ -234,3 +534,37 @@ int compare_index_ffffffff(const void *pa, const void *pb);
 // Print CTSS or DCS tone.
 //
 void print_tone(FILE *out, unsigned data);
+
+//
+// Bitmaps of valid records.
+// Bit i is stored in byte i/8, least significant bit first.
+//
+#define bitmap_test(map, i)  ((((const unsigned char*)(map))[(i) / 8] >> ((i) & 7)) & 1)
+#define bitmap_set(map, i)   (((unsigned char*)(map))[(i) / 8] |= 1 << ((i) & 7))
+#define bitmap_clear(map, i) (((unsigned char*)(map))[(i) / 8] &= ~(1 << ((i) & 7)))
+
+//
+// Find next set (or clear) bit at position start or later,
+// scanning by 64-bit words. Return -1 when not found.
+//
+int bitmap_next_set(const unsigned char *map, int nbits, int start);
+int bitmap_next_clear(const unsigned char *map, int nbits, int start);
+
+//
+// Loop over all set (or clear) bits of the bitmap.
+//
+#define bitmap_foreach_set(i, map, nbits) \
+    for (i = bitmap_next_set(map, nbits, 0); i >= 0; i = bitmap_next_set(map, nbits, (i) + 1))
+#define bitmap_foreach_clear(i, map, nbits) \
+    for (i = bitmap_next_clear(map, nbits, 0); i >= 0; i = bitmap_next_clear(map, nbits, (i) + 1))
+
+//
+// Count set bits in the bitmap.
+//
+int bitmap_count(const unsigned char *map, int nbits);
+
+//
+// Set or clear a range of bits.
+//
+void bitmap_set_range(unsigned char *map, int first, int count);
+void bitmap_clear_range(unsigned char *map, int first, int count);
@@ -394,20 +394,54 @@ static void uv380_print_version(radio_device_t *radio, FILE *out)
     }
 }
 
+//
+// Read the block with timestamp, radio name and ID,
+// and a few random blocks, and check the cached image.
+//
+static int cache_valid()
+{
+    general_settings_t *gs = GET_SETTINGS();
+    unsigned n = dfu_transfer_size();
+    range_t tab[4];
+    int i;
+
+    // Radio ID identifies the cached image.
+    tab[0].start = gs->radio_id - radio_mem;
+    tab[0].end = tab[0].start + sizeof(gs->radio_id);
+
+    for (i=1; i<4; i++) {
+        tab[i].start = (i == 1) ? OFFSET_TIMESTMP / n * n : rand() % (MEMSZ / n) * n;
+        tab[i].end = tab[i].start + n;
+        dfu_read(tab[i].start, &radio_mem[tab[i].start], n);
+    }
+    return radio_cache_lookup(tab, 4);
+}
+
 //
 // Read memory image from the device.
+// Skip the download when the cached image is still valid.
 //
 static void uv380_download(radio_device_t *radio)
 {
-    int bno;
+    unsigned addr, n, kb;
 
-    for (bno=0; bno<MEMSZ/1024; bno++) {
-        dfu_read_block(bno, &radio_mem[bno*1024], 1024);
+    if (cache_valid())
+        return;
 
-        ++radio_progress;
-        if (radio_progress % 32 == 0) {
-            fprintf(stderr, "#");
-            fflush(stderr);
+    for (addr=0; addr<MEMSZ; addr+=n) {
+        n = dfu_transfer_size();
+        if (n > MEMSZ - addr)
+            n = MEMSZ - addr;
+        dfu_read(addr, &radio_mem[addr], n);
+        radio_mem_ready(addr + n);
+        progress_update(addr + n, MEMSZ);
+
+        for (kb=0; kb<n/1024; kb++) {
+            ++radio_progress;
+            if (radio_progress % 32 == 0) {
+                fprintf(stderr, "#");
+                fflush(stderr);
+            }
         }
     }
 }
@@ -417,21 +451,36 @@ static void uv380_download(radio_device_t *radio)
 //
 static void uv380_upload(radio_device_t *radio, int cont_flag)
 {
-    int bno;
+    unsigned addr, n, kb;
 
     dfu_erase(0, MEMSZ);
 
-    for (bno=0; bno<MEMSZ/1024; bno++) {
-        dfu_write_block(bno, &radio_mem[bno*1024], 1024);
-
-        ++radio_progress;
-        if (radio_progress % 32 == 0) {
-            fprintf(stderr, "#");
-            fflush(stderr);
+    for (addr=0; addr<MEMSZ; addr+=n) {
+        n = dfu_transfer_size();
+        if (n > MEMSZ - addr)
+            n = MEMSZ - addr;
+        radio_mem_wait(addr + n);
+        dfu_write(addr, &radio_mem[addr], n);
+        progress_update(addr + n, MEMSZ);
+
+        for (kb=0; kb<n/1024; kb++) {
+            ++radio_progress;
+            if (radio_progress % 32 == 0) {
+                fprintf(stderr, "#");
+                fflush(stderr);
+            }
         }
     }
 }
 
+//
+// Benchmark the link with reads of the configuration memory.
+//
+static void uv380_linktest(radio_device_t *radio)
+{
+    dfu_linktest(0, 256*1024);
+}
+
 //
 // Check whether the memory image is compatible with this device.
 //
@@ -630,7 +679,7 @@ static int is_valid_frequency(int mhz)
 //
 // Set the parameters for a given memory channel.
 //
-static void setup_channel(int i, int mode, char *name, double rx_mhz, double tx_mhz,
+static void setup_channel(int i, int mode, char *name, int rx_hz, int tx_hz,
     int power, int scanlist, int squelch, int tot, int rxonly,
     int admit, int colorcode, int timeslot, int grouplist, int contact,
     int rxtone, int txtone, int width)
@@ -648,8 +697,8 @@ static void setup_channel(int i, int mode, char *name, double rx_mhz, double tx_
     ch->scan_list_index     = scanlist;
     ch->group_list_index    = grouplist;
     ch->squelch             = squelch;
-    ch->rx_frequency        = mhz_to_abcdefgh(rx_mhz);
-    ch->tx_frequency        = mhz_to_abcdefgh(tx_mhz);
+    ch->rx_frequency        = hz_to_abcdefgh(rx_hz);
+    ch->tx_frequency        = hz_to_abcdefgh(tx_hz);
     ch->ctcss_dcs_receive   = rxtone;
     ch->ctcss_dcs_transmit  = txtone;
     ch->power               = power;
@@ -748,7 +797,7 @@ static void erase_channel(int i)
     utf8_decode(ch->name, "", 16);
 }
 
-static void print_chanlist(FILE *out, uint16_t *unsorted, int nchan)
+static void print_chanlist(outbuf_t *out, uint16_t *unsorted, int nchan)
 {
     int last  = -1;
     int range = 0;
@@ -768,54 +817,54 @@ static void print_chanlist(FILE *out, uint16_t *unsorted, int nchan)
             range = 1;
         } else {
             if (range) {
-                fprintf(out, "-%d", last);
+                outbuf_printf(out, "-%d", last);
                 range = 0;
             }
             if (n > 0)
-                fprintf(out, ",");
-            fprintf(out, "%d", cnum);
+                outbuf_printf(out, ",");
+            outbuf_printf(out, "%d", cnum);
         }
         last = cnum;
     }
     if (range)
-        fprintf(out, "-%d", last);
+        outbuf_printf(out, "-%d", last);
 }
 
-static void print_id(FILE *out, int verbose)
+static void print_id(outbuf_t *out, int verbose)
 {
     general_settings_t *gs = GET_SETTINGS();
     unsigned id = gs->radio_id[0] | (gs->radio_id[1] << 8) | (gs->radio_id[2] << 16);
 
     if (verbose)
-        fprintf(out, "\n# Unique DMR ID and name of this radio.");
-    fprintf(out, "\nID: %u\nName: ", id);
+        outbuf_printf(out, "\n# Unique DMR ID and name of this radio.");
+    outbuf_printf(out, "\nID: %u\nName: ", id);
     if (VALID_TEXT(gs->radio_name)) {
-        print_unicode(out, gs->radio_name, 16, 0);
+        outbuf_unicode(out, gs->radio_name, 16, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
 }
 
-static void print_intro(FILE *out, int verbose)
+static void print_intro(outbuf_t *out, int verbose)
 {
     general_settings_t *gs = GET_SETTINGS();
 
     if (verbose)
-        fprintf(out, "\n# Text displayed when the radio powers up.\n");
-    fprintf(out, "Intro Line 1: ");
+        outbuf_printf(out, "\n# Text displayed when the radio powers up.\n");
+    outbuf_printf(out, "Intro Line 1: ");
     if (VALID_TEXT(gs->intro_line1)) {
-        print_unicode(out, gs->intro_line1, 10, 0);
+        outbuf_unicode(out, gs->intro_line1, 10, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\nIntro Line 2: ");
+    outbuf_printf(out, "\nIntro Line 2: ");
     if (VALID_TEXT(gs->intro_line2)) {
-        print_unicode(out, gs->intro_line2, 10, 0);
+        outbuf_unicode(out, gs->intro_line2, 10, 0);
     } else {
-        fprintf(out, "-");
+        outbuf_printf(out, "-");
     }
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
 }
 
 //
@@ -845,30 +894,30 @@ static int have_channels(int mode)
 //      RX Only
 //      Admit Criteria
 //
-static void print_chan_base(FILE *out, channel_t *ch, int cnum)
+static void print_chan_base(outbuf_t *out, channel_t *ch, int cnum)
 {
-    fprintf(out, "%5d   ", cnum);
-    print_unicode(out, ch->name, 16, 1);
-    fprintf(out, " ");
-    print_freq(out, ch->rx_frequency);
-    fprintf(out, " ");
-    print_offset(out, ch->rx_frequency, ch->tx_frequency);
+    outbuf_printf(out, "%5d   ", cnum);
+    outbuf_unicode(out, ch->name, 16, 1);
+    outbuf_printf(out, " ");
+    outbuf_freq(out, ch->rx_frequency);
+    outbuf_printf(out, " ");
+    outbuf_offset(out, ch->rx_frequency, ch->tx_frequency);
 
-    fprintf(out, "%-4s  ", POWER_NAME[ch->power]);
+    outbuf_printf(out, "%-4s  ", POWER_NAME[ch->power]);
 
     if (ch->scan_list_index == 0)
-        fprintf(out, "-    ");
+        outbuf_printf(out, "-    ");
     else
-        fprintf(out, "%-4d ", ch->scan_list_index);
+        outbuf_printf(out, "%-4d ", ch->scan_list_index);
 
     if (ch->tot == 0)
-        fprintf(out, "-   ");
+        outbuf_printf(out, "-   ");
     else
-        fprintf(out, "%-3d ", ch->tot * 15);
+        outbuf_printf(out, "%-3d ", ch->tot * 15);
 
-    fprintf(out, "%c  ", "-+"[ch->rx_only]);
+    outbuf_printf(out, "%c  ", "-+"[ch->rx_only]);
 
-    fprintf(out, "%-6s ", ADMIT_NAME[ch->admit_criteria]);
+    outbuf_printf(out, "%-6s ", ADMIT_NAME[ch->admit_criteria]);
 }
 
 #ifdef PRINT_EXTENDED_PARAMS
@@ -880,42 +929,42 @@ static void print_chan_base(FILE *out, channel_t *ch, int cnum)
 //      Lone Worker
 //      VOX
 //
-static void print_chan_ext(FILE *out, channel_t *ch)
+static void print_chan_ext(outbuf_t *out, channel_t *ch)
 {
-    fprintf(out, "%-3d ", ch->tot_rekey_delay);
-    fprintf(out, "%-5s ", REF_FREQUENCY[ch->rx_ref_frequency]);
-    fprintf(out, "%-5s ", REF_FREQUENCY[ch->tx_ref_frequency]);
-    fprintf(out, "%c  ", "-+"[ch->lone_worker]);
-    fprintf(out, "%c   ", "-+"[ch->vox]);
+    outbuf_printf(out, "%-3d ", ch->tot_rekey_delay);
+    outbuf_printf(out, "%-5s ", REF_FREQUENCY[ch->rx_ref_frequency]);
+    outbuf_printf(out, "%-5s ", REF_FREQUENCY[ch->tx_ref_frequency]);
+    outbuf_printf(out, "%c  ", "-+"[ch->lone_worker]);
+    outbuf_printf(out, "%c   ", "-+"[ch->vox]);
 }
 #endif
 
-static void print_digital_channels(FILE *out, int verbose)
+static void print_digital_channels(outbuf_t *out, int verbose)
 {
     int i;
 
     if (verbose) {
-        fprintf(out, "# Table of digital channels.\n");
-        fprintf(out, "# 1) Channel number: 1-%d\n", NCHAN);
-        fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-        fprintf(out, "# 3) Receive frequency in MHz\n");
-        fprintf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
-        fprintf(out, "# 5) Transmit power: High, Mid, Low\n");
-        fprintf(out, "# 6) Scan list: - or index in Scanlist table\n");
-        fprintf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
-        fprintf(out, "# 8) Receive only: -, +\n");
-        fprintf(out, "# 9) Admit criteria: -, Free, Color\n");
-        fprintf(out, "# 10) Color code: 0, 1, 2, 3... 15\n");
-        fprintf(out, "# 11) Time slot: 1 or 2\n");
-        fprintf(out, "# 12) Receive group list: - or index in Grouplist table\n");
-        fprintf(out, "# 13) Contact for transmit: - or index in Contacts table\n");
-        fprintf(out, "#\n");
-    }
-    fprintf(out, "Digital Name             Receive   Transmit Power Scan TOT RO Admit  Color Slot RxGL TxContact");
+        outbuf_printf(out, "# Table of digital channels.\n");
+        outbuf_printf(out, "# 1) Channel number: 1-%d\n", NCHAN);
+        outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+        outbuf_printf(out, "# 3) Receive frequency in MHz\n");
+        outbuf_printf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
+        outbuf_printf(out, "# 5) Transmit power: High, Mid, Low\n");
+        outbuf_printf(out, "# 6) Scan list: - or index in Scanlist table\n");
+        outbuf_printf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
+        outbuf_printf(out, "# 8) Receive only: -, +\n");
+        outbuf_printf(out, "# 9) Admit criteria: -, Free, Color\n");
+        outbuf_printf(out, "# 10) Color code: 0, 1, 2, 3... 15\n");
+        outbuf_printf(out, "# 11) Time slot: 1 or 2\n");
+        outbuf_printf(out, "# 12) Receive group list: - or index in Grouplist table\n");
+        outbuf_printf(out, "# 13) Contact for transmit: - or index in Contacts table\n");
+        outbuf_printf(out, "#\n");
+    }
+    outbuf_printf(out, "Digital Name             Receive   Transmit Power Scan TOT RO Admit  Color Slot RxGL TxContact");
 #ifdef PRINT_EXTENDED_PARAMS
-    fprintf(out, " AS InCall Sq Dly RxRef TxRef LW VOX EmSys Privacy  PN PCC EAA DCC DCDM");
+    outbuf_printf(out, " AS InCall Sq Dly RxRef TxRef LW VOX EmSys Privacy  PN PCC EAA DCC DCDM");
 #endif
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
     for (i=0; i<NCHAN; i++) {
         channel_t *ch = GET_CHANNEL(i);
 
@@ -930,20 +979,20 @@ static void print_digital_channels(FILE *out, int verbose)
         //      Repeater Slot
         //      Group List
         //      Contact Name
-        fprintf(out, "%-5d %-3d  ", ch->colorcode, ch->repeater_slot);
+        outbuf_printf(out, "%-5d %-3d  ", ch->colorcode, ch->repeater_slot);
 
         if (ch->group_list_index == 0)
-            fprintf(out, "-    ");
+            outbuf_printf(out, "-    ");
         else
-            fprintf(out, "%-4d ", ch->group_list_index);
+            outbuf_printf(out, "%-4d ", ch->group_list_index);
 
         if (ch->contact_name_index == 0)
-            fprintf(out, "-");
+            outbuf_printf(out, "-");
         else
-            fprintf(out, "%-5d", ch->contact_name_index);
+            outbuf_printf(out, "%-5d", ch->contact_name_index);
 
 #ifdef PRINT_EXTENDED_PARAMS
-        fprintf(out, "     "):
+        outbuf_printf(out, "     "):
 
         print_chan_ext(out, ch);
 
@@ -959,73 +1008,73 @@ static void print_digital_channels(FILE *out, int verbose)
         //      Data Call Confirmed
         //      DCDM switch (inverted)
         //      Leader/MS
-        fprintf(out, "%c  ", "-+"[ch->autoscan]);
-        fprintf(out, "%-6s ", INCALL_NAME[ch->in_call_criteria]);
+        outbuf_printf(out, "%c  ", "-+"[ch->autoscan]);
+        outbuf_printf(out, "%-6s ", INCALL_NAME[ch->in_call_criteria]);
 
         if (ch->squelch <= 9)
-            fprintf(out, "%1d  ", ch->squelch);
+            outbuf_printf(out, "%1d  ", ch->squelch);
         else
-            fprintf(out, "1  ");
+            outbuf_printf(out, "1  ");
 
         if (ch->emergency_system_index == 0)
-            fprintf(out, "-     ");
+            outbuf_printf(out, "-     ");
         else
-            fprintf(out, "%-5d ", ch->emergency_system_index);
+            outbuf_printf(out, "%-5d ", ch->emergency_system_index);
 
-        fprintf(out, "%-8s ", PRIVACY_NAME[ch->privacy]);
+        outbuf_printf(out, "%-8s ", PRIVACY_NAME[ch->privacy]);
 
         if (ch->privacy == PRIV_NONE)
-            fprintf(out, "-  ");
+            outbuf_printf(out, "-  ");
         else
-            fprintf(out, "%-2d ", ch->privacy_no + 1);
+            outbuf_printf(out, "%-2d ", ch->privacy_no + 1);
 
-        fprintf(out, "%c   ", "-+"[ch->private_call_conf]);
-        fprintf(out, "%c   ", "-+"[ch->emergency_alarm_ack]);
-        fprintf(out, "%c   ", "-+"[ch->data_call_conf]);
+        outbuf_printf(out, "%c   ", "-+"[ch->private_call_conf]);
+        outbuf_printf(out, "%c   ", "-+"[ch->emergency_alarm_ack]);
+        outbuf_printf(out, "%c   ", "-+"[ch->data_call_conf]);
 
         if (ch->dcdm_switch_dis)
-            fprintf(out, "-     ");
+            outbuf_printf(out, "-     ");
         else
-            fprintf(out, "%-6s", ch->leader_ms ? "MS" : "Leader");
+            outbuf_printf(out, "%-6s", ch->leader_ms ? "MS" : "Leader");
 #endif
         // Print contact name as a comment.
         if (ch->contact_name_index > 0) {
             contact_t *ct = GET_CONTACT(ch->contact_name_index - 1);
             if (VALID_CONTACT(ct)) {
-                fprintf(out, " # ");
-                print_unicode(out, ct->name, 16, 0);
+                outbuf_printf(out, " # ");
+                outbuf_unicode(out, ct->name, 16, 0);
             }
         }
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
     }
 }
 
-static void print_analog_channels(FILE *out, int verbose)
+static void print_analog_channels(outbuf_t *out, int verbose)
 {
     int i;
 
     if (verbose) {
-        fprintf(out, "# Table of analog channels.\n");
-        fprintf(out, "# 1) Channel number: 1-%d\n", NCHAN);
-        fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-        fprintf(out, "# 3) Receive frequency in MHz\n");
-        fprintf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
-        fprintf(out, "# 5) Transmit power: High, Mid, Low\n");
-        fprintf(out, "# 6) Scan list: - or index\n");
-        fprintf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
-        fprintf(out, "# 8) Receive only: -, +\n");
-        fprintf(out, "# 9) Admit criteria: -, Free, Tone\n");
-        fprintf(out, "# 10) Squelch level: 0, 1, 2, 3, 4, 5, 6, 7, 8, 9\n");
-        fprintf(out, "# 11) Guard tone for receive, or '-' to disable\n");
-        fprintf(out, "# 12) Guard tone for transmit, or '-' to disable\n");
-        fprintf(out, "# 13) Bandwidth in kHz: 12.5, 20, 25\n");
-        fprintf(out, "#\n");
-    }
-    fprintf(out, "Analog  Name             Receive   Transmit Power Scan TOT RO Admit  Sq RxTone TxTone Width");
+        outbuf_printf(out, "# Table of analog channels.\n");
+        outbuf_printf(out, "# 1) Channel number: 1-%d\n", NCHAN);
+        outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+        outbuf_printf(out, "# 3) Receive frequency in MHz\n");
+        outbuf_printf(out, "# 4) Transmit frequency or +/- offset in MHz\n");
+        outbuf_printf(out, "# 5) Transmit power: High, Mid, Low\n");
+        outbuf_printf(out, "# 6) Scan list: - or index\n");
+        outbuf_printf(out, "# 7) Transmit timeout timer in seconds: 0, 15, 30, 45... 555\n");
+        outbuf_printf(out, "# 8) Receive only: -, +\n");
+        outbuf_printf(out, "# 9) Admit criteria: -, Free, Tone\n");
+        outbuf_printf(out, "# 10) Squelch level: 0, 1, 2, 3, 4, 5, 6, 7, 8, 9\n");
+        outbuf_printf(out, "# 11) Guard tone for receive, or '-' to disable\n");
+        outbuf_printf(out, "# 12) Guard tone for transmit, or '-' to disable\n");
+        outbuf_printf(out, "# 13) Bandwidth in kHz: 12.5, 20, 25\n");
+        outbuf_printf(out, "#\n");
+    }
+    outbuf_printf(out, "Analog  Name             Receive   Transmit Power Scan TOT RO Admit  Sq RxTone TxTone Width");
 #ifdef PRINT_EXTENDED_PARAMS
-    fprintf(out, " AS Dly RxRef TxRef LW VOX RxSign TxSign ID TOFreq");
+    outbuf_printf(out, " AS Dly RxRef TxRef LW VOX RxSign TxSign ID TOFreq");
 #endif
-    fprintf(out, "\n");
+    outbuf_printf(out, "\n");
     for (i=0; i<NCHAN; i++) {
         channel_t *ch = GET_CHANNEL(i);
 
@@ -1041,14 +1090,14 @@ static void print_analog_channels(FILE *out, int verbose)
         //      CTCSS/DCS Enc
         //      Bandwidth
         if (ch->squelch <= 9)
-            fprintf(out, "%1d  ", ch->squelch);
+            outbuf_printf(out, "%1d  ", ch->squelch);
         else
-            fprintf(out, "1  ");
+            outbuf_printf(out, "1  ");
 
-        print_tone(out, ch->ctcss_dcs_receive);
-        fprintf(out, "  ");
-        print_tone(out, ch->ctcss_dcs_transmit);
-        fprintf(out, "  %s", BANDWIDTH[ch->bandwidth]);
+        outbuf_tone(out, ch->ctcss_dcs_receive);
+        outbuf_printf(out, "  ");
+        outbuf_tone(out, ch->ctcss_dcs_transmit);
+        outbuf_printf(out, "  %s", BANDWIDTH[ch->bandwidth]);
 
 #ifdef PRINT_EXTENDED_PARAMS
         print_chan_ext(out, ch);
@@ -1058,12 +1107,12 @@ static void print_analog_channels(FILE *out, int verbose)
         //      Tx Signaling System
         //      Display PTT ID (inverted)
         //      Non-QT/DQT Turn-off Freq.
-        fprintf(out, "%-6s ", SIGNALING_SYSTEM[ch->rx_signaling_syst]);
-        fprintf(out, "%-6s ", SIGNALING_SYSTEM[ch->tx_signaling_syst]);
-        fprintf(out, "%c  ", "+-"[ch->display_pttid_dis]);
-        fprintf(out, "%s", TURNOFF_FREQ[ch->turn_off_freq]);
+        outbuf_printf(out, "%-6s ", SIGNALING_SYSTEM[ch->rx_signaling_syst]);
+        outbuf_printf(out, "%-6s ", SIGNALING_SYSTEM[ch->tx_signaling_syst]);
+        outbuf_printf(out, "%c  ", "+-"[ch->display_pttid_dis]);
+        outbuf_printf(out, "%s", TURNOFF_FREQ[ch->turn_off_freq]);
 #endif
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
     }
 }
 
@@ -1134,23 +1183,25 @@ static int have_messages()
 //
 // Print full information about the device configuration.
 //
-static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
+static void uv380_print_config(radio_device_t *radio, FILE *file, int verbose)
 {
+    outbuf_t ob, *out = &ob;
     int i;
 
-    fprintf(out, "Radio: %s\n", radio->name);
+    fprintf(file, "Radio: %s\n", radio->name);
     if (verbose)
-        uv380_print_version(radio, out);
+        uv380_print_version(radio, file);
+    outbuf_init(&ob, file);
 
     //
     // Channels.
     //
     if (have_channels(MODE_DIGITAL)) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         print_digital_channels(out, verbose);
     }
     if (have_channels(MODE_ANALOG)) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         print_analog_channels(out, verbose);
     }
 
@@ -1158,15 +1209,15 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Zones.
     //
     if (have_zones()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of channel zones.\n");
-            fprintf(out, "# 1) Zone number: 1-%d\n", NZONES);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) List of channels: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of channel zones.\n");
+            outbuf_printf(out, "# 1) Zone number: 1-%d\n", NZONES);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) List of channels: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Zone    Name             Channels\n");
+        outbuf_printf(out, "Zone    Name             Channels\n");
         for (i=0; i<NZONES; i++) {
             zone_t     *z    = GET_ZONE(i);
             zone_ext_t *zext = GET_ZONEXT(i);
@@ -1176,27 +1227,27 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%4da   ", i + 1);
-            print_unicode(out, z->name, 16, 1);
-            fprintf(out, " ");
+            outbuf_printf(out, "%4da   ", i + 1);
+            outbuf_unicode(out, z->name, 16, 1);
+            outbuf_printf(out, " ");
             if (z->member_a[0]) {
                 print_chanlist(out, z->member_a, 16);
                 if (zext->ext_a[0]) {
-                    fprintf(out, ",");
+                    outbuf_printf(out, ",");
                     print_chanlist(out, zext->ext_a, 48);
                 }
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
 
-            fprintf(out, "%4db   -                ", i + 1);
+            outbuf_printf(out, "%4db   -                ", i + 1);
             if (zext->member_b[0]) {
                 print_chanlist(out, zext->member_b, 64);
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
@@ -1204,22 +1255,22 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Scan lists.
     //
     if (have_scanlists()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of scan lists.\n");
-            fprintf(out, "# 1) Scan list number: 1-%d\n", NSCANL);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) Priority channel 1 (50%% of scans): -, Sel or index\n");
-            fprintf(out, "# 4) Priority channel 2 (25%% of scans): -, Sel or index\n");
-            fprintf(out, "# 5) Designated transmit channel: Last, Sel or index\n");
-            fprintf(out, "# 6) List of channels: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of scan lists.\n");
+            outbuf_printf(out, "# 1) Scan list number: 1-%d\n", NSCANL);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) Priority channel 1 (50%% of scans): -, Sel or index\n");
+            outbuf_printf(out, "# 4) Priority channel 2 (25%% of scans): -, Sel or index\n");
+            outbuf_printf(out, "# 5) Designated transmit channel: Last, Sel or index\n");
+            outbuf_printf(out, "# 6) List of channels: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Scanlist Name             PCh1 PCh2 TxCh ");
+        outbuf_printf(out, "Scanlist Name             PCh1 PCh2 TxCh ");
 #ifdef PRINT_EXTENDED_PARAMS
-        fprintf(out, "Hold Smpl ");
+        outbuf_printf(out, "Hold Smpl ");
 #endif
-        fprintf(out, "Channels\n");
+        outbuf_printf(out, "Channels\n");
         for (i=0; i<NSCANL; i++) {
             scanlist_t *sl = GET_SCANLIST(i);
 
@@ -1228,39 +1279,39 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%5d    ", i + 1);
-            print_unicode(out, sl->name, 16, 1);
+            outbuf_printf(out, "%5d    ", i + 1);
+            outbuf_unicode(out, sl->name, 16, 1);
             if (sl->priority_ch1 == 0xffff) {
-                fprintf(out, " -    ");
+                outbuf_printf(out, " -    ");
             } else if (sl->priority_ch1 == 0) {
-                fprintf(out, " Sel  ");
+                outbuf_printf(out, " Sel  ");
             } else {
-                fprintf(out, " %-4d ", sl->priority_ch1);
+                outbuf_printf(out, " %-4d ", sl->priority_ch1);
             }
             if (sl->priority_ch2 == 0xffff) {
-                fprintf(out, "-    ");
+                outbuf_printf(out, "-    ");
             } else if (sl->priority_ch2 == 0) {
-                fprintf(out, "Sel  ");
+                outbuf_printf(out, "Sel  ");
             } else {
-                fprintf(out, "%-4d ", sl->priority_ch2);
+                outbuf_printf(out, "%-4d ", sl->priority_ch2);
             }
             if (sl->tx_designated_ch == 0xffff) {
-                fprintf(out, "Last ");
+                outbuf_printf(out, "Last ");
             } else if (sl->tx_designated_ch == 0) {
-                fprintf(out, "Sel  ");
+                outbuf_printf(out, "Sel  ");
             } else {
-                fprintf(out, "%-4d ", sl->tx_designated_ch);
+                outbuf_printf(out, "%-4d ", sl->tx_designated_ch);
             }
 #ifdef PRINT_EXTENDED_PARAMS
-            fprintf(out, "%-4d %-4d ",
+            outbuf_printf(out, "%-4d %-4d ",
                 sl->sign_hold_time * 25, sl->prio_sample_time * 250);
 #endif
             if (sl->member[0]) {
                 print_chanlist(out, sl->member, 31);
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
@@ -1268,17 +1319,17 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Contacts.
     //
     if (have_contacts()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of contacts.\n");
-            fprintf(out, "# 1) Contact number: 1-%d\n", NCONTACTS);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) Call type: Group, Private, All\n");
-            fprintf(out, "# 4) Call ID: 1...16777215\n");
-            fprintf(out, "# 5) Call receive tone: -, +\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of contacts.\n");
+            outbuf_printf(out, "# 1) Contact number: 1-%d\n", NCONTACTS);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) Call type: Group, Private, All\n");
+            outbuf_printf(out, "# 4) Call ID: 1...16777215\n");
+            outbuf_printf(out, "# 5) Call receive tone: -, +\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Contact Name             Type    ID       RxTone\n");
+        outbuf_printf(out, "Contact Name             Type    ID       RxTone\n");
         for (i=0; i<NCONTACTS; i++) {
             contact_t *ct = GET_CONTACT(i);
 
@@ -1287,10 +1338,14 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%5d   ", i+1);
-            print_unicode(out, ct->name, 16, 1);
-            fprintf(out, " %-7s %-8d %s\n",
-                CONTACT_TYPE[ct->type & 3], CONTACT_ID(ct), ct->receive_tone ? "+" : "-");
+            outbuf_uint(out, i+1, 5);
+            outbuf_puts(out, "   ");
+            outbuf_unicode(out, ct->name, 16, 1);
+            outbuf_putc(out, ' ');
+            outbuf_str(out, CONTACT_TYPE[ct->type & 3], -7);
+            outbuf_putc(out, ' ');
+            outbuf_uint(out, CONTACT_ID(ct), -8);
+            outbuf_puts(out, ct->receive_tone ? " +\n" : " -\n");
         }
     }
 
@@ -1298,15 +1353,15 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Group lists.
     //
     if (have_grouplists()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of group lists.\n");
-            fprintf(out, "# 1) Group list number: 1-%d\n", NGLISTS);
-            fprintf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
-            fprintf(out, "# 3) List of contacts: numbers and ranges (N-M) separated by comma\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of group lists.\n");
+            outbuf_printf(out, "# 1) Group list number: 1-%d\n", NGLISTS);
+            outbuf_printf(out, "# 2) Name: up to 16 characters, use '_' instead of space\n");
+            outbuf_printf(out, "# 3) List of contacts: numbers and ranges (N-M) separated by comma\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Grouplist Name             Contacts\n");
+        outbuf_printf(out, "Grouplist Name             Contacts\n");
         for (i=0; i<NGLISTS; i++) {
             grouplist_t *gl = GET_GROUPLIST(i);
 
@@ -1315,15 +1370,15 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%5d     ", i + 1);
-            print_unicode(out, gl->name, 16, 1);
-            fprintf(out, " ");
+            outbuf_printf(out, "%5d     ", i + 1);
+            outbuf_unicode(out, gl->name, 16, 1);
+            outbuf_printf(out, " ");
             if (gl->member[0]) {
                 print_chanlist(out, gl->member, 32);
             } else {
-                fprintf(out, "-");
+                outbuf_printf(out, "-");
             }
-            fprintf(out, "\n");
+            outbuf_printf(out, "\n");
         }
     }
 
@@ -1331,14 +1386,14 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
     // Text messages.
     //
     if (have_messages()) {
-        fprintf(out, "\n");
+        outbuf_printf(out, "\n");
         if (verbose) {
-            fprintf(out, "# Table of text messages.\n");
-            fprintf(out, "# 1) Message number: 1-%d\n", NMESSAGES);
-            fprintf(out, "# 2) Text: up to 144 characters\n");
-            fprintf(out, "#\n");
+            outbuf_printf(out, "# Table of text messages.\n");
+            outbuf_printf(out, "# 1) Message number: 1-%d\n", NMESSAGES);
+            outbuf_printf(out, "# 2) Text: up to 144 characters\n");
+            outbuf_printf(out, "#\n");
         }
-        fprintf(out, "Message Text\n");
+        outbuf_printf(out, "Message Text\n");
         for (i=0; i<NMESSAGES; i++) {
             uint16_t *msg = GET_MESSAGE(i);
 
@@ -1347,15 +1402,17 @@ static void uv380_print_config(radio_device_t *radio, FILE *out, int verbose)
                 continue;
             }
 
-            fprintf(out, "%5d   ", i+1);
-            print_unicode(out, msg, 144, 0);
-            fprintf(out, "\n");
+            outbuf_printf(out, "%5d   ", i+1);
+            outbuf_unicode(out, msg, 144, 0);
+            outbuf_printf(out, "\n");
         }
     }
 
     // General settings.
     print_id(out, verbose);
     print_intro(out, verbose);
+
+    outbuf_flush(&ob);
 }
 
 //
@@ -1512,7 +1569,7 @@ static int parse_digital_channel(radio_device_t *radio, int first_row, char *lin
     char slot_str[256], grouplist_str[256], contact_str[256];
     int num, power, scanlist, tot, rxonly, admit;
     int colorcode, timeslot, grouplist, contact;
-    double rx_mhz, tx_mhz;
+    int rx_hz, tx_hz;
 
     if (sscanf(line, "%s %s %s %s %s %s %s %s %s %s %s %s %s",
         num_str, name_str, rxfreq_str, offset_str,
@@ -1527,18 +1584,18 @@ static int parse_digital_channel(radio_device_t *radio, int first_row, char *lin
         return 0;
     }
 
-    if (sscanf(rxfreq_str, "%lf", &rx_mhz) != 1 ||
-        !is_valid_frequency(rx_mhz)) {
+    if (!parse_mhz(rxfreq_str, &rx_hz) ||
+        !is_valid_frequency(rx_hz / 1000000)) {
         fprintf(stderr, "Bad receive frequency.\n");
         return 0;
     }
-    if (sscanf(offset_str, "%lf", &tx_mhz) != 1) {
+    if (!parse_mhz(offset_str, &tx_hz)) {
 badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         return 0;
     }
     if (offset_str[0] == '-' || offset_str[0] == '+')
-        tx_mhz += rx_mhz;
-    if (! is_valid_frequency(tx_mhz))
+        tx_hz += rx_hz;
+    if (! is_valid_frequency(tx_hz / 1000000))
         goto badtx;
 
     if (strcasecmp("High", power_str) == 0) {
@@ -1628,7 +1685,7 @@ badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         erase_scanlists();
     }
 
-    setup_channel(num-1, MODE_DIGITAL, name_str, rx_mhz, tx_mhz,
+    setup_channel(num-1, MODE_DIGITAL, name_str, rx_hz, tx_hz,
         power, scanlist, 1, tot, rxonly, admit, colorcode,
         timeslot, grouplist, contact, 0xffff, 0xffff, BW_12_5_KHZ);
 
@@ -1649,7 +1706,7 @@ static int parse_analog_channel(radio_device_t *radio, int first_row, char *line
     char rxtone_str[256], txtone_str[256], width_str[256];
     int num, power, scanlist, squelch, tot, rxonly, admit;
     int rxtone, txtone, width;
-    double rx_mhz, tx_mhz;
+    int rx_hz, tx_hz;
 
     if (sscanf(line, "%s %s %s %s %s %s %s %s %s %s %s %s %s",
         num_str, name_str, rxfreq_str, offset_str,
@@ -1664,18 +1721,18 @@ static int parse_analog_channel(radio_device_t *radio, int first_row, char *line
         return 0;
     }
 
-    if (sscanf(rxfreq_str, "%lf", &rx_mhz) != 1 ||
-        !is_valid_frequency(rx_mhz)) {
+    if (!parse_mhz(rxfreq_str, &rx_hz) ||
+        !is_valid_frequency(rx_hz / 1000000)) {
         fprintf(stderr, "Bad receive frequency.\n");
         return 0;
     }
-    if (sscanf(offset_str, "%lf", &tx_mhz) != 1) {
+    if (!parse_mhz(offset_str, &tx_hz)) {
 badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         return 0;
     }
     if (offset_str[0] == '-' || offset_str[0] == '+')
-        tx_mhz += rx_mhz;
-    if (! is_valid_frequency(tx_mhz))
+        tx_hz += rx_hz;
+    if (! is_valid_frequency(tx_hz / 1000000))
         goto badtx;
 
     if (strcasecmp("High", power_str) == 0) {
@@ -1759,7 +1816,7 @@ badtx:  fprintf(stderr, "Bad transmit frequency.\n");
         erase_channels();
     }
 
-    setup_channel(num-1, MODE_ANALOG, name_str, rx_mhz, tx_mhz,
+    setup_channel(num-1, MODE_ANALOG, name_str, rx_hz, tx_hz,
         power, scanlist, squelch, tot, rxonly, admit,
         1, 1, 0, 0, rxtone, txtone, width);
 
@@ -2410,17 +2467,132 @@ static void build_callsign_index(uint8_t *mem, int nrecords)
     }
 }
 
+//
+// Fill a chunk of callsign records.
+// Records have fixed size, so chunks are filled in parallel.
+//
+typedef struct {
+    csv_record_t *rec;
+    uint8_t      *mem;
+    int           count;
+    int           nchunks;
+} callsign_job_t;
+
+static void fill_callsign_chunk(void *arg, int chunk)
+{
+    callsign_job_t *job = arg;
+    int first = (int64_t)job->count * chunk / job->nchunks;
+    int last  = (int64_t)job->count * (chunk + 1) / job->nchunks;
+    char line[256];
+    int i;
+
+    for (i = first; i < last; i++) {
+        csv_record_t *r = &job->rec[i];
+        callsign_t *cs = GET_CALLSIGN(job->mem, i);
+
+        cs->dmrid = strtoul(r->radioid, 0, 10);
+        memset(cs->callsign, 0, sizeof(cs->callsign));
+        memcpy(cs->callsign, r->callsign, strnlen(r->callsign, sizeof(cs->callsign)));
+        snprintf(line, sizeof(line), "%s,%s,%s,%s,%s",
+            r->name, r->city, r->state, r->country, r->remarks);
+        strncpy(cs->name, line, sizeof(cs->name));
+    }
+}
+
+//
+// Sectors of callsign database, changed since the last write.
+//
+#define CALLSIGN_NSECTORS ((CALLSIGN_FINISH - CALLSIGN_START) / 0x10000)
+
+typedef struct {
+    uint8_t  dirty[CALLSIGN_NSECTORS];  // Sectors to erase and write
+    unsigned shift;                     // First record at another position
+} callsign_delta_t;
+
+static void mark_callsign(void *arg, const csv_key_t *prev, const csv_key_t *cur)
+{
+    callsign_delta_t *d = arg;
+
+    if (prev && cur && prev->index == cur->index) {
+        // Modified in place.
+        unsigned start = CALLSIGN_OFFSET + cur->index*120;
+        unsigned s;
+
+        for (s = start / 0x10000; s <= (start + 119) / 0x10000 && s < CALLSIGN_NSECTORS; s++)
+            d->dirty[s] = 1;
+        return;
+    }
+
+    // Added, removed or moved: records after it change places,
+    // and so does the search index.
+    if (prev && prev->index < d->shift)
+        d->shift = prev->index;
+    if (cur && cur->index < d->shift)
+        d->shift = cur->index;
+}
+
+//
+// Find the snapshot of contacts database, which was written
+// to this radio last time.  Read the database region back,
+// and check that it is the same as written.
+// Return the number of keys, or -1 when not available.
+//
+static int load_callsign_snapshot(char *path, int size, csv_key_t **keys)
+{
+    csv_region_t region;
+    unsigned long long digest = CSV_DIGEST_INIT;
+    unsigned addr, n, finish;
+    uint8_t *buf;
+    int nkeys;
+
+    *keys = 0;
+    if (!radio_csv_snapshot(path, size)) {
+        path[0] = 0;
+        return -1;
+    }
+    nkeys = csv_keys_load(path, keys, &region);
+    if (nkeys < 0)
+        return -1;
+    if (region.nbytes == 0 || region.nbytes > CALLSIGN_FINISH - CALLSIGN_START)
+        goto changed;
+
+    n = dfu_transfer_size();
+    buf = malloc(n);
+    if (!buf)
+        goto changed;
+    finish = CALLSIGN_START + region.nbytes;
+    for (addr = CALLSIGN_START; addr < finish; addr += n) {
+        if (n > finish - addr)
+            n = finish - addr;
+        dfu_read(addr, buf, n);
+        digest = csv_digest(digest, buf, n);
+    }
+    free(buf);
+    if (digest == region.digest)
+        return nkeys;
+
+    fprintf(stderr, "Contacts database was changed by other means.\n");
+changed:
+    free(*keys);
+    *keys = 0;
+    return -1;
+}
+
 //
 // Write CSV file to contacts database.
+// Only sectors, changed since the last write, are erased and written.
 //
 static void uv380_write_csv(radio_device_t *radio, FILE *csv)
 {
     uint8_t *mem;
-    char line[256];
-    char *radioid, *callsign, *name, *city, *state, *country, *remarks;
-    int id, bno, nbytes, nrecords = 0;
-    unsigned finish;
-    callsign_t *cs;
+    csv_record_t *rec;
+    callsign_job_t job;
+    callsign_delta_t delta;
+    csv_delta_t stat;
+    csv_key_t *keys, *prev;
+    char path[1024];
+    int id, nbytes, nlines, nrecords, nkeys, nprev;
+    unsigned finish, addr, n, kb, s, e, nsectors, ndirty, total, done;
 
     // Allocate 14Mbytes of memory.
     nbytes = CALLSIGN_FINISH - CALLSIGN_START;
@@ -2438,31 +2610,41 @@ static void uv380_write_csv(radio_device_t *radio, FILE *csv)
         free(mem);
         return;
     }
-    while (csv_read(csv, &radioid, &callsign, &name, &city, &state, &country, &remarks)) {
-        //printf("%s,%s,%s,%s,%s,%s,%s\n", radioid, callsign, name, city, state, country, remarks);
+    nlines = csv_load(csv, &rec);
+    if (nlines < 0) {
+        free(mem);
+        return;
+    }
+    for (nrecords = 0; nrecords < nlines; nrecords++) {
+        csv_record_t *r = &rec[nrecords];
 
-        id = strtoul(radioid, 0, 10);
+        id = strtoul(r->radioid, 0, 10);
         if (id < 1 || id > 0xffffff) {
             fprintf(stderr, "Bad id: %d\n", id);
-            fprintf(stderr, "Line: '%s,%s,%s,%s,%s,%s,%s'\n",
-                radioid, callsign, name, city, state, country, remarks);
+            fprintf(stderr, "Line: '%s,%s,%s,%s,%s,%s,%s'\n", r->radioid,
+                r->callsign, r->name, r->city, r->state, r->country, r->remarks);
+            csv_free(rec);
+            free(mem);
             return;
         }
-
-        cs = GET_CALLSIGN(mem, nrecords);
-        if ((uint8_t*) (cs + 1) > &mem[nbytes]) {
+        if ((uint8_t*) (GET_CALLSIGN(mem, nrecords) + 1) > &mem[nbytes]) {
             fprintf(stderr, "WARNING: Too many callsigns!\n");
             fprintf(stderr, "Skipping the rest.\n");
             break;
         }
-        nrecords++;
+    }
 
-        // Fill callsign structure.
-        cs->dmrid = id;
-        strncpy(cs->callsign, callsign, sizeof(cs->callsign));
-        snprintf(line, sizeof(line), "%s,%s,%s,%s,%s",
-            name, city, state, country, remarks);
-        strncpy(cs->name, line, sizeof(cs->name));
+    // Fill callsign structures in parallel.
+    job.rec = rec;
+    job.mem = mem;
+    job.count = nrecords;
+    job.nchunks = parallel_nchunks(nrecords, 1000);
+    parallel_for(job.nchunks, fill_callsign_chunk, &job);
+    nkeys = csv_keys(rec, nrecords, &keys);
+    csv_free(rec);
+    if (nkeys < 0) {
+        free(mem);
+        return;
     }
     fprintf(stderr, "Total %d contacts.\n", nrecords);
 
@@ -2477,19 +2659,68 @@ static void uv380_write_csv(radio_device_t *radio, FILE *csv)
     if (finish > CALLSIGN_FINISH) {
         // Limit is 122197 contacts.
         fprintf(stderr, "Too many contacts!\n");
+        free(keys);
+        free(mem);
         return;
     }
 
     //
-    // Erase whole region.
-    // Align finish to 64kbytes.
+    // Compare with the database, written last time.
+    // Without the snapshot, the whole region is rewritten.
+    //
+    nsectors = (finish - CALLSIGN_START + 0xffff) / 0x10000;
+    memset(delta.dirty, 0, sizeof(delta.dirty));
+    delta.shift = ~0u;
+    nprev = load_callsign_snapshot(path, sizeof(path), &prev);
+    if (nprev < 0) {
+        memset(delta.dirty, 1, nsectors);
+    } else {
+        csv_delta(prev, nprev, keys, nkeys, &stat, mark_callsign, &delta);
+        free(prev);
+        if (delta.shift != ~0u) {
+            // Rewrite the index, and all records from the first shifted one.
+            memset(delta.dirty, 1, 1);
+            for (s = (CALLSIGN_OFFSET + delta.shift*120) / 0x10000; s < nsectors; s++)
+                delta.dirty[s] = 1;
+        }
+    }
+    ndirty = total = 0;
+    for (s=0; s<nsectors; s++) {
+        if (delta.dirty[s]) {
+            e = CALLSIGN_START + (s + 1) * 0x10000;
+            ndirty++;
+            total += ((e < finish) ? e : finish) - (e - 0x10000);
+        }
+    }
+    if (nprev >= 0) {
+        fprintf(stderr, "Since last write: %d added, %d removed, %d modified, %d moved; %u of %u sectors to write.\n",
+            stat.added, stat.removed, stat.modified, stat.moved, ndirty, nsectors);
+    }
+    if (ndirty == 0) {
+        fprintf(stderr, "Contacts database is up to date.\n");
+        free(keys);
+        free(mem);
+        return;
+    }
+
+    // Forget the snapshot until the write is complete.
+    if (path[0])
+        unlink(path);
+
+    //
+    // Erase changed sectors, in runs of adjacent ones.
     //
     radio_progress = 0;
     if (! trace_flag) {
         fprintf(stderr, "Erase: ");
         fflush(stderr);
     }
-    dfu_erase(CALLSIGN_START, (finish + 0xffff) / 0x10000 * 0x10000);
+    for (s=0; s<nsectors; s=e) {
+        for (e=s; e<nsectors && delta.dirty[e] == delta.dirty[s]; e++)
+            continue;
+        if (delta.dirty[s])
+            dfu_erase(CALLSIGN_START + s*0x10000, CALLSIGN_START + e*0x10000);
+    }
     if (! trace_flag) {
         fprintf(stderr, "# done.\n");
         fprintf(stderr, "Write: ");
@@ -2499,17 +2730,37 @@ static void uv380_write_csv(radio_device_t *radio, FILE *csv)
     //
     // Write callsigns.
     //
-    for (bno = CALLSIGN_START/1024; bno < finish/1024; bno++) {
-        dfu_write_block(bno, &mem[bno*1024 - CALLSIGN_START], 1024);
-
-        ++radio_progress;
-        if (radio_progress % 512 == 0) {
-            fprintf(stderr, "#");
-            fflush(stderr);
+    done = 0;
+    for (addr = CALLSIGN_START; addr < finish; addr += n) {
+        n = dfu_transfer_size();
+        if (n > finish - addr)
+            n = finish - addr;
+        if (! delta.dirty[(addr - CALLSIGN_START) / 0x10000])
+            continue;
+        dfu_write(addr, &mem[addr - CALLSIGN_START], n);
+        done += n;
+        progress_update(done, total);
+
+        for (kb=0; kb<n/1024; kb++) {
+            ++radio_progress;
+            if (radio_progress % 512 == 0) {
+                fprintf(stderr, "#");
+                fflush(stderr);
+            }
         }
     }
     if (! trace_flag)
         fprintf(stderr, "# done.\n");
+
+    // Remember what is written.
+    if (path[0]) {
+        csv_region_t region;
+
+        region.nbytes = finish - CALLSIGN_START;
+        region.digest = csv_digest(CSV_DIGEST_INIT, mem, region.nbytes);
+        csv_keys_save(path, keys, nkeys, &region);
+    }
+    free(keys);
     free(mem);
 }
 
@@ -2531,6 +2782,7 @@ radio_device_t radio_uv380 = {
     uv380_parse_row,
     uv380_update_timestamp,
     uv380_write_csv,
+    .linktest = uv380_linktest,
 };
 
 //
@@ -2551,6 +2803,7 @@ radio_device_t radio_uv390 = {
     uv380_parse_row,
     uv380_update_timestamp,
     uv380_write_csv,
+    .linktest = uv380_linktest,
 };
 
 //
@@ -2571,6 +2824,7 @@ radio_device_t radio_md2017 = {
     uv380_parse_row,
     uv380_update_timestamp,
     uv380_write_csv,
+    .linktest = uv380_linktest,
 };
 
 //
@@ -2591,6 +2845,7 @@ radio_device_t radio_md9600 = {
     uv380_parse_row,
     uv380_update_timestamp,
     uv380_write_csv,
+    .linktest = uv380_linktest,
 };
 
 //
@@ -2611,4 +2866,5 @@ radio_device_t radio_rt84 = {
     uv380_parse_row,
     uv380_update_timestamp,
     uv380_write_csv,
+    .linktest = uv380_linktest,
 };